@@ -0,0 +1,5 @@
+if not exist "binaries/" mkdir binaries
+
+cl /c /MD -DSFML_STATIC /Fo"binaries/" ^
+/I "includes" ^
+jobs.cpp
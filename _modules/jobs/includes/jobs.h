@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+namespace jobs{
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    //                                              JOB SYSTEM
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    // Work stealing thread pool shared by the whole program (physics, resource loading, rendering).
+    //
+    // Every worker thread owns a Chase-Lev deque: it pushes and pops its own tasks at the bottom (LIFO,
+    // cache friendly for recursive splits) while idle workers steal from the top of the others (FIFO,
+    // the biggest pieces of work). The thread that calls start() takes deque 0 and works like the
+    // workers when it waits; any other thread submits through a shared injection queue.
+    //
+    // Tasks signal a counter when they end; wait() on a counter runs other tasks until the counter
+    // reaches zero (wait with help), so waiting inside a task never blocks a worker.
+    // Without start() every function runs the tasks inline on the calling thread.
+    // Executed tasks are recycled: after the first rounds the parallel loops don't allocate (as long as
+    // fn itself is passed without allocating, e.g. a std::cref of the lambda).
+
+    struct task;
+
+    // ====================================================================================
+    // Counter:
+    // Number of pending tasks of a group. Tasks submitted with run_after(dependency, ...) are queued
+    // only once their dependency counter reaches zero.
+
+    struct counter{
+        std::atomic<int> pending{0};
+
+        std::mutex mutex;
+        std::vector<task*> continuations;
+    };
+
+    // ====================================================================================
+    // Chase-Lev work stealing deque (Chase, Lev 2005; memory orders from Lê et al. 2013):
+    // push and pop only from the owner thread, steal from any thread. The ring grows when full; old
+    // rings are kept until the deque is destroyed since a thief could still be reading them.
+
+    struct work_stealing_deque{
+        struct ring{
+            int64_t capacity;
+            std::atomic<task*>* slots;
+        };
+
+        std::atomic<int64_t> top{0};
+        std::atomic<int64_t> bottom{0};
+        std::atomic<ring*> array{nullptr};
+        std::vector<ring*> rings;                               // all the rings ever allocated
+    };
+
+    void init_deque(work_stealing_deque& deque, int64_t capacity);
+    void destroy_deque(work_stealing_deque& deque);
+    void push(work_stealing_deque& deque, task* t);
+    task* pop(work_stealing_deque& deque);
+    task* steal(work_stealing_deque& deque);
+
+    // ====================================================================================
+    // Scheduler:
+
+    struct scheduler{
+        std::vector<std::thread> threads;
+        std::vector<work_stealing_deque*> deques;               // deques[0] belongs to the thread that called start()
+
+        std::mutex injection_mutex;
+        std::deque<task*> injection_queue;                      // tasks submitted by threads without a deque
+        std::atomic<int> injected{0};
+
+        std::mutex sleep_mutex;
+        std::condition_variable sleep_cv;
+        std::atomic<int> sleeping{0};
+
+        std::atomic<bool> stop{false};
+        bool running = false;
+    };
+
+    extern scheduler job_scheduler;
+
+    void start(int workers_number);
+    void stop();
+    int threads_number();                                       // workers + the starting thread (1 if not started)
+
+    // ====================================================================================
+    // Tasks:
+
+    void run(std::function<void()> fn, counter* done = nullptr);
+    void run_after(counter* dependency, std::function<void()> fn, counter* done = nullptr);
+    void wait(counter* c);
+
+    // Adaptive parallel for: the range is split in about 4 pieces per thread (never less than
+    // min_grain elements) and the pieces are spread with recursive binary splitting
+    void parallel_for(int count, const std::function<void(int begin, int end)>& fn, int min_grain = 1);
+
+    // Fixed chunks of grain elements: the chunk boundaries only depend on count and grain, so
+    // results merged in chunk order don't depend on the number of threads
+    void parallel_for_chunks(int count, int grain, const std::function<void(int begin, int end, int chunk)>& fn);
+}
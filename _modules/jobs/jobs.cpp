@@ -0,0 +1,465 @@
+#include "jobs.h"
+#include <algorithm>
+#include <cassert>
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                              JOB SYSTEM
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct jobs::task{
+    std::function<void()> fn;                                   // run / run_after
+
+    // Chunk range [first, last) of a parallel_for_chunks: split and run without wrapping 
+    // it in a std::function (a lambda with the split arguments doesn't fit in its small buffer)
+    const std::function<void(int, int, int)>* chunk_fn;
+    int first, last, count, grain;
+
+    counter* done;
+    task* next_free;
+};
+
+jobs::scheduler jobs::job_scheduler;
+
+// Index of the deque owned by the current thread, -1 for threads without a deque
+static thread_local int local_index = -1;
+
+// Incremented at every submission; sleeping workers wake up when it changes
+static std::atomic<uint64_t> work_generation{0};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                        WORK STEALING DEQUE
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static jobs::work_stealing_deque::ring* new_ring(int64_t capacity){
+    jobs::work_stealing_deque::ring* r = new jobs::work_stealing_deque::ring;
+    r->capacity = capacity;
+    r->slots = new std::atomic<jobs::task*>[capacity];
+    return r;
+}
+
+void jobs::init_deque(work_stealing_deque& deque, int64_t capacity){
+    deque.top = 0;
+    deque.bottom = 0;
+    deque.rings.push_back(new_ring(capacity));
+    deque.array = deque.rings.back();
+}
+
+void jobs::destroy_deque(work_stealing_deque& deque){
+    for( auto* r : deque.rings){
+        delete[] r->slots;
+        delete r;
+    }
+    deque.rings.clear();
+    deque.array = nullptr;
+}
+
+// =========================================================================|
+//                                    push
+// =========================================================================|
+// Owner only. When the ring is full the live elements [top, bottom) are
+// copied in a ring of double capacity.
+//
+void jobs::push(work_stealing_deque& deque, task* t){
+
+    int64_t b = deque.bottom.load(std::memory_order_relaxed);
+    int64_t top = deque.top.load(std::memory_order_acquire);
+    work_stealing_deque::ring* a = deque.array.load(std::memory_order_relaxed);
+
+    if(b - top > a->capacity - 1){
+        work_stealing_deque::ring* grown = new_ring(a->capacity * 2);
+        for(int64_t i = top; i < b; i++)
+            grown->slots[i & (grown->capacity - 1)].store(a->slots[i & (a->capacity - 1)].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        deque.rings.push_back(grown);
+        deque.array.store(grown, std::memory_order_release);
+        a = grown;
+    }
+
+    a->slots[b & (a->capacity - 1)].store(t, std::memory_order_release);
+    deque.bottom.store(b + 1, std::memory_order_release);
+}
+
+// =========================================================================|
+//                                    pop
+// =========================================================================|
+// Owner only. The last element is contended with the thieves through the
+// CAS on top.
+//
+jobs::task* jobs::pop(work_stealing_deque& deque){
+
+    int64_t b = deque.bottom.load(std::memory_order_relaxed) - 1;
+    work_stealing_deque::ring* a = deque.array.load(std::memory_order_relaxed);
+    deque.bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = deque.top.load(std::memory_order_relaxed);
+
+    task* t = nullptr;
+
+    if(top <= b){
+        t = a->slots[b & (a->capacity - 1)].load(std::memory_order_relaxed);
+        if(top == b){
+            if(!deque.top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                t = nullptr;
+            deque.bottom.store(b + 1, std::memory_order_relaxed);
+        }
+    }else{
+        deque.bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    return t;
+}
+
+// =========================================================================|
+//                                    steal
+// =========================================================================|
+// Any thread. Returns nullptr if the deque is empty or another thread won
+// the race for the top element.
+//
+jobs::task* jobs::steal(work_stealing_deque& deque){
+
+    int64_t top = deque.top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = deque.bottom.load(std::memory_order_acquire);
+
+    if(top >= b)
+        return nullptr;
+
+    work_stealing_deque::ring* a = deque.array.load(std::memory_order_acquire);
+    task* t = a->slots[top & (a->capacity - 1)].load(std::memory_order_acquire);
+
+    if(!deque.top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+
+    return t;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                             TASK POOL
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Executed tasks go back to a free list instead of the heap: once the pool holds as many tasks
+// as a parallel stage keeps in flight, submitting doesn't allocate anymore. The tasks are
+// deleted by stop().
+
+static std::mutex free_tasks_mutex;
+static jobs::task* free_tasks = nullptr;
+
+static jobs::task* new_task(jobs::counter* done){
+
+    jobs::task* t = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(free_tasks_mutex);
+        if(free_tasks != nullptr){
+            t = free_tasks;
+            free_tasks = t->next_free;
+        }
+    }
+    if(t == nullptr)
+        t = new jobs::task;
+
+    t->chunk_fn = nullptr;
+    t->done = done;
+    t->next_free = nullptr;
+    return t;
+}
+
+static void recycle_task(jobs::task* t){
+
+    t->fn = nullptr;                                            // releases the captures now
+
+    std::lock_guard<std::mutex> lock(free_tasks_mutex);
+    t->next_free = free_tasks;
+    free_tasks = t;
+}
+
+static void delete_free_tasks(){
+
+    std::lock_guard<std::mutex> lock(free_tasks_mutex);
+    while(free_tasks != nullptr){
+        jobs::task* t = free_tasks;
+        free_tasks = t->next_free;
+        delete t;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                             SCHEDULING
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static void submit(jobs::task* t);
+static void split_chunks(int first, int last, int count, int grain, const std::function<void(int, int, int)>& fn, jobs::counter* c);
+
+// ------------------------------------------------------------------------------------
+// Signal the end of a task to its counter; the last task releases the continuations.
+// The counter mutex is held while pending reaches zero: wait() locks it once before
+// returning, so the counter can't be destroyed while it is still being touched here.
+static void finish(jobs::counter* c){
+
+    if(c == nullptr)
+        return;
+
+    std::vector<jobs::task*> ready;
+    {
+        std::lock_guard<std::mutex> lock(c->mutex);
+        if(c->pending.fetch_sub(1) == 1)
+            ready.swap(c->continuations);
+    }
+
+    for( jobs::task* t : ready)
+        submit(t);
+}
+
+static void execute(jobs::task* t){
+    if(t->chunk_fn != nullptr)
+        split_chunks(t->first, t->last, t->count, t->grain, *t->chunk_fn, t->done);
+    else
+        t->fn();
+    finish(t->done);
+    recycle_task(t);
+}
+
+// ------------------------------------------------------------------------------------
+// Push the task on the deque of the current thread (or on the injection queue) and
+// wake up a sleeping worker. Without a running scheduler the task runs inline.
+static void submit(jobs::task* t){
+
+    jobs::scheduler& s = jobs::job_scheduler;
+
+    if(!s.running){
+        execute(t);
+        return;
+    }
+
+    if(local_index >= 0){
+        jobs::push(*s.deques[local_index], t);
+    }else{
+        std::lock_guard<std::mutex> lock(s.injection_mutex);
+        s.injection_queue.push_back(t);
+        s.injected++;
+    }
+
+    work_generation++;
+    if(s.sleeping > 0){
+        std::lock_guard<std::mutex> lock(s.sleep_mutex);
+        s.sleep_cv.notify_one();
+    }
+}
+
+// ------------------------------------------------------------------------------------
+// Own deque first, then steal from the others starting from a rotating victim,
+// then the injection queue
+static jobs::task* find_task(int index){
+
+    jobs::scheduler& s = jobs::job_scheduler;
+
+    if(index >= 0){
+        jobs::task* t = jobs::pop(*s.deques[index]);
+        if(t != nullptr)
+            return t;
+    }
+
+    static thread_local unsigned int victim_seed = 0;
+    int deques_number = s.deques.size();
+    int first_victim = (victim_seed++) % deques_number;
+
+    for(int i = 0; i < deques_number; i++){
+        int victim = (first_victim + i) % deques_number;
+        if(victim == index)
+            continue;
+        jobs::task* t = jobs::steal(*s.deques[victim]);
+        if(t != nullptr)
+            return t;
+    }
+
+    if(s.injected > 0){
+        std::lock_guard<std::mutex> lock(s.injection_mutex);
+        if(!s.injection_queue.empty()){
+            jobs::task* t = s.injection_queue.front();
+            s.injection_queue.pop_front();
+            s.injected--;
+            return t;
+        }
+    }
+
+    return nullptr;
+}
+
+// ------------------------------------------------------------------------------------
+// Worker loop: run tasks while there are any, then sleep until a new submission
+static void worker_main(int index){
+
+    jobs::scheduler& s = jobs::job_scheduler;
+    local_index = index;
+
+    while(!s.stop){
+
+        uint64_t generation = work_generation;
+
+        jobs::task* t = find_task(index);
+        if(t != nullptr){
+            execute(t);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(s.sleep_mutex);
+        s.sleeping++;
+        s.sleep_cv.wait(lock, [&]{ return s.stop || work_generation != generation; });
+        s.sleeping--;
+    }
+}
+
+// =========================================================================|
+//                                start / stop
+// =========================================================================|
+
+void jobs::start(int workers_number){
+
+    scheduler& s = job_scheduler;
+    assert(!s.running);
+
+    workers_number = std::max(workers_number, 0);
+
+    for(int i = 0; i < workers_number + 1; i++){
+        s.deques.push_back(new work_stealing_deque);
+        init_deque(*s.deques.back(), 256);
+    }
+
+    s.stop = false;
+    s.running = true;
+    local_index = 0;
+
+    for(int i = 1; i <= workers_number; i++)
+        s.threads.emplace_back(worker_main, i);
+}
+
+void jobs::stop(){
+
+    scheduler& s = job_scheduler;
+    if(!s.running)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(s.sleep_mutex);
+        s.stop = true;
+    }
+    s.sleep_cv.notify_all();
+
+    for( auto& thread : s.threads)
+        thread.join();
+    s.threads.clear();
+
+    for( auto* deque : s.deques){
+        destroy_deque(*deque);
+        delete deque;
+    }
+    s.deques.clear();
+
+    s.running = false;
+    local_index = -1;
+
+    delete_free_tasks();
+}
+
+int jobs::threads_number(){
+    return job_scheduler.running ? (int) job_scheduler.deques.size() : 1;
+}
+
+// =========================================================================|
+//                              run / run_after
+// =========================================================================|
+
+void jobs::run(std::function<void()> fn, counter* done){
+    if(done != nullptr)
+        done->pending++;
+    task* t = new_task(done);
+    t->fn = std::move(fn);
+    submit(t);
+}
+
+void jobs::run_after(counter* dependency, std::function<void()> fn, counter* done){
+
+    if(done != nullptr)
+        done->pending++;
+    task* t = new_task(done);
+    t->fn = std::move(fn);
+
+    if(dependency != nullptr){
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if(dependency->pending > 0){
+            dependency->continuations.push_back(t);
+            return;
+        }
+    }
+
+    submit(t);
+}
+
+// =========================================================================|
+//                                    wait
+// =========================================================================|
+// Wait with help: while the counter is pending the thread runs any task it
+// can find (its own first), so it makes progress on the tasks it waits for.
+//
+void jobs::wait(counter* c){
+
+    while(c->pending > 0){
+        task* t = job_scheduler.running ? find_task(local_index) : nullptr;
+        if(t != nullptr)
+            execute(t);
+        else
+            std::this_thread::yield();
+    }
+
+    // The last finish() may still hold the mutex
+    std::lock_guard<std::mutex> lock(c->mutex);
+}
+
+// =========================================================================|
+//                               parallel_for
+// =========================================================================|
+
+// ------------------------------------------------------------------------------------
+// Recursive binary splitting: push the upper half of the chunk range as a new task and
+// keep the lower half, until a single chunk is left
+static void split_chunks(int first, int last, int count, int grain, const std::function<void(int, int, int)>& fn, jobs::counter* c){
+
+    while(last - first > 1){
+        int mid = first + (last - first) / 2;
+
+        jobs::task* upper = new_task(c);
+        upper->chunk_fn = &fn;
+        upper->first = mid;
+        upper->last = last;
+        upper->count = count;
+        upper->grain = grain;
+        c->pending++;
+        submit(upper);
+
+        last = mid;
+    }
+
+    fn(first * grain, std::min((first + 1) * grain, count), first);
+}
+
+void jobs::parallel_for_chunks(int count, int grain, const std::function<void(int begin, int end, int chunk)>& fn){
+
+    grain = std::max(grain, 1);
+    int chunks = (count + grain - 1) / grain;
+
+    if(!job_scheduler.running || chunks <= 1){
+        for(int chunk = 0; chunk < chunks; chunk++)
+            fn(chunk * grain, std::min((chunk + 1) * grain, count), chunk);
+        return;
+    }
+
+    counter c;
+    split_chunks(0, chunks, count, grain, fn, &c);
+    wait(&c);
+}
+
+void jobs::parallel_for(int count, const std::function<void(int begin, int end)>& fn, int min_grain){
+
+    int pieces = threads_number() * 4;
+    int grain = std::max(std::max(min_grain, 1), (count + pieces - 1) / pieces);
+
+    parallel_for_chunks(count, grain, [&](int begin, int end, int){ fn(begin, end); });
+}
@@ -1,6 +1,16 @@
 if not exist "binaries/" mkdir binaries
 
-cl /c /MD -DSFML_STATIC /Fo"binaries/" ^
+cl /c /MD /fp:precise -DSFML_STATIC /Fo"binaries/" ^
 /I "includes" ^
 /I "..\opengl-libs\includes" ^
-physic.cpp
\ No newline at end of file
+/I "..\jobs\includes" ^
+physic.cpp ^
+joints.cpp ^
+world.cpp ^
+integrator.cpp ^
+broadphase.cpp ^
+parallel.cpp ^
+arena.cpp ^
+state.cpp ^
+scene.cpp ^
+batch.cpp
\ No newline at end of file
@@ -0,0 +1,85 @@
+#include "physic.h"
+#include <algorithm>
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                              STEP ARENA
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const size_t arena_alignment = sizeof(std::max_align_t);
+
+static size_t align_up(size_t bytes){
+    return (bytes + arena_alignment - 1) / arena_alignment * arena_alignment;
+}
+
+size_t physic::dim2::arena_capacity(const step_arena& arena){
+    return arena.block.size() * sizeof(std::max_align_t);
+}
+
+// Call it between two steps: the memory handed out so far is lost
+void physic::dim2::reserve_arena(step_arena& arena, size_t bytes){
+
+    if(bytes <= arena_capacity(arena))
+        return;
+
+    arena.block.assign(align_up(bytes) / arena_alignment, std::max_align_t{});
+    arena.top = 0;
+    arena.spills.clear();
+}
+
+// =========================================================================|
+//                                reset_arena
+// =========================================================================|
+// O(1) unless the last step spilled: then the block grows to 1.5x the
+// high water mark, once.
+//
+void physic::dim2::reset_arena(step_arena& arena){
+
+    size_t used = std::max(arena.step_peak, arena.top.load(std::memory_order_relaxed));
+
+    arena.last_step_bytes = used;
+    arena.high_water = std::max(arena.high_water, used);
+    arena.step_peak = 0;
+
+    if(!arena.spills.empty()){
+        arena.spills.clear();
+        reserve_arena(arena, arena.high_water + arena.high_water / 2);
+    }
+
+    arena.top.store(0, std::memory_order_relaxed);
+}
+
+size_t physic::dim2::arena_mark(const step_arena& arena){
+    return arena.top.load(std::memory_order_relaxed);
+}
+
+// The spills stay until the reset; the peak is kept for the high water mark
+void physic::dim2::arena_rewind(step_arena& arena, size_t mark){
+    arena.step_peak = std::max(arena.step_peak, arena.top.load(std::memory_order_relaxed));
+    arena.top.store(mark, std::memory_order_relaxed);
+}
+
+// =========================================================================|
+//                               arena_allocate
+// =========================================================================|
+// Thread safe: the chunks of the parallel stages allocate concurrently.
+// The memory is aligned for any type and not initialized.
+//
+void* physic::dim2::arena_allocate(step_arena& arena, size_t bytes){
+
+    bytes = align_up(std::max(bytes, (size_t) 1));
+
+    size_t offset = arena.top.fetch_add(bytes, std::memory_order_relaxed);
+    if(offset + bytes <= arena_capacity(arena))
+        return reinterpret_cast<unsigned char*>(arena.block.data()) + offset;
+
+    // ------------------------------------------------------------------------------------
+    // Spill: the block is full, serve it from the heap until the next reset
+
+    std::unique_ptr<std::max_align_t[]> spill(new std::max_align_t[bytes / arena_alignment]);
+    void* memory = spill.get();
+
+    std::lock_guard<std::mutex> lock(arena.spill_mutex);
+    arena.spills.push_back(std::move(spill));
+    return memory;
+}
@@ -0,0 +1,165 @@
+#include "physic.h"
+#include <algorithm>
+#include <cassert>
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                          BATCHED ENVIRONMENTS
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// =========================================================================|
+//                             create_env_batch
+// =========================================================================|
+// The envs are restored from the saved state of the prototype instead of
+// being rebuilt: same rows, same handle table, same broad phase proxies, so
+// the handles found in the prototype are valid in every env.
+// The columns of every env are reserved in the shared block before the 
+// restore, which then fills them in place.
+//
+static physic::dim2::body_handle find_body_by_id(const physic::dim2::body_storage& bodies, int id){
+
+    for(int row = 0; row < physic::dim2::body_count(bodies); row++){
+        if(bodies.id[row] == id)
+            return physic::dim2::row_body_handle(bodies, row);
+    }
+
+    return physic::dim2::null_body;
+}
+
+bool physic::dim2::create_env_batch(env_batch& out_batch, const world& prototype, int env_count, const std::vector<int>& actuated_ids, const std::vector<int>& observed_ids){
+
+    out_batch.actuated.clear();
+    out_batch.observed.clear();
+
+    for(int id : actuated_ids){
+        body_handle handle = find_body_by_id(prototype.bodies, id);
+        if(handle == null_body)
+            return false;
+        out_batch.actuated.push_back(handle);
+    }
+
+    for(int id : observed_ids){
+        body_handle handle = find_body_by_id(prototype.bodies, id);
+        if(handle == null_body)
+            return false;
+        out_batch.observed.push_back(handle);
+    }
+
+    save_world_state(prototype, out_batch.initial_state);
+
+    // The old envs go before their block is reused
+    int capacity = std::max(body_count(prototype.bodies), (int) prototype.bodies.handle_row.size());
+    out_batch.envs.clear();
+    if(!out_batch.columns)
+        out_batch.columns.reset(new column_block);
+    reserve_column_block(*out_batch.columns, column_block_bytes(capacity) * env_count);
+
+    out_batch.envs.resize(env_count);
+    for(auto& env : out_batch.envs){
+        env.reset(new world);
+        env->parallel = false;
+        attach_column_block(env->bodies, out_batch.columns.get(), capacity);
+        restore_world_state(*env, out_batch.initial_state);
+    }
+
+    out_batch.episode_step.assign(env_count, 0);
+
+    return true;
+}
+
+// =========================================================================|
+//                                reset_env
+// =========================================================================|
+
+void physic::dim2::reset_env(env_batch& batch, int env){
+
+    bool restored = restore_world_state(*batch.envs[env], batch.initial_state);
+    assert(restored && "the initial state of the batch is saved by create_env_batch");
+    (void) restored;
+
+    batch.episode_step[env] = 0;
+}
+
+// ------------------------------------------------------------------------------------
+// Observation and actions of one env (blocks of observation_size and action_size floats)
+
+static void write_env_observation(const physic::dim2::env_batch& batch, const physic::dim2::world& w, float* out){
+
+    const physic::dim2::body_storage& bodies = w.bodies;
+
+    for(physic::dim2::body_handle handle : batch.observed){
+        int row = physic::dim2::body_row(bodies, handle);
+        if(row < 0){
+            std::fill(out, out + 6, 0.0f);
+        }else{
+            out[0] = bodies.pos_x[row];
+            out[1] = bodies.pos_y[row];
+            out[2] = bodies.angle[row];
+            out[3] = bodies.vel_x[row];
+            out[4] = bodies.vel_y[row];
+            out[5] = bodies.w[row];
+        }
+        out += 6;
+    }
+}
+
+static void apply_env_actions(const physic::dim2::env_batch& batch, physic::dim2::world& w, const float* actions){
+
+    physic::dim2::body_storage& bodies = w.bodies;
+
+    for(physic::dim2::body_handle handle : batch.actuated){
+        int row = physic::dim2::body_row(bodies, handle);
+        if(row >= 0 && !bodies.is_static[row]){
+            bodies.force_x[row] += actions[0];
+            bodies.force_y[row] += actions[1];
+            bodies.torque[row] += actions[2];
+        }
+        actions += 3;
+    }
+}
+
+// =========================================================================|
+//                            write_observations
+// =========================================================================|
+
+void physic::dim2::write_observations(const env_batch& batch, float* observations_out){
+
+    int stride = observation_size(batch);
+
+    for(int env = 0; env < (int) batch.envs.size(); env++)
+        write_env_observation(batch, *batch.envs[env], observations_out + (size_t) env * stride);
+}
+
+// =========================================================================|
+//                                step_batch
+// =========================================================================|
+// Actions, step, done check, reset and observation of an env are done by
+// the same task back to back: the state of the env is read while it's still
+// in the cache of the thread that stepped it.
+//
+void physic::dim2::step_batch(env_batch& batch, const float* actions, float* observations_out, unsigned char* dones_out){
+
+    int action_stride = action_size(batch);
+    int observation_stride = observation_size(batch);
+
+    jobs::parallel_for((int) batch.envs.size(), [&](int begin, int end){
+
+        for(int env = begin; env < end; env++){
+            world& w = *batch.envs[env];
+
+            apply_env_actions(batch, w, actions + (size_t) env * action_stride);
+            step(w, w.fixed_delta_time);
+
+            batch.episode_step[env]++;
+            bool done = (batch.episode_length > 0 && batch.episode_step[env] >= batch.episode_length) ||
+                        (batch.done && batch.done(w, env));
+            if(done)
+                reset_env(batch, env);
+
+            write_env_observation(batch, w, observations_out + (size_t) env * observation_stride);
+            if(dones_out)
+                dones_out[env] = done ? 1 : 0;
+        }
+
+    }, batch.env_grain);
+}
@@ -0,0 +1,62 @@
+if not exist "binaries/" mkdir binaries
+
+cl /c /O2 /EHsc /Fo"binaries/" ^
+/I "..\includes" ^
+/I "..\..\opengl-libs\includes" ^
+/I "..\..\jobs\includes" ^
+..\physic.cpp ^
+..\joints.cpp ^
+..\world.cpp ^
+..\integrator.cpp ^
+..\broadphase.cpp ^
+..\parallel.cpp ^
+..\arena.cpp ^
+..\state.cpp ^
+..\scene.cpp ^
+..\batch.cpp ^
+..\..\jobs\jobs.cpp ^
+solver_modes.cpp ^
+narrowphase.cpp ^
+scene_scaling.cpp
+
+cl /Fe: solver_modes.exe ^
+binaries\physic.obj ^
+binaries\joints.obj ^
+binaries\world.obj ^
+binaries\integrator.obj ^
+binaries\broadphase.obj ^
+binaries\parallel.obj ^
+binaries\arena.obj ^
+binaries\state.obj ^
+binaries\scene.obj ^
+binaries\batch.obj ^
+binaries\jobs.obj ^
+binaries\solver_modes.obj
+
+cl /Fe: narrowphase.exe ^
+binaries\physic.obj ^
+binaries\joints.obj ^
+binaries\world.obj ^
+binaries\integrator.obj ^
+binaries\broadphase.obj ^
+binaries\parallel.obj ^
+binaries\arena.obj ^
+binaries\state.obj ^
+binaries\scene.obj ^
+binaries\batch.obj ^
+binaries\jobs.obj ^
+binaries\narrowphase.obj
+
+cl /Fe: scene_scaling.exe ^
+binaries\physic.obj ^
+binaries\joints.obj ^
+binaries\world.obj ^
+binaries\integrator.obj ^
+binaries\broadphase.obj ^
+binaries\parallel.obj ^
+binaries\arena.obj ^
+binaries\state.obj ^
+binaries\scene.obj ^
+binaries\batch.obj ^
+binaries\jobs.obj ^
+binaries\scene_scaling.obj
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                      BENCHMARK: Random numbers
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Deterministic random numbers (xorshift) for the generated inputs of the benchmarks: the same sequence
+// on every compiler, so every run and every commit measures the same inputs. Every benchmark is a
+// single source file: the state is private to it.
+
+static uint32_t random_state = 0x9e3779b9u;
+
+static inline void random_seed(uint32_t seed){
+    random_state = seed;
+}
+
+// Uniform in [min, max)
+static inline float random_range(float min, float max){
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return min + (max - min) * (float) (random_state >> 8) / (float) (1 << 24);
+}
@@ -0,0 +1,235 @@
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+
+#include "physic.h"
+#include "bench_random.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                      BENCHMARK: Narrow phase kernels
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Times every contact generation kernel alone, over the same set of randomized pairs (poses, angles
+// and sizes from a fixed seed, so every run and every commit measures the same inputs). About half
+// of the pairs overlap, so both the early out and the full contact paths are measured.
+//
+// Every kernel is run over the whole set repetitions times after one warm up pass; a repetition
+// loops the set enough times to last at least min_repetition_ms. The report gives for each kernel:
+//
+//  - ns/pair: median of the repetitions, and the fastest one
+//  - iqr:     interquartile range / median of the repetitions; a few % on a quiet machine (a single
+//             preempted repetition moves the fastest and the slowest, not the quartiles)
+//  - Mpairs/s from the median
+//  - hits:    fraction of the pairs that generate a contact (same for two kernels of the same test)
+//
+// A new kernel to compare (e.g. a new box-box algorithm) is one more run function and one more line
+// in the kernels table.
+//
+// Usage: narrowphase.exe [pairs] [repetitions]
+//
+
+struct pair_set{
+    int count = 0;
+    std::vector<physic::dim2::body_pose> pose_a, pose_b;
+    std::vector<physic::dim2::collider_box> box_a, box_b;
+    std::vector<physic::dim2::collider_sphere> sphere_a, sphere_b;
+    std::vector<physic::dim2::collider_halfspace> halfspace;       // for the pose_a body
+    std::vector<float> point_x, point_y;                            // for the box of the pose_b body
+};
+
+// ====================================================================================
+// A is around the origin, B at a random direction and a distance up to a bit more than
+// the sum of the sizes: about half of the pairs overlap
+
+static void build_pair_set(pair_set& set, int count){
+
+    const float pi = 3.14159265f;
+
+    set.count = count;
+    set.pose_a.resize(count);
+    set.pose_b.resize(count);
+    set.box_a.resize(count);
+    set.box_b.resize(count);
+    set.sphere_a.resize(count);
+    set.sphere_b.resize(count);
+    set.halfspace.resize(count);
+    set.point_x.resize(count);
+    set.point_y.resize(count);
+
+    for(int i = 0; i < count; i++){
+
+        set.box_a[i].width = random_range(0.5f, 2.0f);
+        set.box_a[i].height = random_range(0.5f, 2.0f);
+        set.box_b[i].width = random_range(0.5f, 2.0f);
+        set.box_b[i].height = random_range(0.5f, 2.0f);
+        set.sphere_a[i].radius = random_range(0.25f, 1.0f);
+        set.sphere_b[i].radius = random_range(0.25f, 1.0f);
+
+        float direction = random_range(-pi, pi);
+        float distance = random_range(0.0f, 2.5f);
+
+        set.pose_a[i] = { 0, random_range(-0.1f, 0.1f), random_range(-0.1f, 0.1f), random_range(-pi, pi) };
+        set.pose_b[i] = { 1, set.pose_a[i].pos_x + distance * cosf(direction), set.pose_a[i].pos_y + distance * sinf(direction), random_range(-pi, pi) };
+
+        // Plane at a signed distance in [-1, 1.5] from the center of A, with a random normal
+        float normal_angle = random_range(-pi, pi);
+        physic::dim2::collider_halfspace& h = set.halfspace[i];
+        h.normal_x = cosf(normal_angle);
+        h.normal_y = sinf(normal_angle);
+        h.origin_offset = h.normal_x * set.pose_a[i].pos_x + h.normal_y * set.pose_a[i].pos_y - random_range(-1.0f, 1.5f);
+
+        // Point up to 1.5 times the half size of the box of B away from its center
+        set.point_x[i] = set.pose_b[i].pos_x + random_range(-0.75f, 0.75f) * set.box_b[i].width;
+        set.point_y[i] = set.pose_b[i].pos_y + random_range(-0.75f, 0.75f) * set.box_b[i].height;
+    }
+}
+
+// ====================================================================================
+// Kernels: one pass over the set, returns the number of contacts (also keeps the
+// compiler from dropping the calls)
+
+static int run_sphere_sphere(pair_set& s){
+    int hits = 0;
+    for(int i = 0; i < s.count; i++)
+        hits += physic::dim2::generate_spheresphere_contactdata_norotation(s.pose_a[i], s.pose_b[i], s.sphere_a[i], s.sphere_b[i]).pen > 0;
+    return hits;
+}
+
+static int run_sphere_box(pair_set& s){
+    int hits = 0;
+    for(int i = 0; i < s.count; i++)
+        hits += physic::dim2::generate_spherebox_contactdata_norotation(s.pose_a[i], s.pose_b[i], s.sphere_a[i], s.box_b[i]).pen > 0;
+    return hits;
+}
+
+static int run_sphere_halfspace(pair_set& s){
+    int hits = 0;
+    for(int i = 0; i < s.count; i++)
+        hits += physic::dim2::generate_spherehalfspace_contactdata(s.pose_a[i], s.sphere_a[i], s.halfspace[i]).pen > 0;
+    return hits;
+}
+
+static int run_box_halfspace(pair_set& s){
+    int hits = 0;
+    for(int i = 0; i < s.count; i++)
+        hits += physic::dim2::generate_boxhalfspace_contactdata(s.pose_a[i], s.box_a[i], s.halfspace[i]).pen > 0;
+    return hits;
+}
+
+// The algorithm used by the dispatcher: deepest vertex of A in B and of B in A
+static int run_box_box_naive(pair_set& s){
+    int hits = 0;
+    for(int i = 0; i < s.count; i++)
+        hits += physic::dim2::generate_boxbox_contactdata_naive_alg(s.pose_a[i], s.pose_b[i], s.box_a[i], s.box_b[i]).pen > 0;
+    return hits;
+}
+
+// One direction only (vertices of A in B): the building block of the naive algorithm
+static int run_box_box_vertices(pair_set& s){
+    int hits = 0;
+    for(int i = 0; i < s.count; i++)
+        hits += physic::dim2::generate_boxboxvertices_max_contactdata(s.pose_a[i], s.pose_b[i], s.box_a[i], s.box_b[i]).pen > 0;
+    return hits;
+}
+
+static int run_point_box(pair_set& s){
+    int hits = 0;
+    for(int i = 0; i < s.count; i++)
+        hits += physic::dim2::generate_pointbox_contactdata_naive_alg(s.point_x[i], s.point_y[i], s.pose_b[i], s.box_b[i]).pen > 0;
+    return hits;
+}
+
+static int run_point_box_check(pair_set& s){
+    int hits = 0;
+    for(int i = 0; i < s.count; i++)
+        hits += physic::dim2::check_pointbox_collision(s.point_x[i], s.point_y[i], s.pose_b[i].pos_x, s.pose_b[i].pos_y, s.pose_b[i].angle, s.box_b[i].width, s.box_b[i].height);
+    return hits;
+}
+
+// Whole dispatch (type switch, contact material) on the box-box pairs
+static int run_dispatch_box_box(pair_set& s){
+    int hits = 0;
+    for(int i = 0; i < s.count; i++)
+        hits += physic::dim2::generate_contactdata(s.pose_a[i], s.box_a[i], s.pose_b[i], s.box_b[i]).pen > 0;
+    return hits;
+}
+
+struct kernel{
+    const char* name;
+    int (*run)(pair_set& set);
+};
+
+static const kernel kernels[] = {
+    { "sphere-sphere",          run_sphere_sphere },
+    { "sphere-box",             run_sphere_box },
+    { "sphere-halfspace",       run_sphere_halfspace },
+    { "box-halfspace",          run_box_halfspace },
+    { "box-box naive",          run_box_box_naive },
+    { "box-box vertices A>B",   run_box_box_vertices },
+    { "point-box contact",      run_point_box },
+    { "point-box check",        run_point_box_check },
+    { "dispatch box-box",       run_dispatch_box_box },
+};
+
+// ====================================================================================
+// Time one kernel and print its report line
+
+static volatile int sink;
+
+static void measure(const kernel& k, pair_set& set, int repetitions){
+
+    const double min_repetition_ms = 5;
+
+    // Warm up (caches, branch predictors, clocks) and calibrate the passes per repetition
+    int hits = k.run(set);
+    int passes = 1;
+    for(;;){
+        auto start = std::chrono::steady_clock::now();
+        for(int p = 0; p < passes; p++)
+            sink = k.run(set);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if(ms >= min_repetition_ms || passes >= (1 << 20))
+            break;
+        passes *= 2;
+    }
+
+    std::vector<double> ns_per_pair(repetitions);
+    for(int r = 0; r < repetitions; r++){
+        auto start = std::chrono::steady_clock::now();
+        for(int p = 0; p < passes; p++)
+            sink = k.run(set);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        ns_per_pair[r] = ns / ((double) passes * set.count);
+    }
+
+    std::sort(ns_per_pair.begin(), ns_per_pair.end());
+    double median = ns_per_pair[repetitions / 2];
+    double iqr = (ns_per_pair[(3 * repetitions) / 4] - ns_per_pair[repetitions / 4]) / median;
+
+    printf("%-22s %10.2f %10.2f %8.1f%% %12.2f %8.1f%%\n",
+        k.name, median, ns_per_pair.front(), 100 * iqr, 1e3 / median, 100.0 * hits / set.count);
+}
+
+int main(int argc, char** argv){
+
+    int pairs = argc > 1 ? atoi(argv[1]) : 4096;
+    int repetitions = argc > 2 ? atoi(argv[2]) : 21;
+    if(pairs <= 0 || repetitions <= 0){
+        printf("usage: narrowphase.exe [pairs] [repetitions]\n");
+        return 2;
+    }
+
+    pair_set set;
+    build_pair_set(set, pairs);
+
+    printf("%d pairs, %d repetitions\n", pairs, repetitions);
+    printf("%-22s %10s %10s %9s %12s %9s\n", "kernel", "ns/pair", "min ns", "iqr", "Mpairs/s", "hits");
+
+    for(const kernel& k : kernels)
+        measure(k, set, repetitions);
+
+    return 0;
+}
@@ -0,0 +1,356 @@
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+
+#include "physic.h"
+#include "bench_random.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                      BENCHMARK: Scene scaling
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Steps generated scenes of growing size and reports where the time of a step goes (see step_profile),
+// to find the size where a stage stops scaling and to compare optimizations across commits:
+//
+//  - pile:  boxes stacked in columns between two walls; contact and solver heavy
+//  - rain:  boxes and spheres falling from a wide band onto the floor; contacts grow during the run
+//  - grid:  spaced lattice of boxes drifting without gravity; broad phase with almost no contacts
+//  - mixed: pile of boxes and spheres of different sizes
+//
+// Every scene is built from a fixed seed, so two commits step the same bodies. The first warmup steps
+// are not measured; the report has one row per scene and size with the mean milliseconds per step of
+// every stage, the mean and max of the whole step, and the mean candidate pairs and contacts per step.
+//
+// Usage: scene_scaling.exe [options]
+//
+//  --format csv|json       output format (default csv), on stdout; the progress goes on stderr
+//  --sizes 100,1000,...    body counts (default 100,300,1000,3000,10000,30000,100000)
+//  --scenes pile,rain,...  scenes to run (default all)
+//  --steps n               measured steps (default 60)
+//  --warmup n              steps before the measure (default 20)
+//  --mode impulse|xpbd     solver mode (default impulse)
+//  --threads n             workers of the job system (default 0: everything on this thread)
+//  --label text            first column of every row, e.g. the commit: the outputs of two commits
+//                          can be concatenated and compared
+//
+
+struct options{
+    std::string format = "csv";
+    std::vector<int> sizes = { 100, 300, 1000, 3000, 10000, 30000, 100000 };
+    std::vector<std::string> scenes = { "pile", "rain", "grid", "mixed" };
+    int steps = 60;
+    int warmup = 20;
+    int threads = 0;
+    std::string label = "-";
+    physic::dim2::world::solver_mode mode = physic::dim2::world::IMPULSE;
+};
+
+struct result{
+    std::string scene;
+    int bodies = 0;
+    physic::dim2::step_profile mean;                                // stages, pairs and contacts averaged over the steps
+    double max_total_ms = 0;
+};
+
+// ====================================================================================
+// Scene generators: bodies_number dynamic bodies plus the static halfspaces
+
+static void add_box(physic::dim2::world& w, int id, float x, float y, float width, float height){
+    physic::dim2::rigidbody rb;
+    rb.pos_x = x;
+    rb.pos_y = y;
+    rb.vel_x = 0;
+    rb.vel_y = 0;
+    rb.m = width * height;
+    rb.I = rb.m * (width * width + height * height) / 12;
+
+    physic::dim2::collider_box box;
+    box.width = width;
+    box.height = height;
+    physic::dim2::add_body(w.bodies, id, &rb, box);
+}
+
+static void add_sphere(physic::dim2::world& w, int id, float x, float y, float radius){
+    physic::dim2::rigidbody rb;
+    rb.pos_x = x;
+    rb.pos_y = y;
+    rb.vel_x = 0;
+    rb.vel_y = 0;
+    rb.m = 3.14159265f * radius * radius;
+    rb.I = rb.m * radius * radius / 2;
+
+    physic::dim2::collider_sphere sphere;
+    sphere.radius = radius;
+    physic::dim2::add_body(w.bodies, id, &rb, sphere);
+}
+
+static void add_halfspace(physic::dim2::world& w, int id, float normal_x, float normal_y, float origin_offset){
+    physic::dim2::collider_halfspace halfspace;
+    halfspace.normal_x = normal_x;
+    halfspace.normal_y = normal_y;
+    halfspace.origin_offset = origin_offset;
+    physic::dim2::add_body(w.bodies, id, nullptr, halfspace);
+}
+
+// Floor and two walls half_width from the center
+static void add_container(physic::dim2::world& w, int first_id, float half_width){
+    add_halfspace(w, first_id, 0, 1, 0);
+    add_halfspace(w, first_id + 1, 1, 0, -half_width);
+    add_halfspace(w, first_id + 2, -1, 0, -half_width);
+}
+
+static void build_pile(physic::dim2::world& w, int bodies_number, bool mixed){
+
+    int columns = std::max(10, (int) std::sqrt((float) bodies_number));
+    float half_width = columns * 0.6f;
+
+    for(int i = 0; i < bodies_number; i++){
+        float x = -half_width + 0.6f + (i % columns) * 1.2f + ((i / columns) % 2) * 0.2f;
+        float y = 0.5f + (i / columns) * 0.99f;                   // rows slightly overlapped: in contact from the first step
+
+        if(mixed && i % 2 == 1)
+            add_sphere(w, i, x, y, random_range(0.3f, 0.5f));
+        else if(mixed)
+            add_box(w, i, x, y, random_range(0.5f, 1.0f), random_range(0.5f, 1.0f));
+        else
+            add_box(w, i, x, y, 1, 1);
+    }
+
+    add_container(w, bodies_number, half_width);
+}
+
+static void build_rain(physic::dim2::world& w, int bodies_number){
+
+    // A band about eight times wider than the pile of the same bodies, falling from up to its width
+    float half_width = 5 * std::max(10.0f, std::sqrt((float) bodies_number));
+    float height = 2 * half_width;
+
+    for(int i = 0; i < bodies_number; i++){
+        float x = random_range(-half_width + 1, half_width - 1);
+        float y = random_range(2, height);
+
+        if(i % 2 == 0)
+            add_box(w, i, x, y, random_range(0.4f, 1.0f), random_range(0.4f, 1.0f));
+        else
+            add_sphere(w, i, x, y, random_range(0.2f, 0.5f));
+
+        w.bodies.vel_y[i] = random_range(-5, 0);
+    }
+
+    add_container(w, bodies_number, half_width);
+}
+
+static void build_grid(physic::dim2::world& w, int bodies_number){
+
+    int columns = std::max(1, (int) std::sqrt((float) bodies_number));
+
+    w.gravity_x = 0;
+    w.gravity_y = 0;
+
+    for(int i = 0; i < bodies_number; i++){
+        add_box(w, i, (i % columns) * 3.0f, (i / columns) * 3.0f, 1, 1);
+        w.bodies.vel_x[i] = random_range(-0.5f, 0.5f);
+        w.bodies.vel_y[i] = random_range(-0.5f, 0.5f);
+        w.bodies.w[i] = random_range(-1, 1);
+    }
+}
+
+static bool build_scene(physic::dim2::world& w, const std::string& scene, int bodies_number){
+
+    random_seed(0x9e3779b9u);
+
+    if(scene == "pile")         build_pile(w, bodies_number, false);
+    else if(scene == "mixed")   build_pile(w, bodies_number, true);
+    else if(scene == "rain")    build_rain(w, bodies_number);
+    else if(scene == "grid")    build_grid(w, bodies_number);
+    else                        return false;
+
+    return true;
+}
+
+// ====================================================================================
+// Run one scene
+
+// Stage times only: the counts are summed apart
+static void add_profile(physic::dim2::step_profile& sum, const physic::dim2::step_profile& step){
+    sum.integration_ms += step.integration_ms;
+    sum.broadphase_ms += step.broadphase_ms;
+    sum.narrowphase_ms += step.narrowphase_ms;
+    sum.solver_ms += step.solver_ms;
+    sum.sync_ms += step.sync_ms;
+    sum.total_ms += step.total_ms;
+}
+
+static bool run_scene(const options& opt, const std::string& scene, int bodies_number, result& out){
+
+    physic::dim2::world w;
+    w.mode = opt.mode;
+    w.parallel = opt.threads > 0;
+    if(!build_scene(w, scene, bodies_number))
+        return false;
+
+    for(int i = 0; i < opt.warmup; i++)
+        physic::dim2::step(w, w.fixed_delta_time);
+
+    w.profile = true;
+
+    physic::dim2::step_profile sum;
+    double pairs = 0, contacts = 0;                                 // summed as doubles: ints overflow at 100k bodies
+    out.max_total_ms = 0;
+
+    for(int i = 0; i < opt.steps; i++){
+        physic::dim2::step(w, w.fixed_delta_time);
+        add_profile(sum, w.last_profile);
+        pairs += w.last_profile.pairs;
+        contacts += w.last_profile.contacts;
+        out.max_total_ms = std::max(out.max_total_ms, w.last_profile.total_ms);
+    }
+
+    double steps = std::max(1, opt.steps);
+    out.scene = scene;
+    out.bodies = bodies_number;
+    out.mean.integration_ms = sum.integration_ms / steps;
+    out.mean.broadphase_ms = sum.broadphase_ms / steps;
+    out.mean.narrowphase_ms = sum.narrowphase_ms / steps;
+    out.mean.solver_ms = sum.solver_ms / steps;
+    out.mean.sync_ms = sum.sync_ms / steps;
+    out.mean.total_ms = sum.total_ms / steps;
+    out.mean.pairs = (int) (pairs / steps + 0.5);
+    out.mean.contacts = (int) (contacts / steps + 0.5);
+
+    return true;
+}
+
+// ====================================================================================
+// Output
+
+static const char* mode_name(physic::dim2::world::solver_mode mode){
+    return mode == physic::dim2::world::IMPULSE ? "impulse" : "xpbd";
+}
+
+static void print_csv_header(){
+    printf("label,scene,bodies,mode,threads,steps,integration_ms,broadphase_ms,narrowphase_ms,solver_ms,sync_ms,total_ms,max_total_ms,pairs,contacts\n");
+}
+
+static void print_csv_row(const options& opt, const result& r){
+    printf("%s,%s,%d,%s,%d,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%d,%d\n",
+        opt.label.c_str(), r.scene.c_str(), r.bodies, mode_name(opt.mode), opt.threads, opt.steps,
+        r.mean.integration_ms, r.mean.broadphase_ms, r.mean.narrowphase_ms, r.mean.solver_ms, r.mean.sync_ms,
+        r.mean.total_ms, r.max_total_ms, r.mean.pairs, r.mean.contacts);
+    fflush(stdout);
+}
+
+static void print_json(const options& opt, const std::vector<result>& results){
+    printf("[\n");
+    for(size_t i = 0; i < results.size(); i++){
+        const result& r = results[i];
+        printf("  {\"label\": \"%s\", \"scene\": \"%s\", \"bodies\": %d, \"mode\": \"%s\", \"threads\": %d, \"steps\": %d, "
+               "\"integration_ms\": %.4f, \"broadphase_ms\": %.4f, \"narrowphase_ms\": %.4f, \"solver_ms\": %.4f, \"sync_ms\": %.4f, "
+               "\"total_ms\": %.4f, \"max_total_ms\": %.4f, \"pairs\": %d, \"contacts\": %d}%s\n",
+            opt.label.c_str(), r.scene.c_str(), r.bodies, mode_name(opt.mode), opt.threads, opt.steps,
+            r.mean.integration_ms, r.mean.broadphase_ms, r.mean.narrowphase_ms, r.mean.solver_ms, r.mean.sync_ms,
+            r.mean.total_ms, r.max_total_ms, r.mean.pairs, r.mean.contacts, i + 1 < results.size() ? "," : "");
+    }
+    printf("]\n");
+}
+
+// ====================================================================================
+// Command line
+
+static std::vector<std::string> split_list(const char* list){
+    std::vector<std::string> items;
+    std::string item;
+    for(const char* c = list; ; c++){
+        if(*c == ',' || *c == 0){
+            if(!item.empty())
+                items.push_back(item);
+            item.clear();
+            if(*c == 0)
+                break;
+        }else{
+            item += *c;
+        }
+    }
+    return items;
+}
+
+static bool parse_options(int argc, char** argv, options& out){
+
+    for(int i = 1; i < argc; i++){
+        const char* arg = argv[i];
+        if(i + 1 >= argc)
+            return false;
+        const char* value = argv[++i];
+
+        if(strcmp(arg, "--format") == 0)            out.format = value;
+        else if(strcmp(arg, "--scenes") == 0)       out.scenes = split_list(value);
+        else if(strcmp(arg, "--steps") == 0)        out.steps = atoi(value);
+        else if(strcmp(arg, "--warmup") == 0)       out.warmup = atoi(value);
+        else if(strcmp(arg, "--threads") == 0)      out.threads = atoi(value);
+        else if(strcmp(arg, "--label") == 0)        out.label = value;
+        else if(strcmp(arg, "--sizes") == 0){
+            out.sizes.clear();
+            for(const std::string& size : split_list(value))
+                out.sizes.push_back(atoi(size.c_str()));
+        }
+        else if(strcmp(arg, "--mode") == 0){
+            if(strcmp(value, "impulse") == 0)       out.mode = physic::dim2::world::IMPULSE;
+            else if(strcmp(value, "xpbd") == 0)     out.mode = physic::dim2::world::XPBD;
+            else return false;
+        }
+        else return false;
+    }
+
+    for(int size : out.sizes)
+        if(size <= 0)
+            return false;
+
+    return (out.format == "csv" || out.format == "json") && out.steps > 0 && out.warmup >= 0 && out.threads >= 0;
+}
+
+int main(int argc, char** argv){
+
+    options opt;
+    if(!parse_options(argc, argv, opt)){
+        printf("usage: scene_scaling.exe [--format csv|json] [--sizes 100,1000,...] [--scenes pile,rain,grid,mixed] "
+               "[--steps n] [--warmup n] [--mode impulse|xpbd] [--threads n] [--label text]\n");
+        return 2;
+    }
+
+    if(opt.threads > 0)
+        jobs::start(opt.threads);
+
+    // CSV rows are printed as soon as they are measured, JSON at the end
+    if(opt.format == "csv")
+        print_csv_header();
+
+    std::vector<result> results;
+    for(const std::string& scene : opt.scenes){
+        for(int size : opt.sizes){
+            fprintf(stderr, "%s %d...\n", scene.c_str(), size);
+
+            result r;
+            if(!run_scene(opt, scene, size, r)){
+                fprintf(stderr, "unknown scene %s\n", scene.c_str());
+                return 2;
+            }
+
+            if(opt.format == "csv")
+                print_csv_row(opt, r);
+            results.push_back(r);
+        }
+    }
+
+    if(opt.format == "json")
+        print_json(opt, results);
+
+    if(opt.threads > 0)
+        jobs::stop();
+
+    return 0;
+}
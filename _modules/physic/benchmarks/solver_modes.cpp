@@ -0,0 +1,141 @@
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+
+#include "physic.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                      BENCHMARK: Impulse vs XPBD solver modes
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Drops a pile of boxes inside a container made of three halfspaces and steps it with both solver
+// modes, reporting for each one:
+//
+//  - Step cost: mean and max milliseconds per step
+//  - Settling quality: kinetic energy and max contact penetration at the end of the run, mean height
+//    of the boxes (a sinking pile has a lower mean height) and the first step after which the
+//    kinetic energy stays below the rest threshold
+//
+// Usage: solver_modes.exe [boxes] [steps]
+//
+
+struct scene{
+    physic::dim2::world world;
+};
+
+// ====================================================================================
+// Build a pile of boxes_number boxes over a floor, between two walls
+
+static void build_pile_scene(scene& s, int boxes_number){
+
+    int columns = 10;
+
+    physic::dim2::clear_bodies(s.world.bodies);
+
+    for(int i = 0; i < boxes_number; i++){
+        physic::dim2::rigidbody rb;
+        rb.pos_x = -5.0f + (i % columns) * 1.05f + ((i / columns) % 2) * 0.3f;
+        rb.pos_y = 0.6f + (i / columns) * 1.1f;
+        rb.vel_x = 0;
+        rb.vel_y = 0;
+        rb.angle = 0.05f * (i % 7);
+
+        physic::dim2::collider_box box;
+        box.width = 1;
+        box.height = 1;
+
+        physic::dim2::add_body(s.world.bodies, i, &rb, box);
+    }
+
+    // Floor, left wall, right wall
+    physic::dim2::collider_halfspace halfspaces[3];
+    halfspaces[0].normal_x = 0;   halfspaces[0].normal_y = 1;   halfspaces[0].origin_offset = 0;
+    halfspaces[1].normal_x = 1;   halfspaces[1].normal_y = 0;   halfspaces[1].origin_offset = -6;
+    halfspaces[2].normal_x = -1;  halfspaces[2].normal_y = 0;   halfspaces[2].origin_offset = -6;
+
+    for(int i = 0; i < 3; i++)
+        physic::dim2::add_body(s.world.bodies, boxes_number + i, nullptr, halfspaces[i]);
+}
+
+// ====================================================================================
+// Kinetic energy of the dynamic rows
+
+static float kinetic_energy(const physic::dim2::body_storage& bodies){
+    float energy = 0;
+    for(int i = 0; i < physic::dim2::body_count(bodies); i++){
+        if(bodies.is_static[i])
+            continue;
+        energy += 0.5f * bodies.m[i] * (bodies.vel_x[i] * bodies.vel_x[i] + bodies.vel_y[i] * bodies.vel_y[i]) 
+                + 0.5f * bodies.I[i] * bodies.w[i] * bodies.w[i];
+    }
+    return energy;
+}
+
+// ====================================================================================
+// Run the scene and print one report line
+
+static void run(physic::dim2::world::solver_mode mode, const char* mode_name, int boxes_number, int steps){
+
+    const float delta_time = 1.0f / 60.0f;
+    const float rest_energy = 0.01f;
+
+    scene s;
+    build_pile_scene(s, boxes_number);
+    s.world.mode = mode;
+
+    double total_ms = 0;
+    double max_ms = 0;
+    int settled_step = -1;
+
+    for(int i = 0; i < steps; i++){
+
+        auto start = std::chrono::steady_clock::now();
+        physic::dim2::step(s.world, delta_time);
+        auto end = std::chrono::steady_clock::now();
+
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        total_ms += ms;
+        max_ms = std::max(max_ms, ms);
+
+        float energy = kinetic_energy(s.world.bodies);
+
+        if(energy < rest_energy * boxes_number){
+            if(settled_step < 0) settled_step = i;
+        }else{
+            settled_step = -1;
+        }
+    }
+
+    // ------------------------------------------------------------------------------------
+    // Settling quality at the end of the run
+
+    float energy = kinetic_energy(s.world.bodies);
+    float mean_height = 0;
+    for(int i = 0; i < physic::dim2::body_count(s.world.bodies); i++){
+        if(!s.world.bodies.is_static[i])
+            mean_height += s.world.bodies.pos_y[i] / boxes_number;
+    }
+
+    float max_pen = 0;
+    for(auto& contact : s.world.contacts)
+        max_pen = std::max(max_pen, contact.pen);
+
+    printf("%-8s %6d %8.3f %8.3f %12.4f %10.4f %10.3f %10d\n",
+        mode_name, boxes_number, total_ms / steps, max_ms, energy, max_pen, mean_height, settled_step);
+}
+
+int main(int argc, char** argv){
+
+    int boxes_number = argc > 1 ? atoi(argv[1]) : 60;
+    int steps = argc > 2 ? atoi(argv[2]) : 600;
+
+    printf("%-8s %6s %8s %8s %12s %10s %10s %10s\n",
+        "mode", "boxes", "ms/step", "max ms", "k-energy", "max pen", "mean y", "settled at");
+
+    run(physic::dim2::world::IMPULSE, "impulse", boxes_number, steps);
+    run(physic::dim2::world::XPBD, "xpbd", boxes_number, steps);
+
+    return 0;
+}
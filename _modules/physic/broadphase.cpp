@@ -0,0 +1,258 @@
+#include "physic.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                       COLLISION DETECTION: BROAD PHASE
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// =========================================================================|
+//                                compute_aabb
+// =========================================================================|
+// World space AABB of a collider; the half extents of a rotated box are
+// the projections of its half diagonals on the axes.
+// Halfspaces get an infinite AABB.
+//
+physic::dim2::aabb physic::dim2::compute_aabb(float pos_x, float pos_y, float angle, const collider& coll){
+
+    switch(coll.type){
+
+        case collider::BOX: {
+            const collider_box& box = (const collider_box&) coll;
+            float c = std::fabs(std::cos(angle));
+            float s = std::fabs(std::sin(angle));
+            float half_x = c * box.width * 0.5f + s * box.height * 0.5f;
+            float half_y = s * box.width * 0.5f + c * box.height * 0.5f;
+            return { pos_x - half_x, pos_y - half_y, pos_x + half_x, pos_y + half_y };
+        }
+
+        case collider::SPHERE: {
+            const collider_sphere& sphere = (const collider_sphere&) coll;
+            return { pos_x - sphere.radius, pos_y - sphere.radius, pos_x + sphere.radius, pos_y + sphere.radius };
+        }
+
+        default: {
+            float inf = std::numeric_limits<float>::infinity();
+            return { -inf, -inf, inf, inf };
+        }
+    }
+}
+
+physic::dim2::aabb physic::dim2::compute_aabb(const rigidbody* rb, const collider& coll){
+    if(rb == nullptr)
+        return compute_aabb(0, 0, 0, coll);
+    return compute_aabb(rb->pos_x, rb->pos_y, rb->angle, coll);
+}
+
+bool physic::dim2::aabb_overlap(const aabb& a, const aabb& b){
+    return a.min_x <= b.max_x && b.min_x <= a.max_x && a.min_y <= b.max_y && b.min_y <= a.max_y;
+}
+
+// =========================================================================|
+//                              build_broadphase
+// =========================================================================|
+// The proxies of the last build are kept (in their order) if they still
+// point to a finite row; the finite rows without a proxy are appended.
+// The insertion sort gives up after insertion_sort_budget moves per proxy
+// (the order of the last build is useless after the deterministic mode 
+// reorders the rows or after a big spawn) and std::sort takes over.
+// Ties are broken by index: both sorts give the same order, which must not
+// depend on the sort implementation.
+//
+
+static const int aabb_grain = 512;
+static const int sweep_grain = 256;
+static const int insertion_sort_budget = 8;
+
+void physic::dim2::build_broadphase(broadphase& bp, const body_storage& bodies, bool parallel){
+
+    int count = body_count(bodies);
+
+    bp.boxes.resize(count);
+    bp.halfspaces.clear();
+    bp.max_width = 0;
+
+    // AABB update: streams the pose columns
+    parallel_for(parallel, count, aabb_grain, [&](int begin, int end, int){
+        for(int i = begin; i < end; i++)
+            bp.boxes[i] = compute_aabb(bodies.pos_x[i], bodies.pos_y[i], bodies.angle[i], shape_collider(bodies.shape[i]));
+    });
+
+    // ------------------------------------------------------------------------------------
+    // Proxies
+
+    bp.listed.assign(count, 0);
+
+    int kept = 0;
+    for(int a = 0; a < bp.sorted.size(); a++){
+        int i = bp.sorted[a];
+        if(i < count && bodies.shape[i].type != collider::HALFSPACE && !bp.listed[i]){
+            bp.sorted[kept++] = i;
+            bp.listed[i] = 1;
+        }
+    }
+    bp.sorted.resize(kept);
+
+    for(int i = 0; i < count; i++){
+        if(bodies.shape[i].type == collider::HALFSPACE){
+            bp.halfspaces.push_back(i);
+        }else{
+            if(!bp.listed[i])
+                bp.sorted.push_back(i);
+            bp.max_width = std::max(bp.max_width, bp.boxes[i].max_x - bp.boxes[i].min_x);
+        }
+    }
+
+    // ------------------------------------------------------------------------------------
+    // Sort
+
+    auto less = [&](int a, int b){
+        if(bp.boxes[a].min_x != bp.boxes[b].min_x)
+            return bp.boxes[a].min_x < bp.boxes[b].min_x;
+        return a < b;
+    };
+
+    int64_t moves_left = (int64_t) insertion_sort_budget * bp.sorted.size();
+
+    for(int a = 1; a < bp.sorted.size() && moves_left >= 0; a++){
+        int i = bp.sorted[a];
+        int b = a;
+        for(; b > 0 && less(i, bp.sorted[b - 1]); b--)
+            bp.sorted[b] = bp.sorted[b - 1];
+        bp.sorted[b] = i;
+        moves_left -= a - b;
+    }
+
+    if(moves_left < 0)
+        std::sort(bp.sorted.begin(), bp.sorted.end(), less);
+}
+
+// =========================================================================|
+//                              broadphase_pairs
+// =========================================================================|
+// Candidate pairs (i < j) of bodies whose AABBs overlap; pairs of two
+// static bodies are skipped.
+// A body is paired with a halfspace when the nearest point of its AABB
+// along the halfspace normal is inside the halfspace:
+//
+//      n·c - offset - (e_x |n_x| + e_y |n_y|) <= 0
+//
+// with c the center and e the half extents of the AABB.
+//
+void physic::dim2::broadphase_pairs(const broadphase& bp, const body_storage& bodies, arena_array<std::pair<int, int>>& out_pairs, bool parallel){
+
+    // Every chunk of the sorted bodies sweeps into its own buffer (in the arena of out_pairs)
+    int chunks = chunks_number(bp.sorted.size(), sweep_grain);
+    arena_array<std::pair<int, int>>* chunk_pairs = arena_allocate<arena_array<std::pair<int, int>>>(*out_pairs.arena, chunks);
+
+    parallel_for(parallel, bp.sorted.size(), sweep_grain, [&](int begin, int end, int chunk){
+
+        arena_array<std::pair<int, int>>& pairs = chunk_pairs[chunk];
+        new (&pairs) arena_array<std::pair<int, int>>{out_pairs.arena};
+
+        for(int a = begin; a < end; a++){
+            int i = bp.sorted[a];
+            const aabb& box_i = bp.boxes[i];
+
+            // ------------------------------------------------------------------------------------
+            // Sweep along x
+
+            for(int b = a + 1; b < bp.sorted.size(); b++){
+                int j = bp.sorted[b];
+                const aabb& box_j = bp.boxes[j];
+
+                if(box_j.min_x > box_i.max_x)
+                    break;
+
+                if(bodies.is_static[i] && bodies.is_static[j])
+                    continue;
+
+                if(box_i.min_y <= box_j.max_y && box_j.min_y <= box_i.max_y)
+                    pairs.push_back({ std::min(i, j), std::max(i, j) });
+            }
+
+            // ------------------------------------------------------------------------------------
+            // Halfspaces against the body
+
+            if(bodies.is_static[i])
+                continue;
+
+            float c_x = (box_i.min_x + box_i.max_x) * 0.5f;
+            float c_y = (box_i.min_y + box_i.max_y) * 0.5f;
+            float e_x = (box_i.max_x - box_i.min_x) * 0.5f;
+            float e_y = (box_i.max_y - box_i.min_y) * 0.5f;
+
+            for(int h : bp.halfspaces){
+                const collider_halfspace& coll_H = bodies.shape[h].halfspace;
+
+                float distance = c_x * coll_H.normal_x + c_y * coll_H.normal_y - coll_H.origin_offset
+                    - (e_x * std::fabs(coll_H.normal_x) + e_y * std::fabs(coll_H.normal_y));
+
+                if(distance <= 0)
+                    pairs.push_back({ std::min(i, h), std::max(i, h) });
+            }
+        }
+    });
+
+    int total = 0;
+    for(int chunk = 0; chunk < chunks; chunk++)
+        total += chunk_pairs[chunk].size();
+
+    out_pairs.clear();
+    out_pairs.reserve(total);
+    for(int chunk = 0; chunk < chunks; chunk++)
+        out_pairs.append(chunk_pairs[chunk].begin(), chunk_pairs[chunk].end());
+
+    std::sort(out_pairs.begin(), out_pairs.end());
+}
+
+// =========================================================================|
+//                                all_pairs
+// =========================================================================|
+// Small scenes: every pair but the static-static ones, already in the order
+// of broadphase_pairs. The pairs the broad phase would have culled don't
+// generate contacts, so the contacts are the same.
+//
+void physic::dim2::all_pairs(const body_storage& bodies, arena_array<std::pair<int, int>>& out_pairs){
+
+    int count = body_count(bodies);
+
+    out_pairs.clear();
+    out_pairs.reserve(count * (count - 1) / 2);
+
+    for(int i = 0; i < count; i++){
+        for(int j = i + 1; j < count; j++){
+            if(!bodies.is_static[i] || !bodies.is_static[j])
+                out_pairs.push_back({ i, j });
+        }
+    }
+}
+
+// =========================================================================|
+//                              broadphase_query
+// =========================================================================|
+// Finite bodies whose AABB overlaps the region, sorted by index.
+// The sweep starts from the first AABB that could still reach the region:
+// min_x >= region.min_x - max_width.
+//
+void physic::dim2::broadphase_query(const broadphase& bp, const aabb& region, std::vector<int>& out_bodies){
+
+    out_bodies.clear();
+
+    float first_min_x = region.min_x - bp.max_width;
+    auto it = std::lower_bound(bp.sorted.begin(), bp.sorted.end(), first_min_x, [&](int i, float value){
+        return bp.boxes[i].min_x < value;
+    });
+
+    for(; it != bp.sorted.end(); ++it){
+        const aabb& box = bp.boxes[*it];
+        if(box.min_x > region.max_x)
+            break;
+        if(aabb_overlap(box, region))
+            out_bodies.push_back(*it);
+    }
+
+    std::sort(out_bodies.begin(), out_bodies.end());
+}
@@ -0,0 +1,32 @@
+if not exist "binaries/" mkdir binaries
+
+cl /c /O2 /EHsc /fp:precise /Fo"binaries/" ^
+/I "..\includes" ^
+/I "..\..\opengl-libs\includes" ^
+/I "..\..\jobs\includes" ^
+..\physic.cpp ^
+..\joints.cpp ^
+..\world.cpp ^
+..\integrator.cpp ^
+..\broadphase.cpp ^
+..\parallel.cpp ^
+..\arena.cpp ^
+..\state.cpp ^
+..\scene.cpp ^
+..\batch.cpp ^
+..\..\jobs\jobs.cpp ^
+headless.cpp
+
+cl /Fe: headless.exe ^
+binaries\physic.obj ^
+binaries\joints.obj ^
+binaries\world.obj ^
+binaries\integrator.obj ^
+binaries\broadphase.obj ^
+binaries\parallel.obj ^
+binaries\arena.obj ^
+binaries\state.obj ^
+binaries\scene.obj ^
+binaries\batch.obj ^
+binaries\jobs.obj ^
+binaries\headless.obj
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Headless runner for Linux / macOS: the physic module and the job system only (no GLFW, GL or ImGui).
+# Usage: ./_build.sh [compiler]   (default c++)
+
+set -e
+cd "$(dirname "$0")"
+
+CXX="${1:-c++}"
+
+"$CXX" -std=c++14 -O2 -pthread \
+    -I ../includes \
+    -I ../../opengl-libs/includes \
+    -I ../../jobs/includes \
+    ../physic.cpp \
+    ../joints.cpp \
+    ../world.cpp \
+    ../integrator.cpp \
+    ../broadphase.cpp \
+    ../parallel.cpp \
+    ../arena.cpp \
+    ../state.cpp \
+    ../scene.cpp \
+    ../batch.cpp \
+    ../../jobs/jobs.cpp \
+    headless.cpp \
+    -o headless
@@ -0,0 +1,191 @@
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+#include "physic.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                           HEADLESS SIMULATION RUNNER
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Runs a scene with the physic module alone (no window, no GL, no ImGui): loads the scene, steps it
+// a fixed number of fixed_delta_time steps and prints the timing of the steps and a summary of the
+// final state. The final state can be written as a text scene, to diff it or to load it again.
+// Meant for batch jobs and CI benchmarks on machines without a display.
+//
+// Usage: headless <scene> [steps] [options]
+//
+//  <scene>             binary scene, or text scene (compiled in its .bin cache, see open_scene_text)
+//  steps               number of fixed steps (default 600)
+//  --mode impulse|xpbd solver mode (default impulse)
+//  --dt <seconds>      fixed_delta_time (default the one of the world)
+//  --threads <n>       run the parallel stages on n workers (default 0: everything on this thread)
+//  --deterministic     deterministic world (rows sorted by id, checksum at every step)
+//  --out <path>        write the final state as a text scene
+//
+// The exit code is 0 only if the scene was loaded and the final state written (if asked).
+//
+
+struct options{
+    const char* scene_path = nullptr;
+    const char* out_path = nullptr;
+    int steps = 600;
+    int threads = 0;
+    float delta_time = 0;                                           // 0 = default of the world
+    bool deterministic = false;
+    physic::dim2::world::solver_mode mode = physic::dim2::world::IMPULSE;
+};
+
+static void print_usage(){
+    printf("usage: headless <scene> [steps] [--mode impulse|xpbd] [--dt seconds] [--threads n] [--deterministic] [--out path]\n");
+}
+
+static bool parse_options(int argc, char** argv, options& out){
+
+    for(int i = 1; i < argc; i++){
+        const char* arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if(strcmp(arg, "--mode") == 0 && has_value){
+            const char* mode = argv[++i];
+            if(strcmp(mode, "impulse") == 0)        out.mode = physic::dim2::world::IMPULSE;
+            else if(strcmp(mode, "xpbd") == 0)      out.mode = physic::dim2::world::XPBD;
+            else return false;
+        }
+        else if(strcmp(arg, "--dt") == 0 && has_value)          out.delta_time = (float) atof(argv[++i]);
+        else if(strcmp(arg, "--threads") == 0 && has_value)     out.threads = atoi(argv[++i]);
+        else if(strcmp(arg, "--out") == 0 && has_value)         out.out_path = argv[++i];
+        else if(strcmp(arg, "--deterministic") == 0)            out.deterministic = true;
+        else if(arg[0] == '-')                                  return false;
+        else if(!out.scene_path)                                out.scene_path = arg;
+        else                                                    out.steps = atoi(arg);
+    }
+
+    return out.scene_path != nullptr && out.steps >= 0 && out.threads >= 0 && out.delta_time >= 0;
+}
+
+// ====================================================================================
+// Open the scene as binary, then as text
+
+static bool open_any_scene(const char* path, physic::dim2::scene_file& out_scene){
+
+    if(physic::dim2::open_scene(path, out_scene))
+        return true;
+
+    std::string error;
+    if(physic::dim2::open_scene_text(path, out_scene, &error))
+        return true;
+
+    fprintf(stderr, "headless: can't load %s: %s\n", path, error.empty() ? "not a scene" : error.c_str());
+    return false;
+}
+
+// ====================================================================================
+// Step timing
+
+static double percentile(std::vector<double>& sorted_ms, double p){
+    if(sorted_ms.empty())
+        return 0;
+    size_t index = (size_t) (p * (sorted_ms.size() - 1) + 0.5);
+    return sorted_ms[index];
+}
+
+int main(int argc, char** argv){
+
+    options opt;
+    if(!parse_options(argc, argv, opt)){
+        print_usage();
+        return 2;
+    }
+
+    // ------------------------------------------------------------------------------------
+    // Load
+
+    physic::dim2::world world;
+    world.mode = opt.mode;
+    world.deterministic = opt.deterministic;
+    if(opt.delta_time > 0)
+        world.fixed_delta_time = opt.delta_time;
+
+    auto load_begin = std::chrono::steady_clock::now();
+
+    physic::dim2::scene_file scene;
+    if(!open_any_scene(opt.scene_path, scene))
+        return 1;
+    physic::dim2::load_scene(world, scene.view);
+    physic::dim2::close_scene(scene);
+
+    double load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - load_begin).count();
+
+    if(opt.threads > 0){
+        jobs::start(opt.threads);
+        world.parallel = true;
+    }
+
+    // ------------------------------------------------------------------------------------
+    // Run
+
+    std::vector<double> step_ms(opt.steps);
+
+    auto run_begin = std::chrono::steady_clock::now();
+    for(int i = 0; i < opt.steps; i++){
+        auto step_begin = std::chrono::steady_clock::now();
+        physic::dim2::step(world, world.fixed_delta_time);
+        step_ms[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - step_begin).count();
+    }
+    double run_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - run_begin).count();
+
+    if(opt.threads > 0)
+        jobs::stop();
+
+    // ------------------------------------------------------------------------------------
+    // Report: one "key value" per line, easy to grep in the logs of a batch job
+
+    std::vector<double> sorted_ms = step_ms;
+    std::sort(sorted_ms.begin(), sorted_ms.end());
+
+    const physic::dim2::body_storage& bodies = world.bodies;
+    int dynamic_bodies = 0;
+    float max_speed = 0;
+    for(int i = 0; i < physic::dim2::body_count(bodies); i++){
+        if(bodies.is_static[i])
+            continue;
+        dynamic_bodies++;
+        max_speed = std::max(max_speed, sqrtf(bodies.vel_x[i] * bodies.vel_x[i] + bodies.vel_y[i] * bodies.vel_y[i]));
+    }
+
+    printf("scene            %s\n", opt.scene_path);
+    printf("mode             %s\n", opt.mode == physic::dim2::world::IMPULSE ? "impulse" : "xpbd");
+    printf("threads          %d\n", opt.threads);
+    printf("bodies           %d\n", physic::dim2::body_count(bodies));
+    printf("dynamic_bodies   %d\n", dynamic_bodies);
+    printf("steps            %d\n", opt.steps);
+    printf("delta_time       %g\n", world.fixed_delta_time);
+    printf("load_ms          %.3f\n", load_ms);
+    printf("total_ms         %.3f\n", run_ms);
+    printf("mean_step_ms     %.4f\n", opt.steps > 0 ? run_ms / opt.steps : 0.0);
+    printf("min_step_ms      %.4f\n", sorted_ms.empty() ? 0.0 : sorted_ms.front());
+    printf("p50_step_ms      %.4f\n", percentile(sorted_ms, 0.50));
+    printf("p99_step_ms      %.4f\n", percentile(sorted_ms, 0.99));
+    printf("max_step_ms      %.4f\n", sorted_ms.empty() ? 0.0 : sorted_ms.back());
+    printf("contacts         %d\n", world.contacts.size());
+    printf("max_speed        %g\n", max_speed);
+    printf("checksum         %016llx\n", (unsigned long long) physic::dim2::world_checksum(world));
+
+    // ------------------------------------------------------------------------------------
+    // Final state
+
+    if(opt.out_path){
+        if(!physic::dim2::write_scene_text(opt.out_path, bodies)){
+            fprintf(stderr, "headless: can't write %s\n", opt.out_path);
+            return 1;
+        }
+        printf("final_state      %s\n", opt.out_path);
+    }
+
+    return 0;
+}
@@ -1,8 +1,21 @@
+#pragma once
+
 #include <vector>
 #include <utility>
 #include <map>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <string>
 
 #include "linmath.h"
+#include "jobs.h"
 
 namespace physic{
 
@@ -12,6 +25,8 @@ namespace physic{
 
     namespace dim2{
 
+        struct world;
+
         ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
         //                                                 UTILITY
         ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -19,6 +34,130 @@ namespace physic{
 
         void build_model_matrix(mat4x4& model_matrix, float x_pos, float y_pos, float z_angle);
 
+        ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        //                                           PARALLEL EXECUTION
+        ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        // The parallel stages run on the shared job system (see jobs.h).
+        //
+        // parallel_for splits [0, count) in chunks of grain elements and calls fn(begin, end, chunk) once
+        // per chunk. The chunks only depend on count and grain, never on the number of threads: a stage
+        // that writes its results in per-chunk buffers and merges them in chunk order gives the same 
+        // output with any number of workers. With parallel == false (or without a started job system)
+        // the chunks run in order on the calling thread.
+        // The stage lambda is passed by reference: wrapping it doesn't allocate.
+
+        void parallel_for_chunks(bool parallel, int count, int grain, const std::function<void(int begin, int end, int chunk)>& fn);
+
+        template<typename Fn>
+        void parallel_for(bool parallel, int count, int grain, const Fn& fn){
+            parallel_for_chunks(parallel, count, grain, std::cref(fn));
+        }
+
+        inline int chunks_number(int count, int grain){ return (count + grain - 1) / grain; }
+
+        ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        //                                              STEP ARENA
+        ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        // Linear allocator for the data that lives only until the next step: the contacts, the candidate pairs, 
+        // the per-chunk buffers of the parallel stages and the solver scratch. The memory is a single block;
+        // an allocation bumps the top (atomically, the chunks of a parallel stage allocate concurrently) and 
+        // nothing is freed one by one: reset_arena takes the top back to 0 at the beginning of every step.
+        //
+        // If a step asks more than the block holds, the excess is served from the heap ("spills") and the
+        // next reset frees the spills and grows the block past the high water mark: after the first steps 
+        // of a scene the simulation doesn't touch the heap anymore.
+        //
+        // A stage that repeats inside a step (the XPBD substeps) takes a mark and rewinds to it before
+        // every repetition, so the arena holds one repetition at a time.
+        //
+        // Every world has its own arena (world::memory): worlds stepped on different threads never share it.
+        // Arena memory is never destroyed: only trivially copyable types.
+
+        struct step_arena{
+            std::vector<std::max_align_t> block;
+            std::atomic<size_t> top{0};                             // bytes requested since the last reset (spills included)
+
+            size_t high_water = 0;                                  // max bytes used by a step
+            size_t last_step_bytes = 0;                             // bytes used by the last step
+            size_t step_peak = 0;                                   // max top before a rewind in the current step
+
+            std::mutex spill_mutex;
+            std::vector<std::unique_ptr<std::max_align_t[]>> spills;
+        };
+
+        void reserve_arena(step_arena& arena, size_t bytes);
+        void reset_arena(step_arena& arena);                        // invalidates everything allocated from the arena
+        void* arena_allocate(step_arena& arena, size_t bytes);
+        size_t arena_capacity(const step_arena& arena);
+
+        // Rewinding invalidates everything allocated after the mark
+        size_t arena_mark(const step_arena& arena);
+        void arena_rewind(step_arena& arena, size_t mark);
+
+        template<typename T>
+        T* arena_allocate(step_arena& arena, int count){
+            return count > 0 ? static_cast<T*>(arena_allocate(arena, sizeof(T) * count)) : nullptr;
+        }
+
+        // ====================================================================================
+        // Arena array:
+        // Growable array in the arena (the subset of std::vector the step uses). Growing moves the elements
+        // in a new block of twice the capacity, the old one is left to the next reset. clear() drops the
+        // storage too: an array must be cleared before it's used again after a reset.
+        // The arena is set at construction (arena_array<T>{&arena}) and never changes.
+
+        template<typename T>
+        struct arena_array{
+            step_arena* arena = nullptr;
+            T* data = nullptr;
+            int count = 0;
+            int capacity = 0;
+
+            int size() const                        { return count; }
+            bool empty() const                      { return count == 0; }
+            T& operator[](int i)                    { return data[i]; }
+            const T& operator[](int i) const        { return data[i]; }
+            T* begin()                              { return data; }
+            T* end()                                { return data + count; }
+            const T* begin() const                  { return data; }
+            const T* end() const                    { return data + count; }
+
+            void clear(){
+                data = nullptr;
+                count = 0;
+                capacity = 0;
+            }
+
+            void reserve(int new_capacity){
+                if(new_capacity <= capacity)
+                    return;
+                T* grown = arena_allocate<T>(*arena, new_capacity);
+                for(int i = 0; i < count; i++)
+                    new (grown + i) T(data[i]);
+                data = grown;
+                capacity = new_capacity;
+            }
+
+            void resize(int new_count){
+                reserve(new_count);
+                count = new_count;
+            }
+
+            void push_back(const T& value){
+                if(count == capacity)
+                    reserve(capacity > 0 ? capacity * 2 : 16);
+                new (data + count++) T(value);
+            }
+
+            void append(const T* first, const T* last){
+                int n = (int) (last - first);
+                reserve(count + n);
+                for(int i = 0; i < n; i++)
+                    new (data + count + i) T(first[i]);
+                count += n;
+            }
+        };
+
         ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
         //                                           DINAMYC SIMULATION
         ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -39,6 +178,14 @@ namespace physic{
             // Inertia values
             float m = 1;
             float I = 1;
+
+            // Pose at the beginning of the last world step; used to interpolate the rendering
+            float prev_pos_x = 0, prev_pos_y = 0;
+            float prev_angle = 0;
+
+            // Force and torque accumulated for the next world step (cleared at the end of the step)
+            float force_x = 0, force_y = 0;
+            float torque = 0;
         };
 
         struct impulse{
@@ -52,6 +199,11 @@ namespace physic{
 
         void numeric_integration(rigidbody& rb, float delta_time, float tot_f_x, float tot_f_y, float tot_torq);
         void apply_impulse(rigidbody& rb, impulse imp);
+
+        // Accumulate a force (at the center of mass or at the world space lever arm r) or a torque
+        void apply_force(rigidbody& rb, float f_x, float f_y);
+        void apply_force_at_point(rigidbody& rb, float f_x, float f_y, float r_x, float r_y);
+        void apply_torque(rigidbody& rb, float torque);
         
 
         ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -65,6 +217,11 @@ namespace physic{
         struct collider{
             enum collider_type {BOX, SPHERE, HALFSPACE};
             collider_type type;
+
+            // Surface material; the values of the two colliders in contact are mixed
+            // when the contact is generated (see set_contact_material)
+            float friction = 0.5f;                  // Coulomb friction coefficient
+            float restitution = 0.3f;               // 0 = perfectly inelastic, 1 = perfectly elastic
         };
 
         struct collider_box : collider{
@@ -84,6 +241,20 @@ namespace physic{
             float origin_offset;
         };
 
+        // ------------------------------------------------------------------------------------
+        // Collider of any type stored by value; type selects the member in use
+
+        struct collider_shape{
+            collider::collider_type type = collider::BOX;
+            collider_box box;
+            collider_sphere sphere;
+            collider_halfspace halfspace;
+        };
+
+        collider& shape_collider(collider_shape& shape);
+        const collider& shape_collider(const collider_shape& shape);
+        collider_shape make_shape(const collider& coll);
+
         // ====================================================================================
         // Collision detection functions:
         
@@ -99,6 +270,210 @@ namespace physic{
             float width, float height                               // Dimensions of the box
         );
 
+        ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        //                                              BODY STORAGE
+        ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        // The bodies of a world live in a structure of arrays: every column holds one quantity of all the 
+        // bodies and the r-esimo element of every column belongs to the body stored in row r. The stages of the 
+        // step (integration, AABB update, narrow phase, solver) stream the columns they need instead of 
+        // striding over whole rigidbodies.
+        //
+        // Rows are not stable: the deterministic mode reorders them by id and remove_body moves the last row
+        // in the hole. A body (and its collider, a column of the same row) is referenced from outside the
+        // world by the handle returned by add_body; body_row translates it to its current row.
+        // Static bodies (halfspaces) have a row too, with is_static set and inv_mass = inv_inertia = 0;
+        // contacts and joints reference them with row -1.
+        //
+        // rigidbody stays the per-body value type used to read and write a whole row (read_body/write_body).
+
+        // ====================================================================================
+        // Generational handle:
+        // index of a slot of the handle table plus the generation of the slot when the handle was given.
+        // Removing a body frees its slot and increments the slot generation, so the old handles of the 
+        // slot stop resolving (body_row returns -1) even after the slot is given to a new body.
+
+        struct body_handle{
+            int index = -1;
+            uint32_t generation = 0;
+        };
+
+        inline bool operator==(body_handle a, body_handle b){ return a.index == b.index && a.generation == b.generation; }
+        inline bool operator!=(body_handle a, body_handle b){ return !(a == b); }
+
+        const body_handle null_body = { -1, 0 };
+
+        // ====================================================================================
+        // Column block:
+        // The columns come from the heap, or from a column block shared by many storages (the envs of an 
+        // env_batch keep all their columns in one allocation, env after env). A block only bumps its top:
+        // the memory it gives is never taken back and a column that grows past its reserve moves to the 
+        // heap. Copies of a storage always go to the heap, moves and swaps take the block along: the block
+        // must outlive every storage that uses it.
+
+        struct column_block{
+            std::unique_ptr<std::max_align_t[]> memory;
+            size_t size = 0;                                        // bytes
+            std::atomic<size_t> top{0};
+        };
+
+        void reserve_column_block(column_block& block, size_t bytes);     // drops what was given before
+        void* column_block_allocate(column_block* block, size_t bytes);   // nullptr if the block is full
+        bool column_block_owns(const column_block* block, const void* p);
+
+        template<typename T>
+        struct column_allocator{
+            using value_type = T;
+            using propagate_on_container_copy_assignment = std::false_type;
+            using propagate_on_container_move_assignment = std::true_type;
+            using propagate_on_container_swap = std::true_type;
+
+            column_block* block = nullptr;                          // nullptr: heap
+
+            column_allocator() = default;
+            explicit column_allocator(column_block* b) : block(b){}
+            template<typename U> column_allocator(const column_allocator<U>& other) : block(other.block){}
+
+            T* allocate(size_t n){
+                void* p = column_block_allocate(block, n * sizeof(T));
+                return static_cast<T*>(p != nullptr ? p : ::operator new(n * sizeof(T)));
+            }
+
+            void deallocate(T* p, size_t){
+                if(!column_block_owns(block, p))
+                    ::operator delete(p);
+            }
+
+            column_allocator select_on_container_copy_construction() const { return column_allocator(); }
+        };
+
+        template<typename T, typename U>
+        bool operator==(const column_allocator<T>& a, const column_allocator<U>& b){ return a.block == b.block; }
+        template<typename T, typename U>
+        bool operator!=(const column_allocator<T>& a, const column_allocator<U>& b){ return a.block != b.block; }
+
+        template<typename T>
+        using body_column = std::vector<T, column_allocator<T>>;
+
+        struct body_storage{
+            body_column<int> id;                                    // stable id of each body, unique
+            body_column<unsigned char> is_static;
+
+            // State
+            body_column<float> pos_x, pos_y, angle;
+            body_column<float> vel_x, vel_y, w;
+
+            // Inertia values; the inverses are cached for the integration (0 for static bodies)
+            body_column<float> m, I;
+            body_column<float> inv_mass, inv_inertia;
+
+            // Pose at the beginning of the last world step and accumulated force and torque
+            body_column<float> prev_pos_x, prev_pos_y, prev_angle;
+            body_column<float> force_x, force_y, torque;
+
+            body_column<collider_shape> shape;
+
+            // Handle table
+            body_column<int> handle_row;                            // row of every slot, -1 for the free ones
+            body_column<uint32_t> handle_generation;                // current generation of every slot
+            body_column<int> free_handles;                          // free slots, reused before growing the table
+            body_column<int> row_handle;                            // slot of every row
+        };
+
+        inline int body_count(const body_storage& bodies){ return (int) bodies.id.size(); }
+
+        // O(1) validation: false for null_body and for the handles of removed bodies
+        inline bool body_valid(const body_storage& bodies, body_handle handle){
+            return handle.index >= 0 && handle.index < (int) bodies.handle_row.size()
+                && bodies.handle_generation[handle.index] == handle.generation
+                && bodies.handle_row[handle.index] != -1;
+        }
+
+        // Current row of the body, -1 if the handle is not valid
+        inline int body_row(const body_storage& bodies, body_handle handle){ 
+            return body_valid(bodies, handle) ? bodies.handle_row[handle.index] : -1; 
+        }
+
+        inline body_handle row_body_handle(const body_storage& bodies, int row){
+            int slot = bodies.row_handle[row];
+            return { slot, bodies.handle_generation[slot] };
+        }
+
+        // Append a body; a nullptr rigidbody makes it static (only halfspaces can be static)
+        body_handle add_body(body_storage& bodies, int id, const rigidbody* rb, const collider& coll);
+
+        // Swap and pop: the last row moves in the row of the removed body, its handle stays valid.
+        // Call it between two steps (the contacts and the broad phase of the last step index the rows).
+        void remove_body(body_storage& bodies, body_handle handle);
+
+        rigidbody read_body(const body_storage& bodies, int row);
+        void write_body(body_storage& bodies, int row, const rigidbody& rb);     // ignored by static bodies
+        void set_body_collider(body_storage& bodies, int row, const collider& coll);
+        void clear_bodies(body_storage& bodies);                // invalidates every handle
+
+        // Bytes a storage of capacity rows takes from a column block, and move the columns of a storage 
+        // in the block with room for capacity rows (the content is kept)
+        size_t column_block_bytes(int capacity);
+        void attach_column_block(body_storage& bodies, column_block* block, int capacity);
+
+        // ------------------------------------------------------------------------------------
+        // Pose of a row as seen by the narrow phase; static bodies get body = -1
+
+        struct body_pose{
+            int body;
+            float pos_x, pos_y;
+            float angle;
+        };
+
+        body_pose get_body_pose(const body_storage& bodies, int row);
+
+        ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        //                                       COLLISION DETECTION: BROAD PHASE
+        ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        // Sort and sweep over the world space AABBs of the bodies: the finite AABBs are sorted by min_x and
+        // every AABB is only tested against the following ones until their min_x passes its max_x.
+        // Halfspaces have no finite AABB; they are paired with every body whose AABB crosses their plane.
+        //
+        // The same structure answers the region queries of the force fields. Pairs and query results are 
+        // returned sorted by body index, so the narrow phase sees the pairs in the same order of the 
+        // all-pairs loop (this keeps the contact order of the deterministic mode).
+        //
+        // The proxies (the entries of sorted) live across the steps: every build refreshes the AABBs and
+        // re-sorts the order of the last step with an insertion sort, cheap since the bodies move little
+        // in a step. When bodies are destroyed the proxies follow the rows moved by the compaction; the
+        // proxies of the destroyed bodies are dropped and the rows spawned since the last build get one.
+
+        struct aabb{
+            float min_x, min_y;
+            float max_x, max_y;
+        };
+
+        struct broadphase{
+            std::vector<aabb> boxes;                                // AABB of every body (parallel to the body rows)
+            std::vector<int> sorted;                                // finite bodies, sorted by boxes[i].min_x
+            std::vector<int> halfspaces;                            // bodies without a finite AABB
+            float max_width = 0;                                    // widest finite AABB along x
+
+            std::vector<unsigned char> listed;                      // build scratch: the row has a proxy
+        };
+
+        aabb compute_aabb(float pos_x, float pos_y, float angle, const collider& coll);
+        aabb compute_aabb(const rigidbody* rb, const collider& coll);
+        bool aabb_overlap(const aabb& a, const aabb& b);
+
+        void build_broadphase(broadphase& bp, const body_storage& bodies, bool parallel = false);
+        void broadphase_pairs(const broadphase& bp, const body_storage& bodies, arena_array<std::pair<int, int>>& out_pairs, bool parallel = false);
+        void broadphase_query(const broadphase& bp, const aabb& region, std::vector<int>& out_bodies);
+
+        // Scenes of up to small_scene_bodies bodies (the envs of a batch) skip the broad phase and the
+        // solver coloring: every pair goes to the narrow phase and the constraints are solved in one 
+        // sequential batch. With so few bodies building them costs more than what they save.
+        const int small_scene_bodies = 8;
+
+        inline bool small_scene(const body_storage& bodies){ return body_count(bodies) <= small_scene_bodies; }
+
+        // Every pair of bodies but the static-static ones, in the order of broadphase_pairs
+        void all_pairs(const body_storage& bodies, arena_array<std::pair<int, int>>& out_pairs);
+
         ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
         //                                     COLLISION DETECTION: CONTACT GENERATION
         ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -108,61 +483,768 @@ namespace physic{
         // Output of contact generation steps:
 
         struct contact_data{
-            rigidbody* rb_a;
-            rigidbody* rb_b;
+            int body_a;                                             // rows of the bodies in contact; body_b = -1 if B is static
+            int body_b;
             
             float ms_qa_x, ms_qa_y;                                       // q_a: contact point on rigid body A, relative to rigid body A position
             float ms_qb_x, ms_qb_y;                                       // q_b: contact point on rigid body B, relative to rigid body B position
             float ws_n_x, ws_n_y;                                         // n: contact normal
             float pen;                                              // pen: contact penetration
 
+            // Material of the contact, mixed from the two colliders
+            float friction;
+            float restitution;
+
+            // Solver data, precomputed once per step by prestep_contact()
+            float ws_ra_x, ws_ra_y;                                 // q_a rotated in world space (lever arm from A center of mass)
+            float ws_rb_x, ws_rb_y;                                 // q_b rotated in world space (lever arm from B center of mass)
+            float normal_mass;                                      // effective mass of the contact along n
+            float tangent_mass;                                     // effective mass of the contact along the tangent t = (n_y, -n_x)
+            float velocity_bias;                                    // separating velocity requested by restitution
+
+            // Impulses accumulated over the solver iterations
+            float normal_impulse = 0;
+            float tangent_impulse = 0;
+
             float resolved_impulse_mag;                             // magnitude of the impulse that solve the contact; used for rendering purposes
         };
         
-        // Lista contenente tutti i contatti generati nel frame corrente; viene popolata 
-        // dalle funzioni di contact generation e viene svuotata dopo l'esecuzione delle 
-        // funzioni di contact resolution
-        extern std::vector<contact_data> contacts;
-
         // ====================================================================================
         // Contact generation functions:
-        // Queste funzioni popolano il vettore di contatti "std::vector<contact_data> contacts"
+        // Queste funzioni popolano il vettore di contatti del mondo "w.contacts" (see world)
+
+        void contact_detection_dispatcher(world& w);
+        void contact_detection_dispatcher(world& w, const arena_array<std::pair<int, int>>& pairs);
+        contact_data generate_contactdata(const body_pose& A, collider& coll_A, const body_pose& B, collider& coll_B);
 
-        void contact_detection_dispatcher(std::vector<std::pair<rigidbody*, collider*>>& world_bodies);
+        // Contacts of a pair (the ones with pen > 0), at most max_pair_contacts; returns how many. Only
+        // box-halfspace and box-box make two, the other pairs the contact of generate_contactdata.
+        const int max_pair_contacts = 2;
+        int generate_contacts(const body_pose& A, collider& coll_A, const body_pose& B, collider& coll_B, contact_data* out_contacts);
+        void set_contact_material(contact_data& contact, collider& coll_A, collider& coll_B);
 
         // ------------------------------------------------------------------------------------
         // SPHERE-SPHERE
-        contact_data generate_spheresphere_contactdata_norotation(rigidbody& A, rigidbody& B, collider_sphere& coll_A, collider_sphere& coll_B);
+        contact_data generate_spheresphere_contactdata_norotation(const body_pose& A, const body_pose& B, collider_sphere& coll_A, collider_sphere& coll_B);
 
         // ------------------------------------------------------------------------------------
         // SPHERE-BOX
-        contact_data generate_spherebox_contactdata_norotation(rigidbody& S, rigidbody& B, collider_sphere& coll_S, collider_box& coll_B);
+        contact_data generate_spherebox_contactdata_norotation(const body_pose& S, const body_pose& B, collider_sphere& coll_S, collider_box& coll_B);
 
         // ------------------------------------------------------------------------------------
         // SPHERE-HALFSPACE
-        contact_data generate_spherehalfspace_contactdata(rigidbody& S, collider_sphere& coll_S, collider_halfspace& coll_H);
+        contact_data generate_spherehalfspace_contactdata(const body_pose& S, collider_sphere& coll_S, collider_halfspace& coll_H);
 
         // ------------------------------------------------------------------------------------
         // BOX-HALFSPACE
         contact_data generate_pointhalfspace_contactdata(float ws_point_x, float ws_point_y, collider_halfspace& coll_H);
-        contact_data generate_boxhalfspace_contactdata(rigidbody& B, collider_box& coll_B, collider_halfspace& coll_H);
+        contact_data generate_boxhalfspace_contactdata(const body_pose& B, collider_box& coll_B, collider_halfspace& coll_H);
+        int generate_boxhalfspace_manifold(const body_pose& B, collider_box& coll_B, collider_halfspace& coll_H, contact_data* out_contacts);
 
         // ------------------------------------------------------------------------------------
         // BOX-BOX Contact generation functions
+        // Il manifold (fino a due punti) per clipping dell'edge incidente sulla faccia di riferimento
+        int generate_boxbox_manifold(const body_pose& A, const body_pose& B, collider_box& coll_A, collider_box& coll_B, contact_data* out_contacts);
+
         // Restituisce il contatto del vertice di A con profondità maggiore in B
         
-        contact_data generate_boxbox_contactdata_naive_alg(rigidbody& A, rigidbody& B, collider_box& coll_A, collider_box& coll_B);        
-        contact_data generate_boxboxvertices_max_contactdata(rigidbody& A, rigidbody& B, collider_box& coll_A, collider_box& coll_B);
-        contact_data generate_pointbox_contactdata_naive_alg(float w_point_x, float w_point_y, rigidbody& rb, collider_box& coll);
+        contact_data generate_boxbox_contactdata_naive_alg(const body_pose& A, const body_pose& B, collider_box& coll_A, collider_box& coll_B);        
+        contact_data generate_boxboxvertices_max_contactdata(const body_pose& A, const body_pose& B, collider_box& coll_A, collider_box& coll_B);
+        contact_data generate_pointbox_contactdata_naive_alg(float w_point_x, float w_point_y, const body_pose& rb, collider_box& coll);
+
+
+        ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        //                                                 JOINTS
+        ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        // Joints are stored in one pool per joint type; each pool is a structure of arrays where the i-esimo
+        // element of every array belongs to the i-esimo joint of that type.
+        // The joints reference their bodies by handle; the rows are resolved once per step (resolve_joint_rows).
+        // If body_b == null_body the joint is attached to the world: ms_qb is then a world space point.
+        // A static body_b (halfspace) works the same way (row -1; static rows stay at the origin). body_a 
+        // must be dynamic.
+        // A joint with a removed or static body_a gets row_a = -1 and is skipped by the solvers.
+
+        // ====================================================================================
+        // Distance joint: keeps q_a and q_b at distance rest_length
+
+        struct distance_joint_pool{
+            // Definition
+            std::vector<body_handle> body_a, body_b;
+            std::vector<float> ms_qa_x, ms_qa_y;
+            std::vector<float> ms_qb_x, ms_qb_y;
+            std::vector<float> rest_length;
+
+            // Solver data, written by the prestep
+            std::vector<int> row_a, row_b;                          // rows of the bodies in the current step
+            std::vector<float> ws_ra_x, ws_ra_y;
+            std::vector<float> ws_rb_x, ws_rb_y;
+            std::vector<float> ws_n_x, ws_n_y;                      // direction from q_b to q_a
+            std::vector<float> mass;                                // effective mass along n
+            std::vector<float> bias;                                // velocity that corrects the length drift
+            std::vector<float> impulse;                             // accumulated impulse
+        };
+
+        // ====================================================================================
+        // Revolute joint: pins q_a on q_b, the bodies are free to rotate around it
+
+        struct revolute_joint_pool{
+            // Definition
+            std::vector<body_handle> body_a, body_b;
+            std::vector<float> ms_qa_x, ms_qa_y;
+            std::vector<float> ms_qb_x, ms_qb_y;
+
+            // Solver data, written by the prestep
+            std::vector<int> row_a, row_b;                          // rows of the bodies in the current step
+            std::vector<float> ws_ra_x, ws_ra_y;
+            std::vector<float> ws_rb_x, ws_rb_y;
+            std::vector<float> inv_k11, inv_k12, inv_k22;           // inverse of the 2x2 effective mass matrix K
+            std::vector<float> bias_x, bias_y;
+            std::vector<float> impulse_x, impulse_y;
+        };
+
+        // ====================================================================================
+        // Weld joint: pins q_a on q_b and locks the relative angle to reference_angle
+
+        struct weld_joint_pool{
+            // Definition
+            std::vector<body_handle> body_a, body_b;
+            std::vector<float> ms_qa_x, ms_qa_y;
+            std::vector<float> ms_qb_x, ms_qb_y;
+            std::vector<float> reference_angle;                     // angle_a - angle_b at rest
+
+            // Solver data, written by the prestep
+            std::vector<int> row_a, row_b;                          // rows of the bodies in the current step
+            std::vector<float> ws_ra_x, ws_ra_y;
+            std::vector<float> ws_rb_x, ws_rb_y;
+            std::vector<float> inv_k11, inv_k12, inv_k13;           // inverse of the 3x3 (symmetric) effective mass matrix K
+            std::vector<float> inv_k22, inv_k23, inv_k33;
+            std::vector<float> bias_x, bias_y, angular_bias;
+            std::vector<float> impulse_x, impulse_y, angular_impulse;
+        };
+
+        // ====================================================================================
+        // Functions:
+        // The pools belong to a world (w.distance_joints, ...), the add functions return the index of 
+        // the new joint inside its pool.
+        // baumgarte is the fraction of the position error corrected per step (w.joint_baumgarte).
+
+        int add_distance_joint(world& w, body_handle body_a, body_handle body_b, float ms_qa_x, float ms_qa_y, float ms_qb_x, float ms_qb_y, float rest_length);
+        int add_revolute_joint(world& w, body_handle body_a, body_handle body_b, float ms_qa_x, float ms_qa_y, float ms_qb_x, float ms_qb_y);
+        int add_weld_joint(world& w, body_handle body_a, body_handle body_b, float ms_qa_x, float ms_qa_y, float ms_qb_x, float ms_qb_y);
+        void clear_joints(world& w);
+
+        // Translate the handles of every joint of the world to the current rows of the bodies
+        void resolve_joint_rows(world& w);
+
+        template<typename pool_type>
+        bool joint_active(const pool_type& pool, int i){ return pool.row_a[i] >= 0; }
+
+        // The accumulated impulses are kept between the steps: the warm_start functions apply them 
+        // again after the prestep (IMPULSE mode with warm_starting), otherwise reset_joint_impulses 
+        // clears them before the step
+        void reset_joint_impulses(world& w);
+        void warm_start_distance_joint(body_storage& bodies, distance_joint_pool& pool, int i);
+        void warm_start_revolute_joint(body_storage& bodies, revolute_joint_pool& pool, int i);
+        void warm_start_weld_joint(body_storage& bodies, weld_joint_pool& pool, int i);
+
+        void prestep_distance_joint(body_storage& bodies, distance_joint_pool& pool, int i, float inv_delta_time, float baumgarte);
+        void solve_distance_joint(body_storage& bodies, distance_joint_pool& pool, int i);
+        void prestep_revolute_joint(body_storage& bodies, revolute_joint_pool& pool, int i, float inv_delta_time, float baumgarte);
+        void solve_revolute_joint(body_storage& bodies, revolute_joint_pool& pool, int i);
+        void prestep_weld_joint(body_storage& bodies, weld_joint_pool& pool, int i, float inv_delta_time, float baumgarte);
+        void solve_weld_joint(body_storage& bodies, weld_joint_pool& pool, int i);
+
+        // Position pass (IMPULSE mode, after the velocity iterations): move the bodies to remove the
+        // position error left by the step; solve_joint_positions is one iteration on every active joint
+        void solve_distance_joint_position(body_storage& bodies, distance_joint_pool& pool, int i);
+        void solve_revolute_joint_position(body_storage& bodies, revolute_joint_pool& pool, int i);
+        void solve_weld_joint_position(body_storage& bodies, weld_joint_pool& pool, int i);
+        void solve_joint_positions(world& w);
+
+        ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        //                                           CONSTRAINT RESOLUTION
+        ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        // Contacts and joints are solved together by the same iterative solver. Every constraint is referenced by
+        // its type and its index inside the container of that type (the contacts of the world or a joint pool); the
+        // solver dispatches prestep_constraint and solve_constraint on the type, like the contact detection 
+        // dispatches on the collider type.
+        //
+        // Before solving, the constraints are colored: two constraints of the same color never share a dynamic
+        // rigidbody, hence a color is a batch of independent constraints that can be solved in any order (or in
+        // parallel). Inside a color the constraints are grouped by type.
 
+        // ====================================================================================
+        // Constraint interface:
+
+        struct constraint_ref{
+            enum constraint_type {CONTACT, DISTANCE_JOINT, REVOLUTE_JOINT, WELD_JOINT};
+            constraint_type type;
+            int index;
+        };
+
+        void get_constraint_bodies(const world& w, constraint_ref ref, int& out_body_a, int& out_body_b);
+        void prestep_constraint(world& w, constraint_ref ref, float inv_delta_time);
+        void warm_start_constraint(world& w, constraint_ref ref);
+        void solve_constraint(world& w, constraint_ref ref);
+
+        // ====================================================================================
+        // Colored batches:
+
+        struct solver_batches{
+            std::vector<constraint_ref> constraints;                // constraints sorted by color, then by type
+            std::vector<int> color_begin;                           // color c spans [color_begin[c], color_begin[c+1])
+        };
+
+        // Max number of colors; constraints that can't be colored go in a last batch solved sequentially
+        const int max_solver_colors = 64;
+
+        // Colors the contacts and the joints of the world in w.batches
+        void build_solver_batches(world& w);
+
+        // ====================================================================================
+        // Solver:
+        // constraint_solver_dispatcher does w.velocity_iterations sequential impulse iterations.
+        // Closing velocities below restitution_velocity_threshold don't bounce; it lets resting 
+        // contacts settle.
+
+        void constraint_solver_dispatcher(world& w, float delta_time);
+        void prestep_contact(body_storage& bodies, contact_data& contact, float restitution_velocity_threshold);
+        void solve_velocity(body_storage& bodies, contact_data& contact);
+
+        // ------------------------------------------------------------------------------------
+        // Warm starting (IMPULSE mode): the accumulated impulses of the last step are cached by the ids
+        // of the bodies (-1 for a static B), the normal and the contact point on A. A new contact of the
+        // same bodies, with about the same normal and within warm_start_distance of a cached point, 
+        // starts from the cached impulses: a resting stack keeps the impulses that support it instead
+        // of rebuilding them from zero with the few iterations of every step.
+        struct cached_contact{
+            int id_a, id_b;
+            float ms_qa_x, ms_qa_y;
+            float ws_n_x, ws_n_y;
+            float normal_impulse, tangent_impulse;
+        };
+
+        // After prestep_contact: take the cached impulses and apply them to the bodies
+        void warm_start_contact(world& w, contact_data& contact);
+
+        // After the velocity iterations: replace the cache with the impulses of w.contacts
+        void store_contact_impulses(world& w);
+        float solve_interpenetration(body_storage& bodies, contact_data& contact, float separated = 0);
+
+        // ------------------------------------------------------------------------------------
+        // Shared by all the constraints: velocity of the point at world lever arm r and 
+        // application of a world space impulse P at r (row -1 is static)
+
+        inline void point_velocity(const body_storage& bodies, int row, float r_x, float r_y, float& out_v_x, float& out_v_y){
+            if(row < 0){
+                out_v_x = 0;
+                out_v_y = 0;
+                return;
+            }
+            out_v_x = bodies.vel_x[row] - bodies.w[row] * r_y;
+            out_v_y = bodies.vel_y[row] + bodies.w[row] * r_x;
+        }
+
+        inline void apply_world_impulse(body_storage& bodies, int row, float r_x, float r_y, float p_x, float p_y){
+            if(row < 0)
+                return;
+            bodies.vel_x[row] += p_x / bodies.m[row];
+            bodies.vel_y[row] += p_y / bodies.m[row];
+            bodies.w[row] += (r_x * p_y - r_y * p_x) / bodies.I[row];
+        }
 
         ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-        //                                           CONTACT RESOLUTION
+        //                                                  WORLD
         ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        // A world groups the bodies simulated together and the configuration of the engine that steps them.
+        //
+        // Two solver modes are available:
+        //
+        //  - IMPULSE: one integration, one contact generation and velocity_iterations sequential impulse 
+        //    iterations per step, followed by the interpenetration projection.
+        //
+        //  - XPBD: the step is split in xpbd_substeps small substeps; each substep integrates, generates
+        //    the contacts and projects the positions once, then derives the velocities from the positions
+        //    and applies restitution and friction with a single velocity pass. Less accurate per step,
+        //    but very robust on large piles since the contacts are refreshed at every substep.
+        //
+        // Deterministic mode (lockstep and replays): the result of a step must only depend on the state
+        // of the bodies and not on the order of the containers they live in. When enabled:
+        //
+        //  - the body rows are sorted by id before the contact generation, so the contacts (and then
+        //    the solver batches) always come out in the same order with the same A/B roles
+        //  - only fixed_delta_time steps are accepted
+        //  - after every step the checksum of the world state is stored in checksum
+        //
+        // Any parallel or SIMD path of the step must give the same checksum of the scalar one: reductions
+        // must be merged in a fixed order, never in completion order. The build must not enable fast math
+        // (/fp:precise) and two machines in lockstep must run the same binary (sin/cos come from the CRT).
+
+        // ====================================================================================
+        // Batched integration:
+        // The columns of the body storage are integrated in place, four rows at a time, by a SSE 
+        // symplectic Euler kernel:
+        //
+        //      vel   = vel + (force * inv_mass + accel) * dt            angle = angle + w * dt
+        //      pos   = pos + vel * dt                                    w     = w + torque * inv_inertia * dt
+        //
+        // force is the accumulated force plus the contribution of the force generators and accel holds
+        // the mass independent accelerations (gravity and the acceleration fields); both live in world
+        // scratch columns parallel to the rows, accel is left to 0 for bodies with inv_mass = 0 (static
+        // rows don't move). The scalar tail runs the same operations in the same order, so the batched 
+        // and the scalar kernel give bit-identical results.
+
+        // ====================================================================================
+        // Force generators:
+        // Registered in the world and evaluated in a single pass over the body rows before every
+        // integration (every substep in XPBD mode), after the world gravity. A bounded generator only 
+        // touches the bodies whose AABB overlaps its region, found with a broad phase query.
+        //
+        //  - UNIFORM:          constant acceleration (accel_x, accel_y)
+        //  - POINT_ATTRACTOR:  acceleration of magnitude strength / d^2 toward (center_x, center_y), 
+        //                      with d clamped to min_distance (negative strength repels)
+        //  - DRAG:             force -(linear_drag + quadratic_drag * |v_rel|) * v_rel, v_rel = v - flow;
+        //                      a bounded drag with a flow velocity is a wind zone
+
+        struct force_generator{
+            enum generator_type {UNIFORM, POINT_ATTRACTOR, DRAG};
+            generator_type type = UNIFORM;
+
+            float accel_x = 0, accel_y = 0;
+            float center_x = 0, center_y = 0;
+            float strength = 0;
+            float min_distance = 0.5f;
+            float linear_drag = 0, quadratic_drag = 0;
+            float flow_x = 0, flow_y = 0;
+
+            bool bounded = false;
+            aabb region;
+        };
+
+        // Milliseconds spent by the last step in each stage (XPBD: summed over the substeps) and the size of
+        // its collision work. sync is the bookkeeping around the stages: saved poses, deterministic sort,
+        // arena reset, forces cleared, destroyed bodies flushed, checksum.
+
+        struct step_profile{
+            double integration_ms = 0;
+            double broadphase_ms = 0;
+            double narrowphase_ms = 0;
+            double solver_ms = 0;
+            double sync_ms = 0;
+            double total_ms = 0;
+            int pairs = 0;                                          // candidate pairs (XPBD: of the last substep)
+            int contacts = 0;
+        };
+
+        // Everything a step reads and writes lives in its world (bodies, joints, contacts, solver scratch 
+        // and step arena): two worlds share no mutable state and can be stepped on different threads at 
+        // the same time (see step_worlds). A world can't be copied or moved: its arena arrays point to 
+        // its own arena.
+
+        struct world{
+            enum solver_mode {IMPULSE, XPBD};
+            solver_mode mode = IMPULSE;
+
+            int xpbd_substeps = 8;
+            float xpbd_contact_compliance = 0;                      // inverse stiffness of the contacts (0 = rigid)
+
+            int velocity_iterations = 8;                            // sequential impulse iterations (IMPULSE mode)
+            bool warm_starting = true;                              // start contacts and joints from the impulses of the last step
+            float warm_start_distance = 0.05f;                      // max distance of a contact point from its cached one
+            float restitution_velocity_threshold = 0.5f;            // closing velocities below it don't bounce
+            float joint_baumgarte = 0.2f;                           // fraction of the joint position error corrected per step (XPBD, or IMPULSE without position passes)
+            int joint_position_iterations = 4;                      // joint position passes after the velocity iterations (IMPULSE mode)
+
+            // Bodies of the world (see add_body and destroy_body)
+            body_storage bodies;
+            std::vector<body_handle> destroy_queue;                 // removed at the end of the next step
+
+            bool deterministic = false;
+            float fixed_delta_time = 1.0f / 60.0f;                  // the only step length accepted in deterministic mode
+
+            uint64_t step_count = 0;
+            uint64_t checksum = 0;                                  // world_checksum after the last deterministic step
+
+            float gravity_x = 0, gravity_y = -9.81f;
+            std::vector<force_generator> force_generators;
+
+            // Joints between the bodies of the world (see add_distance_joint)
+            distance_joint_pool distance_joints;
+            revolute_joint_pool revolute_joints;
+            weld_joint_pool weld_joints;
+
+            // Run the parallel stages of the step on the job system (false = everything on the calling thread)
+            bool parallel = false;
+
+            // Time the stages of every step in last_profile (two clock reads per stage when true)
+            bool profile = false;
+            step_profile last_profile;
+
+            // Arena of the steps of this world: contacts, pairs and solver scratch
+            step_arena memory;
+
+            // Contacts generated by the last step (for the rendering); valid until the next step
+            arena_array<contact_data> contacts{&memory};
+
+            // Impulses of the contacts of the last step, sorted by body ids (see warm_start_contact)
+            std::vector<cached_contact> contact_cache;
+
+            // Step scratch
+            std::vector<float> force_x, force_y;                    // total force of every row for the integration
+            std::vector<float> accel_x, accel_y;                    // mass independent acceleration of every row
+            broadphase bp;
+            arena_array<std::pair<int, int>> pairs{&memory};        // candidate pairs, in the step arena
+            solver_batches batches;
+            std::vector<int> query;
+            std::vector<int> row_origin, origin_row;                // row moves of flush_destroyed_bodies
+
+            world() = default;
+            world(const world&) = delete;
+            world& operator=(const world&) = delete;
+        };
+
+        void step(world& w, float delta_time);
+        void step_impulse(world& w, float delta_time);
+        void step_xpbd(world& w, float delta_time);
+
+        // ====================================================================================
+        // Batch runner:
+        // Many independent worlds (parameter sweeps, training environments) stepped together: one task per
+        // world on the job system, every world stepped whole by one thread. Nothing is shared between the
+        // worlds, so the result of every world is the same of stepping it alone. Small worlds should keep
+        // parallel = false: the parallelism is across the worlds.
+        // Returns once every world has been stepped.
+
+        void step_worlds(world* const* worlds, int count, float delta_time);
+        void step_worlds(std::vector<std::unique_ptr<world>>& worlds, float delta_time);
+
+        // Integrate the body rows of the world; clear_forces resets the accumulators
+        void integrate_world(world& w, float delta_time);
+        void clear_forces(world& w);
+
+        // Add the contribution of the force generators of the world to the integration scratch
+        void apply_force_generators(world& w);
+
+        // FNV-1a hash of the bit patterns of the state of the dynamic bodies, in row order
+        uint64_t world_checksum(const world& w);
+
+        // ====================================================================================
+        // Runtime spawning and despawning:
+        // Bodies are spawned with add_body(w.bodies, ...) and despawned with destroy_body, which only
+        // queues the handle: the queued bodies are removed (swap and pop) at the end of the step, so the
+        // stages of a step never see the rows move. The contacts of the last step and the broad phase 
+        // proxies follow the moved rows; the ones of the destroyed bodies are dropped.
+        // reserve_world preallocates every per-body array: as long as the world stays under the reserved
+        // capacity spawning and despawning never allocate (the rows, the handle slots and the proxies of 
+        // the destroyed bodies are recycled by the next spawns).
+
+        void reserve_world(world& w, int capacity);
+        void destroy_body(world& w, body_handle handle);
+
+        // Called at the end of step; call it directly to despawn the queued bodies without stepping
+        void flush_destroyed_bodies(world& w);
+
+        // ====================================================================================
+        // World state snapshot:
+        // The whole state of a world (body columns, handle table, broad phase proxies, contacts of the
+        // last step, joints with their accumulated impulses, step counter and configuration) saved in a
+        // single contiguous blob. Every array is a memcpy in and out of the blob; saving again in the 
+        // same world_state reuses its memory, restoring reuses the capacity of the world arrays.
+        // Restoring brings back the exact state: stepping a restored world gives the same results of
+        // stepping the saved one. Only between two steps.
+
+        struct world_state{
+            std::vector<std::max_align_t> blob;
+            size_t size = 0;                                        // bytes of blob in use
+        };
+
+        void save_world_state(const world& w, world_state& out_state);
+
+        // False (and w untouched) if the state is empty or saved by a different layout
+        bool restore_world_state(world& w, const world_state& state);
+
+        // ====================================================================================
+        // Rewind buffer:
+        // Ring of the world states of the last capacity recorded steps, for scrubbing back in time.
+        // Every keyframe_interval frames the state is stored whole (keyframe); the frames in between 
+        // store the XOR with the state of the previous frame, run length encoded on the zero bytes. 
+        // Between two steps most of the bits of a state don't change (ids, shapes, handles, static
+        // bodies, sign and exponent of the floats), so a delta is a fraction of the state.
+        // The deltas are lossless: a rebuilt frame is bit-identical to the recorded state, a restored
+        // world continues exactly as the recorded one did.
+        //
+        // A frame is rebuilt from the keyframe before it, decoding at most keyframe_interval - 1 deltas.
+        // When the ring is full the oldest keyframe group is dropped whole. The states can change size
+        // between two frames (contacts, spawned and removed bodies): the delta covers the new size.
+        // Seeking a frame restores it in the world; the next record drops the frames after it.
+
+        struct rewind_frame{
+            std::vector<unsigned char> data;                        // whole state or encoded delta
+            size_t state_size = 0;
+            uint64_t step_count = 0;
+            bool keyframe = false;
+        };
+
+        struct rewind_buffer{
+            int capacity = 600;                                     // frames
+            int keyframe_interval = 30;
+
+            std::vector<rewind_frame> frames;                       // ring storage, slots reused
+            int first = 0;                                          // slot of the oldest frame
+            int count = 0;
+            int cursor = -1;                                        // frame of the world state in last_state
+
+            world_state last_state;                                 // state of the frame at cursor
+            world_state scratch;
+            std::vector<unsigned char> delta;                       // encoding buffer, copied in the frame
+        };
+
+        void record_world_state(rewind_buffer& buffer, const world& w);
+
+        // Rebuild frame (0 = oldest, count - 1 = newest) in out_state
+        bool rebuild_frame(const rewind_buffer& buffer, int frame, world_state& out_state);
+
+        // Restore the world to the frame
+        bool seek_frame(rewind_buffer& buffer, int frame, world& w);
+
+        void clear_rewind(rewind_buffer& buffer);
+
+        // Bytes held by the frames
+        size_t rewind_memory(const rewind_buffer& buffer);
+
+        // ------------------------------------------------------------------------------------
+        // Blob archives (shared with the game state):
+        // The save and the restore walk the same list of fields, once with blob_sizer and blob_writer
+        // and once with blob_reader. A value is its raw bytes, a column is its element count followed 
+        // by the raw bytes of its elements; every entry starts aligned to blob_alignment.
+        // Only trivially copyable types.
+
+        const size_t blob_alignment = sizeof(std::max_align_t);
+
+        inline size_t blob_align(size_t bytes){ return (bytes + blob_alignment - 1) / blob_alignment * blob_alignment; }
+
+        struct blob_sizer{
+            size_t size = 0;
+
+            void bytes(const void*, size_t count)                           { size += blob_align(count); }
+            template<typename T> void value(const T& v)                     { bytes(&v, sizeof(T)); }
+            template<typename T, typename A> void column(const std::vector<T, A>& c){ value(c.size()); bytes(c.data(), sizeof(T) * c.size()); }
+            template<typename T> void column(const arena_array<T>& c)       { value(c.size()); bytes(c.data, sizeof(T) * c.size()); }
+        };
+
+        struct blob_writer{
+            unsigned char* cursor;
+
+            // The padding is zeroed: equal states give equal blobs
+            void bytes(const void* data, size_t count){
+                if(count > 0)
+                    std::memcpy(cursor, data, count);
+                std::memset(cursor + count, 0, blob_align(count) - count);
+                cursor += blob_align(count);
+            }
+            template<typename T> void value(const T& v)                     { bytes(&v, sizeof(T)); }
+            template<typename T, typename A> void column(const std::vector<T, A>& c){ value(c.size()); bytes(c.data(), sizeof(T) * c.size()); }
+            template<typename T> void column(const arena_array<T>& c)       { value(c.size()); bytes(c.data, sizeof(T) * c.size()); }
+        };
+
+        struct blob_reader{
+            const unsigned char* cursor;
+            const unsigned char* end;
+
+            void bytes(void* data, size_t count){
+                if(count > 0)
+                    std::memcpy(data, cursor, count);
+                cursor += blob_align(count);
+            }
+            template<typename T> void value(T& v)                           { bytes(&v, sizeof(T)); }
+
+            template<typename T, typename A> void column(std::vector<T, A>& c){
+                size_t count;
+                value(count);
+                c.resize(count);
+                bytes(c.data(), sizeof(T) * count);
+            }
+
+            template<typename T> void column(arena_array<T>& c){
+                int count;
+                value(count);
+                c.clear();
+                c.resize(count);
+                bytes(c.data, sizeof(T) * count);
+            }
+        };
+
+        // ====================================================================================
+        // Scene file:
+        // Binary scene laid out as the body columns of a world: a header with the offset of every
+        // section, then one section per persistent column (id, is_static, pose, velocities, inertia,
+        // shape), each aligned to scene_section_alignment. open_scene maps the file in memory and points
+        // the columns of the scene_view in the mapping: nothing is parsed, opening costs the same for
+        // ten or a million bodies. load_scene copies every column in the world with one memcpy and
+        // derives the rest (inverse inertias, previous pose, cleared forces, new handles).
+        // The sections are raw memory: a file is refused if written with a different version, layout
+        // of collider_shape or byte order.
+        //
+        // Text scenes (for review and diffs): one body per line, a keyword for the shape and then 
+        // key value pairs; every key is optional but the id, the missing ones take the defaults of
+        // rigidbody and of the collider. # starts a comment.
+        //
+        //      scene 1
+        //      box       id 4  pos 0 2  angle 0  vel 0 0  w 0  mass 1  inertia 1  size 1 1  friction 0.5  restitution 0.3
+        //      sphere    id 5  pos 1 5  radius 0.5
+        //      halfspace id 0  normal 0 1  offset -9.5
+        //
+        // open_scene_text parses a text scene only once: the result is written next to it as a binary
+        // scene (path + ".bin") stamped with the hash of the text, and mapped from there. Later opens
+        // hash the text and map the binary if the stamp matches, so both paths load the same bytes.
+
+        const uint32_t scene_magic = 0x314e4353;                    // "SCN1"
+        const uint32_t scene_version = 2;
+        const size_t scene_section_alignment = 64;
+
+        enum scene_section{
+            SCENE_ID, SCENE_IS_STATIC,
+            SCENE_POS_X, SCENE_POS_Y, SCENE_ANGLE,
+            SCENE_VEL_X, SCENE_VEL_Y, SCENE_W,
+            SCENE_M, SCENE_I,
+            SCENE_SHAPE,
+            SCENE_SECTIONS
+        };
+
+        struct scene_header{
+            uint32_t magic;
+            uint32_t version;
+            uint32_t shape_size;                                    // sizeof(collider_shape) of the writer
+            int32_t body_count;
+            uint64_t file_size;
+            uint64_t source_hash;                                   // hash of the text scene compiled in it, 0 if none
+            uint64_t section_offset[SCENE_SECTIONS];                // from the beginning of the file
+        };
+
+        // Columns of a scene, read only; rows in the order of the file
+        struct scene_view{
+            int body_count = 0;
+            const int* id = nullptr;
+            const unsigned char* is_static = nullptr;
+            const float* pos_x = nullptr;
+            const float* pos_y = nullptr;
+            const float* angle = nullptr;
+            const float* vel_x = nullptr;
+            const float* vel_y = nullptr;
+            const float* w = nullptr;
+            const float* m = nullptr;
+            const float* I = nullptr;
+            const collider_shape* shape = nullptr;
+        };
+
+        // Scene mapped in memory: the view is valid until close_scene
+        struct scene_file{
+            const unsigned char* data = nullptr;
+            size_t size = 0;
+            void* file = nullptr;                                   // OS handles of the mapping
+            void* mapping = nullptr;
+            uint64_t source_hash = 0;
+            scene_view view;
+        };
+
+        // False (and nothing mapped) if the file can't be opened or isn't a scene of this layout
+        bool open_scene(const char* path, scene_file& out_scene);
+        void close_scene(scene_file& scene);
+
+        // Rows of body_storage in order; the derived columns and the handles are not written
+        bool write_scene(const char* path, const body_storage& bodies, uint64_t source_hash = 0);
+
+        // Text scene through its binary cache; on a parse error out_error tells the line and the reason
+        bool open_scene_text(const char* path, scene_file& out_scene, std::string* out_error = nullptr);
+
+        // Fill bodies with the rows of a text scene (appended, ids must be unique)
+        bool parse_scene_text(const char* text, size_t size, body_storage& bodies, std::string* out_error = nullptr);
+
+        // Every float is written with the fewest digits that parse back to the same bits
+        bool write_scene_text(const char* path, const body_storage& bodies);
+
+        // Replace the bodies of the world with the ones of the scene; every handle of the old bodies
+        // becomes invalid and the contacts of the last step are dropped. Only between two steps.
+        void load_scene(world& w, const scene_view& scene);
+
+        // ====================================================================================
+        // Fixed time step scheduling:
+        // The world is always stepped with fixed_delta_time, independently from the rendering frame
+        // time. Every frame the elapsed time is added to the accumulator and consumed in whole fixed 
+        // steps; the leftover fraction of a step (alpha) is used to interpolate the rendered poses
+        // between the previous and the current step.
+        // If a frame would need more than max_steps_per_frame steps the excess time is dropped: the 
+        // simulation slows down instead of falling in the spiral of death (slow steps make longer 
+        // frames, which need even more steps).
+
+        struct fixed_step_scheduler{
+            float fixed_delta_time = 1.0f / 60.0f;
+            int max_steps_per_frame = 5;
+
+            float accumulator = 0;
+            float alpha = 0;                                        // accumulator / fixed_delta_time, in [0, 1)
+            float dropped_time = 0;                                 // total time discarded by the clamp
+        };
+
+        // Returns the number of fixed steps to run in the current frame
+        int advance_scheduler(fixed_step_scheduler& scheduler, float frame_delta_time);
+
+        // Pose of the rigidbody interpolated between the previous and the current step
+        void interpolate_pose(const rigidbody& rb, float alpha, float& out_pos_x, float& out_pos_y, float& out_angle);
+
+        ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        //                                          BATCHED ENVIRONMENTS
+        ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+        // Many copies (envs) of the same small scene stepped in lockstep by a single call, for reinforcement
+        // learning. The caller only sees flat arrays, one block per env, env after env:
+        //
+        //  - actions:      action_size(batch) floats per env; (force_x, force_y, torque) of every actuated
+        //                  body, applied for the next step only
+        //  - observations: observation_size(batch) floats per env; (pos_x, pos_y, angle, vel_x, vel_y, w) of
+        //                  every observed body (zeros if the body was destroyed)
+        //
+        // Every env is a world restored from the state of the prototype, so a body has the same handle in
+        // all of them. The body columns of all the envs share one column block, env after env, so the state
+        // of the batch is a single contiguous allocation; the envs are small scenes (up to small_scene_bodies
+        // bodies), so they skip the broad phase and the solver coloring.
+        // An env is done after episode_length steps or when done() says so: it is restored to the initial
+        // state in place (no allocations, the arrays keep their capacity) and the observation written for
+        // it is the first of the new episode; dones_out marks it.
+        //
+        // The envs are split among the workers of the job system in groups of env_grain, every group stepped
+        // by one thread: the per-env cost is the step itself, the per-call cost one task per group. done()
+        // is called from the workers, concurrently on different envs.
+
+        struct env_batch{
+            std::unique_ptr<column_block> columns;                  // body columns of every env (outlives envs)
+            std::vector<std::unique_ptr<world>> envs;
+            world_state initial_state;                              // state of the prototype, restored on done
+
+            std::vector<body_handle> actuated;                      // bodies driven by the actions
+            std::vector<body_handle> observed;                      // bodies written in the observations
+
+            int episode_length = 0;                                 // steps per episode (0 = until done() says so)
+            std::function<bool(const world& w, int env)> done;      // optional early termination, checked after every step
+            std::vector<int> episode_step;                          // steps of the current episode of every env
+
+            int env_grain = 32;                                     // envs per task
+        };
+
+        inline int action_size(const env_batch& batch){ return 3 * (int) batch.actuated.size(); }
+        inline int observation_size(const env_batch& batch){ return 6 * (int) batch.observed.size(); }
+
+        // env_count copies of the prototype (its parallel flag is not copied: every env is stepped by one
+        // thread). The bodies are referenced by id; false if an id isn't in the prototype.
+        bool create_env_batch(env_batch& out_batch, const world& prototype, int env_count, const std::vector<int>& actuated_ids, const std::vector<int>& observed_ids);
+
+        // Restore one env to the initial state and restart its episode
+        void reset_env(env_batch& batch, int env);
+
+        // Observations of the current state of every env (the first ones, before any step)
+        void write_observations(const env_batch& batch, float* observations_out);
 
-        void contact_solver_dispatcher();
-        void solve_velocity(contact_data& contact);
-        void solve_interpenetration(contact_data& contact);
+        // One fixed step (fixed_delta_time of the prototype) of every env; dones_out (one byte per env) is optional
+        void step_batch(env_batch& batch, const float* actions, float* observations_out, unsigned char* dones_out = nullptr);
     }
 }
 
@@ -0,0 +1,245 @@
+#include "physic.h"
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define PHYSIC_SSE
+    #include <xmmintrin.h>
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                           FORCE ACCUMULATION
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void physic::dim2::apply_force(rigidbody& rb, float f_x, float f_y){
+    rb.force_x += f_x;
+    rb.force_y += f_y;
+}
+
+// A force applied at the lever arm r (from the center of mass) also produces the torque r ∧ f
+void physic::dim2::apply_force_at_point(rigidbody& rb, float f_x, float f_y, float r_x, float r_y){
+    rb.force_x += f_x;
+    rb.force_y += f_y;
+    rb.torque += r_x * f_y - r_y * f_x;
+}
+
+void physic::dim2::apply_torque(rigidbody& rb, float torque){
+    rb.torque += torque;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                          BATCHED INTEGRATION
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// =========================================================================|
+//                             integrate_range
+// =========================================================================|
+// Symplectic Euler on the rows [begin, end) of the world: the velocities are
+// updated first and the new velocities move the poses.
+//
+static void integrate_range(physic::dim2::world& wd, float delta_time, int begin, int end){
+
+    physic::dim2::body_storage& bodies = wd.bodies;
+
+    int count = end;
+    int i = begin;
+
+    float* pos_x = bodies.pos_x.data();
+    float* pos_y = bodies.pos_y.data();
+    float* vel_x = bodies.vel_x.data();
+    float* vel_y = bodies.vel_y.data();
+    float* angle = bodies.angle.data();
+    float* w = bodies.w.data();
+    const float* inv_mass = bodies.inv_mass.data();
+    const float* inv_inertia = bodies.inv_inertia.data();
+    const float* force_x = wd.force_x.data();
+    const float* force_y = wd.force_y.data();
+    const float* torque = bodies.torque.data();
+    const float* accel_x = wd.accel_x.data();
+    const float* accel_y = wd.accel_y.data();
+
+#ifdef PHYSIC_SSE
+
+    const __m128 dt = _mm_set1_ps(delta_time);
+
+    for(; i + 4 <= count; i += 4){
+
+        __m128 im = _mm_loadu_ps(inv_mass + i);
+
+        // ------------------------------------------------------------------------------------
+        // Linear
+        __m128 a_x = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(force_x + i), im), _mm_loadu_ps(accel_x + i));
+        __m128 a_y = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(force_y + i), im), _mm_loadu_ps(accel_y + i));
+
+        __m128 v_x = _mm_add_ps(_mm_loadu_ps(vel_x + i), _mm_mul_ps(a_x, dt));
+        __m128 v_y = _mm_add_ps(_mm_loadu_ps(vel_y + i), _mm_mul_ps(a_y, dt));
+
+        _mm_storeu_ps(vel_x + i, v_x);
+        _mm_storeu_ps(vel_y + i, v_y);
+        _mm_storeu_ps(pos_x + i, _mm_add_ps(_mm_loadu_ps(pos_x + i), _mm_mul_ps(v_x, dt)));
+        _mm_storeu_ps(pos_y + i, _mm_add_ps(_mm_loadu_ps(pos_y + i), _mm_mul_ps(v_y, dt)));
+
+        // ------------------------------------------------------------------------------------
+        // Angular
+        __m128 alpha = _mm_mul_ps(_mm_loadu_ps(torque + i), _mm_loadu_ps(inv_inertia + i));
+        __m128 ang_v = _mm_add_ps(_mm_loadu_ps(w + i), _mm_mul_ps(alpha, dt));
+
+        _mm_storeu_ps(w + i, ang_v);
+        _mm_storeu_ps(angle + i, _mm_add_ps(_mm_loadu_ps(angle + i), _mm_mul_ps(ang_v, dt)));
+    }
+
+#endif
+
+    // ------------------------------------------------------------------------------------
+    // Scalar tail (or the whole array without SSE); same operations of the batched kernel
+
+    for(; i < count; i++){
+
+        float a_x = force_x[i] * inv_mass[i] + accel_x[i];
+        float a_y = force_y[i] * inv_mass[i] + accel_y[i];
+
+        vel_x[i] = vel_x[i] + a_x * delta_time;
+        vel_y[i] = vel_y[i] + a_y * delta_time;
+        pos_x[i] = pos_x[i] + vel_x[i] * delta_time;
+        pos_y[i] = pos_y[i] + vel_y[i] * delta_time;
+
+        w[i] = w[i] + torque[i] * inv_inertia[i] * delta_time;
+        angle[i] = angle[i] + w[i] * delta_time;
+    }
+}
+
+// =========================================================================|
+//                             integrate_world
+// =========================================================================|
+// The kernel runs in place on the body columns; only the total force and 
+// the accelerations are written in the world scratch first (the generators
+// must not touch the accumulated forces: XPBD integrates once per substep).
+// Static rows have inv_mass = inv_inertia = 0 and no velocity, the kernel
+// leaves them where they are.
+// Every stage is row-parallel with w.parallel; the grain is a multiple of 4
+// so only the last chunk has a scalar tail.
+//
+
+static const int integration_grain = 1024;
+
+void physic::dim2::integrate_world(world& w, float delta_time){
+
+    body_storage& bodies = w.bodies;
+    int count = body_count(bodies);
+
+    w.force_x.resize(count);
+    w.force_y.resize(count);
+    w.accel_x.resize(count);
+    w.accel_y.resize(count);
+
+    parallel_for(w.parallel, count, integration_grain, [&](int begin, int end, int){
+        for(int i = begin; i < end; i++){
+            w.force_x[i] = bodies.force_x[i];
+            w.force_y[i] = bodies.force_y[i];
+            w.accel_x[i] = bodies.inv_mass[i] != 0 ? w.gravity_x : 0;
+            w.accel_y[i] = bodies.inv_mass[i] != 0 ? w.gravity_y : 0;
+        }
+    });
+
+    apply_force_generators(w);
+
+    parallel_for(w.parallel, count, integration_grain, [&](int begin, int end, int){
+        integrate_range(w, delta_time, begin, end);
+    });
+}
+
+// =========================================================================|
+//                               clear_forces
+// =========================================================================|
+
+void physic::dim2::clear_forces(world& w){
+    std::fill(w.bodies.force_x.begin(), w.bodies.force_x.end(), 0.0f);
+    std::fill(w.bodies.force_y.begin(), w.bodies.force_y.end(), 0.0f);
+    std::fill(w.bodies.torque.begin(), w.bodies.torque.end(), 0.0f);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                            FORCE GENERATORS
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// ------------------------------------------------------------------------------------
+// Contribution of one generator to one body row
+static void apply_generator(const physic::dim2::force_generator& gen, physic::dim2::world& w, int i){
+
+    using physic::dim2::force_generator;
+
+    const physic::dim2::body_storage& bodies = w.bodies;
+
+    if(bodies.inv_mass[i] == 0)
+        return;
+
+    switch(gen.type){
+
+        case force_generator::UNIFORM:
+            w.accel_x[i] += gen.accel_x;
+            w.accel_y[i] += gen.accel_y;
+            break;
+
+        case force_generator::POINT_ATTRACTOR: {
+            float d_x = gen.center_x - bodies.pos_x[i];
+            float d_y = gen.center_y - bodies.pos_y[i];
+            float d = std::sqrt(d_x * d_x + d_y * d_y);
+            if(d == 0)
+                break;
+            float clamped = std::max(d, gen.min_distance);
+            float a = gen.strength / (clamped * clamped);
+            w.accel_x[i] += a * d_x / d;
+            w.accel_y[i] += a * d_y / d;
+            break;
+        }
+
+        case force_generator::DRAG: {
+            float v_x = bodies.vel_x[i] - gen.flow_x;
+            float v_y = bodies.vel_y[i] - gen.flow_y;
+            float k = gen.linear_drag + gen.quadratic_drag * std::sqrt(v_x * v_x + v_y * v_y);
+            w.force_x[i] -= k * v_x;
+            w.force_y[i] -= k * v_y;
+            break;
+        }
+    }
+}
+
+// =========================================================================|
+//                          apply_force_generators
+// =========================================================================|
+// The generators are applied in registration order, so every body sums 
+// its contributions always in the same order. The broad phase used for 
+// the bounded generators is built on the poses before the integration.
+//
+void physic::dim2::apply_force_generators(world& w){
+
+    if(w.force_generators.empty())
+        return;
+
+    bool any_bounded = false;
+    for( auto& gen : w.force_generators)
+        any_bounded |= gen.bounded;
+
+    if(any_bounded)
+        build_broadphase(w.bp, w.bodies, w.parallel);
+
+    int count = body_count(w.bodies);
+
+    for( auto& gen : w.force_generators){
+
+        if(!gen.bounded){
+            parallel_for(w.parallel, count, integration_grain, [&](int begin, int end, int){
+                for(int i = begin; i < end; i++)
+                    apply_generator(gen, w, i);
+            });
+            continue;
+        }
+
+        broadphase_query(w.bp, gen.region, w.query);
+        parallel_for(w.parallel, w.query.size(), integration_grain, [&](int begin, int end, int){
+            for(int q = begin; q < end; q++)
+                apply_generator(gen, w, w.query[q]);
+        });
+    }
+}
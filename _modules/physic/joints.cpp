@@ -0,0 +1,593 @@
+#include "physic.h"
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                JOINT POOLS
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// =========================================================================|
+//                           add_distance_joint
+// =========================================================================|
+// Append a new distance joint to the pool; the solver arrays are grown with
+// the definition arrays so that every array of the pool has the same size.
+//
+int physic::dim2::add_distance_joint(
+    world& w, body_handle body_a, body_handle body_b, 
+    float ms_qa_x, float ms_qa_y, float ms_qb_x, float ms_qb_y, 
+    float rest_length
+){
+    distance_joint_pool& pool = w.distance_joints;
+
+    pool.body_a.push_back(body_a);
+    pool.body_b.push_back(body_b);
+    pool.ms_qa_x.push_back(ms_qa_x);
+    pool.ms_qa_y.push_back(ms_qa_y);
+    pool.ms_qb_x.push_back(ms_qb_x);
+    pool.ms_qb_y.push_back(ms_qb_y);
+    pool.rest_length.push_back(rest_length);
+
+    pool.row_a.push_back(-1);
+    pool.row_b.push_back(-1);
+    pool.ws_ra_x.push_back(0);
+    pool.ws_ra_y.push_back(0);
+    pool.ws_rb_x.push_back(0);
+    pool.ws_rb_y.push_back(0);
+    pool.ws_n_x.push_back(0);
+    pool.ws_n_y.push_back(0);
+    pool.mass.push_back(0);
+    pool.bias.push_back(0);
+    pool.impulse.push_back(0);
+
+    return (int) pool.body_a.size() - 1;
+}
+
+// =========================================================================|
+//                           add_revolute_joint
+// =========================================================================|
+
+int physic::dim2::add_revolute_joint(
+    world& w, body_handle body_a, body_handle body_b, 
+    float ms_qa_x, float ms_qa_y, float ms_qb_x, float ms_qb_y
+){
+    revolute_joint_pool& pool = w.revolute_joints;
+
+    pool.body_a.push_back(body_a);
+    pool.body_b.push_back(body_b);
+    pool.ms_qa_x.push_back(ms_qa_x);
+    pool.ms_qa_y.push_back(ms_qa_y);
+    pool.ms_qb_x.push_back(ms_qb_x);
+    pool.ms_qb_y.push_back(ms_qb_y);
+
+    pool.row_a.push_back(-1);
+    pool.row_b.push_back(-1);
+    pool.ws_ra_x.push_back(0);
+    pool.ws_ra_y.push_back(0);
+    pool.ws_rb_x.push_back(0);
+    pool.ws_rb_y.push_back(0);
+    pool.inv_k11.push_back(0);
+    pool.inv_k12.push_back(0);
+    pool.inv_k22.push_back(0);
+    pool.bias_x.push_back(0);
+    pool.bias_y.push_back(0);
+    pool.impulse_x.push_back(0);
+    pool.impulse_y.push_back(0);
+
+    return (int) pool.body_a.size() - 1;
+}
+
+// =========================================================================|
+//                             add_weld_joint
+// =========================================================================|
+// The reference angle is the relative angle of the bodies when the joint is
+// created: the weld keeps the current relative orientation (read from the
+// body storage).
+//
+int physic::dim2::add_weld_joint(
+    world& w, body_handle body_a, body_handle body_b, 
+    float ms_qa_x, float ms_qa_y, float ms_qb_x, float ms_qb_y
+){
+    const body_storage& bodies = w.bodies;
+    weld_joint_pool& pool = w.weld_joints;
+
+    pool.body_a.push_back(body_a);
+    pool.body_b.push_back(body_b);
+    pool.ms_qa_x.push_back(ms_qa_x);
+    pool.ms_qa_y.push_back(ms_qa_y);
+    pool.ms_qb_x.push_back(ms_qb_x);
+    pool.ms_qb_y.push_back(ms_qb_y);
+    int row_a = body_row(bodies, body_a);
+    int row_b = body_row(bodies, body_b);
+    assert(row_a != -1 && "the weld joint needs a valid body_a");
+    pool.reference_angle.push_back(bodies.angle[row_a] - (row_b >= 0 ? bodies.angle[row_b] : 0));
+
+    pool.row_a.push_back(-1);
+    pool.row_b.push_back(-1);
+    pool.ws_ra_x.push_back(0);
+    pool.ws_ra_y.push_back(0);
+    pool.ws_rb_x.push_back(0);
+    pool.ws_rb_y.push_back(0);
+    pool.inv_k11.push_back(0);
+    pool.inv_k12.push_back(0);
+    pool.inv_k13.push_back(0);
+    pool.inv_k22.push_back(0);
+    pool.inv_k23.push_back(0);
+    pool.inv_k33.push_back(0);
+    pool.bias_x.push_back(0);
+    pool.bias_y.push_back(0);
+    pool.angular_bias.push_back(0);
+    pool.impulse_x.push_back(0);
+    pool.impulse_y.push_back(0);
+    pool.angular_impulse.push_back(0);
+
+    return (int) pool.body_a.size() - 1;
+}
+
+// =========================================================================|
+//                               clear_joints
+// =========================================================================|
+
+void physic::dim2::clear_joints(world& w){
+    w.distance_joints = distance_joint_pool();
+    w.revolute_joints = revolute_joint_pool();
+    w.weld_joints = weld_joint_pool();
+}
+
+// =========================================================================|
+//                            resolve_joint_rows
+// =========================================================================|
+// The rows move when the deterministic mode sorts the bodies or a body is
+// removed; called once per step before the joints are colored and solved.
+// A joint with a removed body (stale handle) is deactivated. A static body
+// (halfspace) gets row -1 like the world: it never moves, its anchor is
+// the model space point itself (static rows stay at the origin).
+//
+template<typename pool_type>
+static void resolve_pool_rows(const physic::dim2::body_storage& bodies, pool_type& pool){
+    for(int i = 0; i < pool.body_a.size(); i++){
+        int row_a = physic::dim2::body_row(bodies, pool.body_a[i]);
+        int row_b = physic::dim2::body_row(bodies, pool.body_b[i]);
+
+        bool stale_b = pool.body_b[i] != physic::dim2::null_body && row_b == -1;
+        if(row_a >= 0 && bodies.is_static[row_a])
+            row_a = -1;                                         // nothing to drive: deactivated
+        if(row_b >= 0 && bodies.is_static[row_b])
+            row_b = -1;
+
+        pool.row_a[i] = stale_b ? -1 : row_a;
+        pool.row_b[i] = row_b;
+    }
+}
+
+// Solvers without warm starting (XPBD, warm_starting = false) start every step from zero
+void physic::dim2::reset_joint_impulses(world& w){
+    std::fill(w.distance_joints.impulse.begin(), w.distance_joints.impulse.end(), 0.0f);
+    std::fill(w.revolute_joints.impulse_x.begin(), w.revolute_joints.impulse_x.end(), 0.0f);
+    std::fill(w.revolute_joints.impulse_y.begin(), w.revolute_joints.impulse_y.end(), 0.0f);
+    std::fill(w.weld_joints.impulse_x.begin(), w.weld_joints.impulse_x.end(), 0.0f);
+    std::fill(w.weld_joints.impulse_y.begin(), w.weld_joints.impulse_y.end(), 0.0f);
+    std::fill(w.weld_joints.angular_impulse.begin(), w.weld_joints.angular_impulse.end(), 0.0f);
+}
+
+void physic::dim2::resolve_joint_rows(world& w){
+    resolve_pool_rows(w.bodies, w.distance_joints);
+    resolve_pool_rows(w.bodies, w.revolute_joints);
+    resolve_pool_rows(w.bodies, w.weld_joints);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                          JOINTS: Shared prestep math
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// ------------------------------------------------------------------------------------
+// Lever arms and world anchors of a joint: r = R(angle) * q, p = pos + r.
+// A world attached joint (row -1) has r = 0 and p = q.
+static void joint_anchor(
+    const physic::dim2::body_storage& bodies, int row, float ms_q_x, float ms_q_y,
+    float& out_r_x, float& out_r_y, float& out_p_x, float& out_p_y
+){
+    if(row < 0){
+        out_r_x = 0;
+        out_r_y = 0;
+        out_p_x = ms_q_x;
+        out_p_y = ms_q_y;
+        return;
+    }
+    float c = std::cos(bodies.angle[row]);
+    float s = std::sin(bodies.angle[row]);
+    out_r_x = c * ms_q_x - s * ms_q_y;
+    out_r_y = s * ms_q_x + c * ms_q_y;
+    out_p_x = bodies.pos_x[row] + out_r_x;
+    out_p_y = bodies.pos_y[row] + out_r_y;
+}
+
+// The cached inverses are 0 for the static rows
+static float inv_mass(const physic::dim2::body_storage& bodies, int row){ return row >= 0 ? bodies.inv_mass[row] : 0; }
+static float inv_inertia(const physic::dim2::body_storage& bodies, int row){ return row >= 0 ? bodies.inv_inertia[row] : 0; }
+
+// Move a body by the position impulse P applied at lever arm r (row -1 is the world)
+static void apply_position_impulse(physic::dim2::body_storage& bodies, int row, float r_x, float r_y, float p_x, float p_y){
+    if(row < 0)
+        return;
+    bodies.pos_x[row] += p_x * bodies.inv_mass[row];
+    bodies.pos_y[row] += p_y * bodies.inv_mass[row];
+    bodies.angle[row] += (r_x * p_y - r_y * p_x) * bodies.inv_inertia[row];
+}
+
+// ------------------------------------------------------------------------------------
+// Inverse of the 2x2 point constraint effective mass matrix:
+//
+//      K = (1/m_a + 1/m_b) * Id + [r_a]^T [r_a] / I_a + [r_b]^T [r_b] / I_b
+//
+//      K11 = 1/m_a + 1/m_b + r_a.y^2 / I_a + r_b.y^2 / I_b
+//      K12 = - r_a.x * r_a.y / I_a - r_b.x * r_b.y / I_b
+//      K22 = 1/m_a + 1/m_b + r_a.x^2 / I_a + r_b.x^2 / I_b
+//
+static void point_constraint_inverse_mass(
+    float im_a, float ii_a, float im_b, float ii_b,
+    float ra_x, float ra_y, float rb_x, float rb_y,
+    float& out_inv_k11, float& out_inv_k12, float& out_inv_k22
+){
+    float k11 = im_a + im_b + ra_y * ra_y * ii_a + rb_y * rb_y * ii_b;
+    float k12 = - ra_x * ra_y * ii_a - rb_x * rb_y * ii_b;
+    float k22 = im_a + im_b + ra_x * ra_x * ii_a + rb_x * rb_x * ii_b;
+
+    float det = k11 * k22 - k12 * k12;
+    det = det != 0 ? 1 / det : 0;
+
+    out_inv_k11 = det * k22;
+    out_inv_k12 = - det * k12;
+    out_inv_k22 = det * k11;
+}
+
+// ------------------------------------------------------------------------------------
+// Inverse of the 3x3 weld effective mass matrix: the point constraint K plus the angle
+//
+//      K13 = - r_a.y / I_a - r_b.y / I_b
+//      K23 =   r_a.x / I_a + r_b.x / I_b
+//      K33 =   1 / I_a + 1 / I_b
+//
+// K is symmetric: the inverse is its cofactor matrix over the determinant (6 entries,
+// out_inv_k = {11, 12, 13, 22, 23, 33}).
+//
+static void weld_constraint_inverse_mass(
+    float im_a, float ii_a, float im_b, float ii_b,
+    float ra_x, float ra_y, float rb_x, float rb_y,
+    float* out_inv_k
+){
+    float k11 = im_a + im_b + ra_y * ra_y * ii_a + rb_y * rb_y * ii_b;
+    float k12 = - ra_x * ra_y * ii_a - rb_x * rb_y * ii_b;
+    float k13 = - ra_y * ii_a - rb_y * ii_b;
+    float k22 = im_a + im_b + ra_x * ra_x * ii_a + rb_x * rb_x * ii_b;
+    float k23 = ra_x * ii_a + rb_x * ii_b;
+    float k33 = ii_a + ii_b;
+
+    float c11 = k22 * k33 - k23 * k23;
+    float c12 = k13 * k23 - k12 * k33;
+    float c13 = k12 * k23 - k13 * k22;
+
+    float det = k11 * c11 + k12 * c12 + k13 * c13;
+    det = det != 0 ? 1 / det : 0;
+
+    out_inv_k[0] = det * c11;
+    out_inv_k[1] = det * c12;
+    out_inv_k[2] = det * c13;
+    out_inv_k[3] = det * (k11 * k33 - k13 * k13);
+    out_inv_k[4] = det * (k12 * k13 - k11 * k23);
+    out_inv_k[5] = det * (k11 * k22 - k12 * k12);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                            JOINTS: Distance joint
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Position constraint:     C = |p_a - p_b| - rest_length
+// Velocity constraint:     Cdot = (v_a + w_a ∧ r_a - v_b - w_b ∧ r_b) ⋅ n
+//
+
+void physic::dim2::prestep_distance_joint(body_storage& bodies, distance_joint_pool& pool, int i, float inv_delta_time, float baumgarte){
+
+    int a = pool.row_a[i];
+    int b = pool.row_b[i];
+
+    float pa_x, pa_y, pb_x, pb_y;
+    joint_anchor(bodies, a, pool.ms_qa_x[i], pool.ms_qa_y[i], pool.ws_ra_x[i], pool.ws_ra_y[i], pa_x, pa_y);
+    joint_anchor(bodies, b, pool.ms_qb_x[i], pool.ms_qb_y[i], pool.ws_rb_x[i], pool.ws_rb_y[i], pb_x, pb_y);
+
+    float d_x = pa_x - pb_x;
+    float d_y = pa_y - pb_y;
+    float length = std::sqrt(d_x * d_x + d_y * d_y);
+
+    float n_x = 1;
+    float n_y = 0;
+    if(length > 1e-6f){
+        n_x = d_x / length;
+        n_y = d_y / length;
+    }
+    pool.ws_n_x[i] = n_x;
+    pool.ws_n_y[i] = n_y;
+
+    float rn_a = pool.ws_ra_x[i] * n_y - pool.ws_ra_y[i] * n_x;
+    float rn_b = pool.ws_rb_x[i] * n_y - pool.ws_rb_y[i] * n_x;
+    float k = inv_mass(bodies, a) + inv_mass(bodies, b) + rn_a * rn_a * inv_inertia(bodies, a) + rn_b * rn_b * inv_inertia(bodies, b);
+
+    pool.mass[i] = k > 0 ? 1 / k : 0;
+    pool.bias[i] = - baumgarte * inv_delta_time * (length - pool.rest_length[i]);
+}
+
+void physic::dim2::warm_start_distance_joint(body_storage& bodies, distance_joint_pool& pool, int i){
+
+    float p_x = pool.impulse[i] * pool.ws_n_x[i];
+    float p_y = pool.impulse[i] * pool.ws_n_y[i];
+    apply_world_impulse(bodies, pool.row_a[i], pool.ws_ra_x[i], pool.ws_ra_y[i], p_x, p_y);
+    apply_world_impulse(bodies, pool.row_b[i], pool.ws_rb_x[i], pool.ws_rb_y[i], - p_x, - p_y);
+}
+
+void physic::dim2::solve_distance_joint(body_storage& bodies, distance_joint_pool& pool, int i){
+
+    int a = pool.row_a[i];
+    int b = pool.row_b[i];
+
+    float va_x, va_y, vb_x, vb_y;
+    point_velocity(bodies, a, pool.ws_ra_x[i], pool.ws_ra_y[i], va_x, va_y);
+    point_velocity(bodies, b, pool.ws_rb_x[i], pool.ws_rb_y[i], vb_x, vb_y);
+
+    float cdot = (va_x - vb_x) * pool.ws_n_x[i] + (va_y - vb_y) * pool.ws_n_y[i];
+    float lambda = pool.mass[i] * (pool.bias[i] - cdot);
+    pool.impulse[i] += lambda;
+
+    float p_x = lambda * pool.ws_n_x[i];
+    float p_y = lambda * pool.ws_n_y[i];
+    apply_world_impulse(bodies, a, pool.ws_ra_x[i], pool.ws_ra_y[i], p_x, p_y);
+    apply_world_impulse(bodies, b, pool.ws_rb_x[i], pool.ws_rb_y[i], - p_x, - p_y);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                            JOINTS: Revolute joint
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Position constraint:     C = p_a - p_b                                   (2 equations)
+// Velocity constraint:     Cdot = v_a + w_a ∧ r_a - v_b - w_b ∧ r_b
+//
+
+void physic::dim2::prestep_revolute_joint(body_storage& bodies, revolute_joint_pool& pool, int i, float inv_delta_time, float baumgarte){
+
+    int a = pool.row_a[i];
+    int b = pool.row_b[i];
+
+    float pa_x, pa_y, pb_x, pb_y;
+    joint_anchor(bodies, a, pool.ms_qa_x[i], pool.ms_qa_y[i], pool.ws_ra_x[i], pool.ws_ra_y[i], pa_x, pa_y);
+    joint_anchor(bodies, b, pool.ms_qb_x[i], pool.ms_qb_y[i], pool.ws_rb_x[i], pool.ws_rb_y[i], pb_x, pb_y);
+
+    point_constraint_inverse_mass(
+        inv_mass(bodies, a), inv_inertia(bodies, a), inv_mass(bodies, b), inv_inertia(bodies, b),
+        pool.ws_ra_x[i], pool.ws_ra_y[i], pool.ws_rb_x[i], pool.ws_rb_y[i],
+        pool.inv_k11[i], pool.inv_k12[i], pool.inv_k22[i]
+    );
+
+    pool.bias_x[i] = - baumgarte * inv_delta_time * (pa_x - pb_x);
+    pool.bias_y[i] = - baumgarte * inv_delta_time * (pa_y - pb_y);
+}
+
+void physic::dim2::warm_start_revolute_joint(body_storage& bodies, revolute_joint_pool& pool, int i){
+
+    apply_world_impulse(bodies, pool.row_a[i], pool.ws_ra_x[i], pool.ws_ra_y[i], pool.impulse_x[i], pool.impulse_y[i]);
+    apply_world_impulse(bodies, pool.row_b[i], pool.ws_rb_x[i], pool.ws_rb_y[i], - pool.impulse_x[i], - pool.impulse_y[i]);
+}
+
+void physic::dim2::solve_revolute_joint(body_storage& bodies, revolute_joint_pool& pool, int i){
+
+    int a = pool.row_a[i];
+    int b = pool.row_b[i];
+
+    float va_x, va_y, vb_x, vb_y;
+    point_velocity(bodies, a, pool.ws_ra_x[i], pool.ws_ra_y[i], va_x, va_y);
+    point_velocity(bodies, b, pool.ws_rb_x[i], pool.ws_rb_y[i], vb_x, vb_y);
+
+    float e_x = pool.bias_x[i] - (va_x - vb_x);
+    float e_y = pool.bias_y[i] - (va_y - vb_y);
+
+    float p_x = pool.inv_k11[i] * e_x + pool.inv_k12[i] * e_y;
+    float p_y = pool.inv_k12[i] * e_x + pool.inv_k22[i] * e_y;
+    pool.impulse_x[i] += p_x;
+    pool.impulse_y[i] += p_y;
+
+    apply_world_impulse(bodies, a, pool.ws_ra_x[i], pool.ws_ra_y[i], p_x, p_y);
+    apply_world_impulse(bodies, b, pool.ws_rb_x[i], pool.ws_rb_y[i], - p_x, - p_y);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                              JOINTS: Weld joint
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A revolute joint plus an angular constraint:
+//
+// Angular position constraint:     C = angle_a - angle_b - reference_angle
+// Angular velocity constraint:     Cdot = w_a - w_b
+//
+// The point and the angular part are solved together with the 3x3 effective 
+// mass matrix: solved one after the other they fight each other through the
+// lever arms, and a chain of welds bends.
+//
+
+void physic::dim2::prestep_weld_joint(body_storage& bodies, weld_joint_pool& pool, int i, float inv_delta_time, float baumgarte){
+
+    int a = pool.row_a[i];
+    int b = pool.row_b[i];
+
+    float pa_x, pa_y, pb_x, pb_y;
+    joint_anchor(bodies, a, pool.ms_qa_x[i], pool.ms_qa_y[i], pool.ws_ra_x[i], pool.ws_ra_y[i], pa_x, pa_y);
+    joint_anchor(bodies, b, pool.ms_qb_x[i], pool.ms_qb_y[i], pool.ws_rb_x[i], pool.ws_rb_y[i], pb_x, pb_y);
+
+    float inv_k[6];
+    weld_constraint_inverse_mass(
+        inv_mass(bodies, a), inv_inertia(bodies, a), inv_mass(bodies, b), inv_inertia(bodies, b),
+        pool.ws_ra_x[i], pool.ws_ra_y[i], pool.ws_rb_x[i], pool.ws_rb_y[i], inv_k
+    );
+    pool.inv_k11[i] = inv_k[0];
+    pool.inv_k12[i] = inv_k[1];
+    pool.inv_k13[i] = inv_k[2];
+    pool.inv_k22[i] = inv_k[3];
+    pool.inv_k23[i] = inv_k[4];
+    pool.inv_k33[i] = inv_k[5];
+
+    float angle_b = b >= 0 ? bodies.angle[b] : 0;
+    float angular_error = bodies.angle[a] - angle_b - pool.reference_angle[i];
+
+    pool.bias_x[i] = - baumgarte * inv_delta_time * (pa_x - pb_x);
+    pool.bias_y[i] = - baumgarte * inv_delta_time * (pa_y - pb_y);
+    pool.angular_bias[i] = - baumgarte * inv_delta_time * angular_error;
+}
+
+// Apply the point impulse P and the angular impulse L of a weld
+static void apply_weld_impulse(physic::dim2::body_storage& bodies, const physic::dim2::weld_joint_pool& pool, int i, float p_x, float p_y, float l){
+
+    int a = pool.row_a[i];
+    int b = pool.row_b[i];
+
+    physic::dim2::apply_world_impulse(bodies, a, pool.ws_ra_x[i], pool.ws_ra_y[i], p_x, p_y);
+    physic::dim2::apply_world_impulse(bodies, b, pool.ws_rb_x[i], pool.ws_rb_y[i], - p_x, - p_y);
+
+    bodies.w[a] += l * inv_inertia(bodies, a);
+    if(b >= 0)
+        bodies.w[b] -= l * inv_inertia(bodies, b);
+}
+
+void physic::dim2::warm_start_weld_joint(body_storage& bodies, weld_joint_pool& pool, int i){
+    apply_weld_impulse(bodies, pool, i, pool.impulse_x[i], pool.impulse_y[i], pool.angular_impulse[i]);
+}
+
+void physic::dim2::solve_weld_joint(body_storage& bodies, weld_joint_pool& pool, int i){
+
+    int a = pool.row_a[i];
+    int b = pool.row_b[i];
+
+    float va_x, va_y, vb_x, vb_y;
+    point_velocity(bodies, a, pool.ws_ra_x[i], pool.ws_ra_y[i], va_x, va_y);
+    point_velocity(bodies, b, pool.ws_rb_x[i], pool.ws_rb_y[i], vb_x, vb_y);
+    float w_b = b >= 0 ? bodies.w[b] : 0;
+
+    float e_x = pool.bias_x[i] - (va_x - vb_x);
+    float e_y = pool.bias_y[i] - (va_y - vb_y);
+    float e_angle = pool.angular_bias[i] - (bodies.w[a] - w_b);
+
+    float p_x = pool.inv_k11[i] * e_x + pool.inv_k12[i] * e_y + pool.inv_k13[i] * e_angle;
+    float p_y = pool.inv_k12[i] * e_x + pool.inv_k22[i] * e_y + pool.inv_k23[i] * e_angle;
+    float l   = pool.inv_k13[i] * e_x + pool.inv_k23[i] * e_y + pool.inv_k33[i] * e_angle;
+    pool.impulse_x[i] += p_x;
+    pool.impulse_y[i] += p_y;
+    pool.angular_impulse[i] += l;
+
+    apply_weld_impulse(bodies, pool, i, p_x, p_y, l);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                           JOINTS: Position pass
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The integration moves the bodies before the velocity iterations, so the 
+// velocity solution alone leaves every step a position error that the 
+// Baumgarte bias only partially recovers (a pendulum stretches, a chain 
+// opens). Like solve_interpenetration for the contacts, the position pass
+// moves the bodies to remove the error C, at the current poses:
+//
+//      P = - C / k                 (k effective mass of the constraint)
+//
+// One call is one Gauss-Seidel iteration on the joints of the world.
+//
+
+// Point part of the position pass: P = - K^-1 * (p_a - p_b) at the current poses
+static void solve_point_position(physic::dim2::body_storage& bodies, int a, int b, float qa_x, float qa_y, float qb_x, float qb_y){
+
+    float ra_x, ra_y, rb_x, rb_y, pa_x, pa_y, pb_x, pb_y;
+    joint_anchor(bodies, a, qa_x, qa_y, ra_x, ra_y, pa_x, pa_y);
+    joint_anchor(bodies, b, qb_x, qb_y, rb_x, rb_y, pb_x, pb_y);
+
+    float inv_k11, inv_k12, inv_k22;
+    point_constraint_inverse_mass(
+        inv_mass(bodies, a), inv_inertia(bodies, a), inv_mass(bodies, b), inv_inertia(bodies, b),
+        ra_x, ra_y, rb_x, rb_y, inv_k11, inv_k12, inv_k22
+    );
+
+    float c_x = pa_x - pb_x;
+    float c_y = pa_y - pb_y;
+    float p_x = - (inv_k11 * c_x + inv_k12 * c_y);
+    float p_y = - (inv_k12 * c_x + inv_k22 * c_y);
+
+    apply_position_impulse(bodies, a, ra_x, ra_y, p_x, p_y);
+    apply_position_impulse(bodies, b, rb_x, rb_y, - p_x, - p_y);
+}
+
+void physic::dim2::solve_distance_joint_position(body_storage& bodies, distance_joint_pool& pool, int i){
+
+    int a = pool.row_a[i];
+    int b = pool.row_b[i];
+
+    float ra_x, ra_y, rb_x, rb_y, pa_x, pa_y, pb_x, pb_y;
+    joint_anchor(bodies, a, pool.ms_qa_x[i], pool.ms_qa_y[i], ra_x, ra_y, pa_x, pa_y);
+    joint_anchor(bodies, b, pool.ms_qb_x[i], pool.ms_qb_y[i], rb_x, rb_y, pb_x, pb_y);
+
+    float d_x = pa_x - pb_x;
+    float d_y = pa_y - pb_y;
+    float length = std::sqrt(d_x * d_x + d_y * d_y);
+    if(length <= 1e-6f)
+        return;
+
+    float n_x = d_x / length;
+    float n_y = d_y / length;
+
+    float rn_a = ra_x * n_y - ra_y * n_x;
+    float rn_b = rb_x * n_y - rb_y * n_x;
+    float k = inv_mass(bodies, a) + inv_mass(bodies, b) + rn_a * rn_a * inv_inertia(bodies, a) + rn_b * rn_b * inv_inertia(bodies, b);
+    if(k <= 0)
+        return;
+
+    float lambda = - (length - pool.rest_length[i]) / k;
+
+    apply_position_impulse(bodies, a, ra_x, ra_y, lambda * n_x, lambda * n_y);
+    apply_position_impulse(bodies, b, rb_x, rb_y, - lambda * n_x, - lambda * n_y);
+}
+
+void physic::dim2::solve_revolute_joint_position(body_storage& bodies, revolute_joint_pool& pool, int i){
+    solve_point_position(bodies, pool.row_a[i], pool.row_b[i], pool.ms_qa_x[i], pool.ms_qa_y[i], pool.ms_qb_x[i], pool.ms_qb_y[i]);
+}
+
+// Point and angle together, like the velocity solver
+void physic::dim2::solve_weld_joint_position(body_storage& bodies, weld_joint_pool& pool, int i){
+
+    int a = pool.row_a[i];
+    int b = pool.row_b[i];
+
+    float ra_x, ra_y, rb_x, rb_y, pa_x, pa_y, pb_x, pb_y;
+    joint_anchor(bodies, a, pool.ms_qa_x[i], pool.ms_qa_y[i], ra_x, ra_y, pa_x, pa_y);
+    joint_anchor(bodies, b, pool.ms_qb_x[i], pool.ms_qb_y[i], rb_x, rb_y, pb_x, pb_y);
+
+    float ii_a = inv_inertia(bodies, a);
+    float ii_b = inv_inertia(bodies, b);
+
+    float inv_k[6];
+    weld_constraint_inverse_mass(inv_mass(bodies, a), ii_a, inv_mass(bodies, b), ii_b, ra_x, ra_y, rb_x, rb_y, inv_k);
+
+    float angle_b = b >= 0 ? bodies.angle[b] : 0;
+    float c_x = pa_x - pb_x;
+    float c_y = pa_y - pb_y;
+    float c_angle = bodies.angle[a] - angle_b - pool.reference_angle[i];
+
+    float p_x = - (inv_k[0] * c_x + inv_k[1] * c_y + inv_k[2] * c_angle);
+    float p_y = - (inv_k[1] * c_x + inv_k[3] * c_y + inv_k[4] * c_angle);
+    float l   = - (inv_k[2] * c_x + inv_k[4] * c_y + inv_k[5] * c_angle);
+
+    apply_position_impulse(bodies, a, ra_x, ra_y, p_x, p_y);
+    apply_position_impulse(bodies, b, rb_x, rb_y, - p_x, - p_y);
+    bodies.angle[a] += l * ii_a;
+    if(b >= 0)
+        bodies.angle[b] -= l * ii_b;
+}
+
+void physic::dim2::solve_joint_positions(world& w){
+
+    for(int i = 0; i < w.distance_joints.body_a.size(); i++)
+        if(joint_active(w.distance_joints, i)) solve_distance_joint_position(w.bodies, w.distance_joints, i);
+    for(int i = 0; i < w.revolute_joints.body_a.size(); i++)
+        if(joint_active(w.revolute_joints, i)) solve_revolute_joint_position(w.bodies, w.revolute_joints, i);
+    for(int i = 0; i < w.weld_joints.body_a.size(); i++)
+        if(joint_active(w.weld_joints, i)) solve_weld_joint_position(w.bodies, w.weld_joints, i);
+}
@@ -0,0 +1,23 @@
+#include "physic.h"
+#include <algorithm>
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                           PARALLEL EXECUTION
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// =========================================================================|
+//                            parallel_for_chunks
+// =========================================================================|
+
+void physic::dim2::parallel_for_chunks(bool parallel, int count, int grain, const std::function<void(int begin, int end, int chunk)>& fn){
+
+    if(parallel){
+        jobs::parallel_for_chunks(count, grain, fn);
+        return;
+    }
+
+    grain = std::max(grain, 1);
+    for(int chunk = 0; chunk < chunks_number(count, grain); chunk++)
+        fn(chunk * grain, std::min((chunk + 1) * grain, count), chunk);
+}
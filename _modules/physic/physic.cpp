@@ -1,6 +1,9 @@
 #include "physic.h"
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
 
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -55,7 +58,9 @@ void physic::dim2::build_model_matrix(mat4x4& model_matrix, float x_pos, float y
 //      angle = angle + w * dt
 //
 //  - Angular velocity:
-//      w = w + torque/inertiamoment
+//      w = w + torque/inertiamoment * dt
+//
+// The world step uses the batched integrator (integrate_world) instead.
 //
 void physic::dim2::numeric_integration(rigidbody& rb, float delta_time, float force_x, float force_y , float torque){
 
@@ -75,7 +80,7 @@ void physic::dim2::numeric_integration(rigidbody& rb, float delta_time, float fo
 
     // ------------------------------------------------------------------------------------
     // - Angular Velocity Update
-    rb.w = rb.w + torque/rb.I;
+    rb.w = rb.w + torque/rb.I * delta_time;
 
 }
 
@@ -239,82 +244,214 @@ bool physic::dim2::check_pointbox_collision(
 //                       COLLISION DETECTION: CONTACT GENERATION - Collision dispatcher
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-std::vector<physic::dim2::contact_data> physic::dim2::contacts;
-
 // =========================================================================|
 //                         contact_detection_dispatcher
 // =========================================================================|
-// Check all the elements inside the world_bodies vector with each other and
-// dispatch the appropriate collision detection and contact generation 
-// function to find the collisions between them.
-// The generated contatcs are inserted inside the the "contacts" vector.
+// Check all the body rows with each other and dispatch the appropriate 
+// collision detection and contact generation function to find the 
+// collisions between them.
+// The generated contatcs are inserted inside the the "w.contacts" vector.
+//
+// Static colliders (halfspaces) get a pose with body = -1.
 //
 // This function deals with both the broad phase and the narrow phase.
 //
-void physic::dim2::contact_detection_dispatcher(std::vector<std::pair<rigidbody*, collider*>>& bodies){
+void physic::dim2::contact_detection_dispatcher(world& w){
 
-    if(bodies.size()<= 1)
+    body_storage& bodies = w.bodies;
+    int count = body_count(bodies);
+    if(count <= 1)
         return;
     
     // ------------------------------------------------------------------------------------
-    // Define how to loop the world_bodies vector
+    // Define how to loop the body rows
 
-    // For each element in the vector..
-    for(int i = 0; i < bodies.size()-1; i ++){
+    // For each row..
+    for(int i = 0; i < count-1; i ++){
 
-        // ..step in all the elements with higher position in the vector 
-        for(int j = i+1; j < bodies.size(); j++ ){
+        // ..step in all the rows after it
+        for(int j = i+1; j < count; j++ ){
             
+            contact_data new_contacts[max_pair_contacts];
+            int contacts_number = generate_contacts(
+                get_body_pose(bodies, i), shape_collider(bodies.shape[i]), 
+                get_body_pose(bodies, j), shape_collider(bodies.shape[j]), new_contacts);
+
             // ------------------------------------------------------------------------------------
-            // Data
+            // Add the contacts (penetration > 0) to the contact list that will be solved in this frame
 
-            // References to the world bodies
-            rigidbody& A = *(bodies[i].first);
-            collider& coll_A = *(bodies[i].second);
-            rigidbody& B = *(bodies[j].first);
-            collider& coll_B = *(bodies[j].second);
+            for(int c = 0; c < contacts_number; c++){
+                w.contacts.push_back(new_contacts[c]);
+            }
 
-            // Eventual new contact between the shapes
-            contact_data new_contact;
+        }
+    }
 
-            // ------------------------------------------------------------------------------------
-            // Check the specific type of colliders and dispatch the correct function
+}
 
-            // BOX-BOX
-            if( coll_A.type == collider::BOX && coll_B.type == collider::BOX){
-                
-                // Eventual broadphase function (not worth with simple contact generation functions) 
-                // check_boxbox_collision()
+// ------------------------------------------------------------------------------------
+// Narrow phase only: the candidate pairs come from the broad phase (see broadphase_pairs)
 
-                // Contact generation function
-                new_contact = generate_boxbox_contactdata_naive_alg(A, B, (collider_box&) coll_A, (collider_box&) coll_B);
-            }
+// Every chunk of pairs writes its own contact buffer; the buffers are appended 
+// in chunk order, so "w.contacts" has the same order of a sequential run.
+// A pair makes at most max_pair_contacts contacts: every buffer is sized for
+// its whole chunk in the step arena and never grows.
 
-            // SPHERE-SPHERE
-            if( coll_A.type == collider::SPHERE && coll_B.type == collider::SPHERE){
+static const int narrowphase_grain = 128;
 
-                // Contact generation function
-                new_contact = generate_spheresphere_contactdata_norotation(A, B, (collider_sphere&) coll_A, (collider_sphere&) coll_B);
-            }
+void physic::dim2::contact_detection_dispatcher(world& w, const arena_array<std::pair<int, int>>& pairs){
 
-            // ------------------------------------------------------------------------------------
-            // If the contact exists (penetration > 0) add it to the contact list that will be solved in this frame
+    body_storage& bodies = w.bodies;
+    arena_array<contact_data>& contacts = w.contacts;
 
-            if (new_contact.pen > 0){
-                contacts.push_back(new_contact);
-            }
+    int chunks = chunks_number(pairs.size(), narrowphase_grain);
+    arena_array<contact_data>* chunk_contacts = arena_allocate<arena_array<contact_data>>(w.memory, chunks);
+
+    parallel_for(w.parallel, pairs.size(), narrowphase_grain, [&](int begin, int end, int chunk){
 
+        arena_array<contact_data>& buffer = chunk_contacts[chunk];
+        new (&buffer) arena_array<contact_data>{&w.memory};
+        buffer.reserve((end - begin) * max_pair_contacts);
+
+        for(int p = begin; p < end; p++){
+            int i = pairs[p].first;
+            int j = pairs[p].second;
+
+            contact_data new_contacts[max_pair_contacts];
+            int contacts_number = generate_contacts(
+                get_body_pose(bodies, i), shape_collider(bodies.shape[i]), 
+                get_body_pose(bodies, j), shape_collider(bodies.shape[j]), new_contacts);
+
+            for(int c = 0; c < contacts_number; c++){
+                buffer.push_back(new_contacts[c]);
+            }
         }
+    });
+
+    int total = contacts.size();
+    for(int chunk = 0; chunk < chunks; chunk++)
+        total += chunk_contacts[chunk].size();
+    contacts.reserve(total);
+
+    for(int chunk = 0; chunk < chunks; chunk++){
+        contacts.append(chunk_contacts[chunk].begin(), chunk_contacts[chunk].end());
     }
 
 }
 
+// =========================================================================|
+//                           generate_contactdata
+// =========================================================================|
+// Narrow phase of a single pair: check the specific type of colliders and
+// dispatch the correct contact generation function.
+// The pair is first ordered so that coll_A.type <= coll_B.type (BOX, SPHERE,
+// HALFSPACE); this way each couple of types has a single case.
+// Returns a contact with pen <= 0 if the shapes are not in contact.
+//
+physic::dim2::contact_data physic::dim2::generate_contactdata(const body_pose& A, collider& coll_A, const body_pose& B, collider& coll_B){
+
+    if(coll_A.type > coll_B.type){
+        return generate_contactdata(B, coll_B, A, coll_A);
+    }
+
+    // Eventual new contact between the shapes
+    contact_data new_contact;
+    new_contact.pen = 0;
+
+    // BOX-BOX
+    if( coll_A.type == collider::BOX && coll_B.type == collider::BOX){
+        
+        // Eventual broadphase function (not worth with simple contact generation functions) 
+        // check_boxbox_collision()
+
+        // Contact generation function
+        new_contact = generate_boxbox_contactdata_naive_alg(A, B, (collider_box&) coll_A, (collider_box&) coll_B);
+    }
+
+    // BOX-SPHERE
+    if( coll_A.type == collider::BOX && coll_B.type == collider::SPHERE){
+        new_contact = generate_spherebox_contactdata_norotation(B, A, (collider_sphere&) coll_B, (collider_box&) coll_A);
+    }
+
+    // BOX-HALFSPACE
+    if( coll_A.type == collider::BOX && coll_B.type == collider::HALFSPACE){
+        new_contact = generate_boxhalfspace_contactdata(A, (collider_box&) coll_A, (collider_halfspace&) coll_B);
+    }
+
+    // SPHERE-SPHERE
+    if( coll_A.type == collider::SPHERE && coll_B.type == collider::SPHERE){
+
+        // Contact generation function
+        new_contact = generate_spheresphere_contactdata_norotation(A, B, (collider_sphere&) coll_A, (collider_sphere&) coll_B);
+    }
+
+    // SPHERE-HALFSPACE
+    if( coll_A.type == collider::SPHERE && coll_B.type == collider::HALFSPACE){
+        new_contact = generate_spherehalfspace_contactdata(A, (collider_sphere&) coll_A, (collider_halfspace&) coll_B);
+    }
+
+    // HALFSPACE-HALFSPACE: static shapes never collide
+
+    return new_contact;
+}
+
+// =========================================================================|
+//                            generate_contacts
+// =========================================================================|
+// Contact manifold of a pair: the box-halfspace and box-box pairs have 
+// their own manifold, every other pair the single contact of 
+// generate_contactdata.
+//
+int physic::dim2::generate_contacts(const body_pose& A, collider& coll_A, const body_pose& B, collider& coll_B, contact_data* out_contacts){
+
+    if(coll_A.type > coll_B.type){
+        return generate_contacts(B, coll_B, A, coll_A, out_contacts);
+    }
+
+    if( coll_A.type == collider::BOX && coll_B.type == collider::HALFSPACE){
+        return generate_boxhalfspace_manifold(A, (collider_box&) coll_A, (collider_halfspace&) coll_B, out_contacts);
+    }
+
+    if( coll_A.type == collider::BOX && coll_B.type == collider::BOX){
+        return generate_boxbox_manifold(A, B, (collider_box&) coll_A, (collider_box&) coll_B, out_contacts);
+    }
+
+    out_contacts[0] = generate_contactdata(A, coll_A, B, coll_B);
+    return out_contacts[0].pen > 0 ? 1 : 0;
+}
+
+// =========================================================================|
+//                         set_contact_material
+// =========================================================================|
+// Mix the surface materials of the two colliders in contact:
+//
+//  - Friction: geometric mean, so a frictionless surface always slides
+//      mu = sqrt(mu_a * mu_b)
+//
+//  - Restitution: the bouncier surface wins
+//      e = max(e_a, e_b)
+//
+void physic::dim2::set_contact_material(contact_data& contact, collider& coll_A, collider& coll_B){
+    contact.friction = std::sqrt(coll_A.friction * coll_B.friction);
+    contact.restitution = std::max(coll_A.restitution, coll_B.restitution);
+}
+
+// Bring a world space offset from the body center in the body model space (rotation by -angle).
+// The contact points of a sphere are found in world space, but the solvers rotate every q by the
+// body angle: stored as they are, the lever arm of a spinning sphere turns away from the contact.
+static void world_to_model_offset(float angle, float ws_x, float ws_y, float& ms_x, float& ms_y){
+    float c = std::cos(angle);
+    float s = std::sin(angle);
+    ms_x =   c * ws_x + s * ws_y;
+    ms_y = - s * ws_x + c * ws_y;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //             COLLISION DETECTION: CONTACT GENERATION - Halfspace contact generation algorithms
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
-physic::dim2::contact_data physic::dim2::generate_spherehalfspace_contactdata(rigidbody& S, collider_sphere& coll_S, collider_halfspace& coll_H){
+physic::dim2::contact_data physic::dim2::generate_spherehalfspace_contactdata(const body_pose& S, collider_sphere& coll_S, collider_halfspace& coll_H){
     contact_data contact;
     contact.pen = 0;
 
@@ -325,77 +462,95 @@ physic::dim2::contact_data physic::dim2::generate_spherehalfspace_contactdata(ri
     }
 
     // Contact point on sphere can be found just by opposite of plane normal * radius
-    contact.ms_qa_x = - coll_H.normal_x * coll_S.radius;
-    contact.ms_qa_y = - coll_H.normal_y * coll_S.radius;
+    world_to_model_offset(S.angle, - coll_H.normal_x * coll_S.radius, - coll_H.normal_y * coll_S.radius, contact.ms_qa_x, contact.ms_qa_y);
 
     // Plane has no contact to process since it is static
     contact.ms_qb_x = 0;
     contact.ms_qb_y = 0;
 
     contact.pen = coll_S.radius - projection;
-    contact.rb_a = &S;
-    contact.rb_b = nullptr;
+    contact.body_a = S.body;
+    contact.body_b = -1;
 
     contact.ws_n_x = coll_H.normal_x;
     contact.ws_n_y = coll_H.normal_y;
 
+    set_contact_material(contact, coll_S, coll_H);
+
     return contact;
 
 }
 
-physic::dim2::contact_data physic::dim2::generate_boxhalfspace_contactdata(rigidbody& B, collider_box& coll_B, collider_halfspace& coll_H){
-
-    contact_data contact;
-    contact.pen = 0;
-
-    // ------------------------------------------------------------------------------------
-    // Find world space coordinates of the box edges
+// =========================================================================|
+//                      generate_boxhalfspace_manifold
+// =========================================================================|
+// Every vertex of the box under the plane is a contact point; the two 
+// deepest are kept, deepest first (the lower vertex index on a tie).
+// A box lying on the plane gets both the vertices of its lower face: with 
+// the deepest vertex alone it rocks around it forever and friction can't 
+// settle it.
+//
+int physic::dim2::generate_boxhalfspace_manifold(const body_pose& B, collider_box& coll_B, collider_halfspace& coll_H, contact_data* out_contacts){
 
-    float ms_box_edges [8] = {
+    float ms_box_vertices [8] = {
         - coll_B.width / 2, - coll_B.height / 2,
           coll_B.width / 2, - coll_B.height / 2,
           coll_B.width / 2,   coll_B.height / 2,
         - coll_B.width / 2,   coll_B.height / 2
     };
 
-    float ws_box_edges [8] = {};
+    float c = std::cos(B.angle);
+    float s = std::sin(B.angle);
 
-    mat4x4 model_matrix;
-    build_model_matrix(model_matrix, B.pos_x, B.pos_y, B.angle);
+    int count = 0;
 
     for(int i = 0; i < 4; i++){
-        
-        vec4 ms_edge = { ms_box_edges[i*2], ms_box_edges[i*2+1], 0, 1 };
-        vec4 ws_edge;
 
-        mat4x4_mul_vec4(ws_edge, model_matrix, ms_edge);
-        
-        ws_box_edges [i*2]    = ws_edge[0];
-        ws_box_edges [i*2+1]  = ws_edge[1]; 
-    }
+        float ms_x = ms_box_vertices[i*2];
+        float ms_y = ms_box_vertices[i*2+1];
+
+        contact_data contact = generate_pointhalfspace_contactdata(B.pos_x + c * ms_x - s * ms_y, B.pos_y + s * ms_x + c * ms_y, coll_H);
+        if(contact.pen <= 0)
+            continue;
+
+        contact.ms_qa_x = ms_x;
+        contact.ms_qa_y = ms_y;
+        contact.ms_qb_x = 0;
+        contact.ms_qb_y = 0;
+        contact.body_a = B.body;
+        contact.body_b = -1;
+        contact.ws_n_x = coll_H.normal_x;
+        contact.ws_n_y = coll_H.normal_y;
+        set_contact_material(contact, coll_B, coll_H);
+
+        // Insert keeping the deepest first; a full manifold drops its shallowest contact
+        if(count == max_pair_contacts){
+            if(contact.pen <= out_contacts[count-1].pen)
+                continue;
+            count--;
+        }
 
-    // ------------------------------------------------------------------------------------
-    // For every edge check if it penetrates and pick the contact with the most penetrating depth
+        int slot = count++;
+        out_contacts[slot] = contact;
 
-    for(int i = 0; i < 4; i ++){
+        for(; slot > 0 && out_contacts[slot].pen > out_contacts[slot-1].pen; slot--)
+            std::swap(out_contacts[slot], out_contacts[slot-1]);
+    }
 
-        physic::dim2::contact_data new_contact = generate_pointhalfspace_contactdata(ws_box_edges[i*2], ws_box_edges[i*2+1], coll_H);
-        
-        if(new_contact.pen > contact.pen){
-            contact = new_contact;
-            
-            contact.ms_qa_x = ms_box_edges[i*2];
-            contact.ms_qa_y = ms_box_edges[i*2+1];
-            contact.rb_a = &B;
-            contact.rb_b = nullptr;
-            contact.ws_n_x = coll_H.normal_x;
-            contact.ws_n_y = coll_H.normal_y;
-        }
+    return count;
+}
 
-    }
+// The deepest contact of the manifold
+physic::dim2::contact_data physic::dim2::generate_boxhalfspace_contactdata(const body_pose& B, collider_box& coll_B, collider_halfspace& coll_H){
 
-    return contact;
+    contact_data manifold[max_pair_contacts];
+    if(generate_boxhalfspace_manifold(B, coll_B, coll_H, manifold) == 0){
+        contact_data contact;
+        contact.pen = 0;
+        return contact;
+    }
 
+    return manifold[0];
 }
 
 physic::dim2::contact_data physic::dim2::generate_pointhalfspace_contactdata(float ws_point_x, float ws_point_y, collider_halfspace& coll_H){
@@ -421,7 +576,7 @@ physic::dim2::contact_data physic::dim2::generate_pointhalfspace_contactdata(flo
 //               generate_spheresphere_contactdata_norotation
 // =========================================================================|
 
-physic::dim2::contact_data physic::dim2::generate_spheresphere_contactdata_norotation(rigidbody& A, rigidbody& B, collider_sphere& coll_A, collider_sphere& coll_B){
+physic::dim2::contact_data physic::dim2::generate_spheresphere_contactdata_norotation(const body_pose& A, const body_pose& B, collider_sphere& coll_A, collider_sphere& coll_B){
 
     // NB: we consider no rotations / orientation for a sphere
     // NB: we consider the normal on B surface
@@ -438,22 +593,22 @@ physic::dim2::contact_data physic::dim2::generate_spheresphere_contactdata_norot
     // Contact normal:
     vec2 normal = { conjunction[0] / distance, conjunction[1] / distance };
     
-    contact.ms_qa_x = - normal[0] * coll_A.radius;
-    contact.ms_qa_y = - normal[1] * coll_A.radius;
-    contact.ms_qb_x = normal[0] * coll_B.radius;
-    contact.ms_qb_y = normal[1] * coll_B.radius; 
+    world_to_model_offset(A.angle, - normal[0] * coll_A.radius, - normal[1] * coll_A.radius, contact.ms_qa_x, contact.ms_qa_y);
+    world_to_model_offset(B.angle, normal[0] * coll_B.radius, normal[1] * coll_B.radius, contact.ms_qb_x, contact.ms_qb_y);
 
     contact.pen = coll_A.radius + coll_B.radius - distance;
-    contact.rb_a = &A;
-    contact.rb_b = &B;
+    contact.body_a = A.body;
+    contact.body_b = B.body;
     contact.ws_n_x = normal[0];
     contact.ws_n_y = normal[1];
 
+    set_contact_material(contact, coll_A, coll_B);
+
     return contact;
 
 }
 
-physic::dim2::contact_data physic::dim2::generate_spherebox_contactdata_norotation(rigidbody& S, rigidbody& B, collider_sphere& coll_S, collider_box& coll_B){
+physic::dim2::contact_data physic::dim2::generate_spherebox_contactdata_norotation(const body_pose& S, const body_pose& B, collider_sphere& coll_S, collider_box& coll_B){
 
     contact_data contact;
     contact.pen = 0;
@@ -504,21 +659,214 @@ physic::dim2::contact_data physic::dim2::generate_spherebox_contactdata_norotati
 
     contact.ms_qa_x = ms_closest_point_x;
     contact.ms_qa_y = ms_closest_point_y;
-    contact.ms_qb_x = ws_normal[0] * coll_S.radius;
-    contact.ms_qb_y = ws_normal[1] * coll_S.radius;
+    world_to_model_offset(S.angle, ws_normal[0] * coll_S.radius, ws_normal[1] * coll_S.radius, contact.ms_qb_x, contact.ms_qb_y);
 
     contact.pen = coll_S.radius - distance;
     contact.ws_n_x = ws_normal[0];
     contact.ws_n_y = ws_normal[1];
 
-    contact.rb_a = &B;
-    contact.rb_b = &S;
+    contact.body_a = B.body;
+    contact.body_b = S.body;
+
+    set_contact_material(contact, coll_B, coll_S);
 
     return contact;
 
 }
 
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//             COLLISION DETECTION: CONTACT GENERATION - BoxBox contact manifold by clipping
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Clip the segment in against the line m . p = offset, keeping the side m . p <= offset; returns how
+// many points are left in out.
+static int clip_segment(const float in[2][2], float out[2][2], float m_x, float m_y, float offset){
+
+    float d0 = m_x * in[0][0] + m_y * in[0][1] - offset;
+    float d1 = m_x * in[1][0] + m_y * in[1][1] - offset;
+
+    int count = 0;
+    if(d0 <= 0){
+        out[count][0] = in[0][0];
+        out[count][1] = in[0][1];
+        count++;
+    }
+    if(d1 <= 0){
+        out[count][0] = in[1][0];
+        out[count][1] = in[1][1];
+        count++;
+    }
+
+    // The end points are on different sides: the intersection replaces the clipped one
+    if(d0 * d1 < 0){
+        float t = d0 / (d0 - d1);
+        out[count][0] = in[0][0] + t * (in[1][0] - in[0][0]);
+        out[count][1] = in[0][1] + t * (in[1][1] - in[0][1]);
+        count++;
+    }
+
+    return count;
+}
+
+// =========================================================================|
+//                         generate_boxbox_manifold
+// =========================================================================|
+// Contact manifold of two boxes, up to two points (the 2D version of the
+// box-box clipping of Box2D Lite):
+//
+//  - Separating axes: the 4 face normals of the boxes. If the boxes are 
+//    separated along one of them there is no contact; otherwise the axis
+//    with the least penetration gives the reference face. An axis replaces
+//    the previous best only if it is clearly better (relative and absolute
+//    tolerance), so the reference face of a resting stack does not flip 
+//    from a frame to the next.
+//
+//  - Incident edge: the face of the other box most opposed to the 
+//    reference normal.
+//
+//  - The incident edge is clipped against the side planes of the reference 
+//    face; every clipped point under the reference face is a contact.
+//
+// A box resting on another one gets both the ends of the overlapping edge:
+// with the deepest vertex alone a stack rocks around it and never settles.
+// The contacts have the incident box as body_a and the reference box as
+// body_b, with the normal of the reference face (from B to A as every 
+// contact); deepest first.
+//
+int physic::dim2::generate_boxbox_manifold(const body_pose& A, const body_pose& B, collider_box& coll_A, collider_box& coll_B, contact_data* out_contacts){
+
+    const body_pose* poses[2] = {&A, &B};
+    float half[2][2] = {
+        {coll_A.width / 2, coll_A.height / 2},
+        {coll_B.width / 2, coll_B.height / 2}
+    };
+
+    // Model axes of the boxes in world space: axis[box][x|y] = {x, y}
+    float axis[2][2][2];
+    for(int k = 0; k < 2; k++){
+        float c = std::cos(poses[k]->angle);
+        float s = std::sin(poses[k]->angle);
+        axis[k][0][0] = c;   axis[k][0][1] = s;
+        axis[k][1][0] = -s;  axis[k][1][1] = c;
+    }
+
+    float d_x = B.pos_x - A.pos_x;
+    float d_y = B.pos_y - A.pos_y;
+
+    // ------------------------------------------------------------------------------------
+    // Separating axes test: keep the face (box, axis) with the least penetration
+
+    const float relative_tolerance = 0.95f;
+    const float absolute_tolerance = 0.01f;
+
+    int ref = -1;
+    int ref_axis = -1;
+    float best_separation = 0;
+
+    for(int k = 0; k < 2; k++){
+        int other = 1 - k;
+        for(int i = 0; i < 2; i++){
+            float u_x = axis[k][i][0];
+            float u_y = axis[k][i][1];
+            float separation = std::abs(d_x * u_x + d_y * u_y) - half[k][i]
+                - half[other][0] * std::abs(axis[other][0][0] * u_x + axis[other][0][1] * u_y)
+                - half[other][1] * std::abs(axis[other][1][0] * u_x + axis[other][1][1] * u_y);
+
+            if(separation > 0)
+                return 0;
+
+            if(ref < 0 || separation > relative_tolerance * best_separation + absolute_tolerance * half[k][i]){
+                ref = k;
+                ref_axis = i;
+                best_separation = separation;
+            }
+        }
+    }
+
+    int inc = 1 - ref;
+    const body_pose& R = *poses[ref];
+    const body_pose& I = *poses[inc];
+
+    // ------------------------------------------------------------------------------------
+    // Reference face: normal from the reference box towards the incident one
+
+    float n_x = axis[ref][ref_axis][0];
+    float n_y = axis[ref][ref_axis][1];
+    if((I.pos_x - R.pos_x) * n_x + (I.pos_y - R.pos_y) * n_y < 0){
+        n_x = -n_x;
+        n_y = -n_y;
+    }
+    float front = n_x * R.pos_x + n_y * R.pos_y + half[ref][ref_axis];
+
+    int side_axis = 1 - ref_axis;
+    float t_x = axis[ref][side_axis][0];
+    float t_y = axis[ref][side_axis][1];
+    float side = t_x * R.pos_x + t_y * R.pos_y;
+
+    // ------------------------------------------------------------------------------------
+    // Incident edge: the face of the incident box with the normal most opposed to n
+
+    float dot_x = axis[inc][0][0] * n_x + axis[inc][0][1] * n_y;
+    float dot_y = axis[inc][1][0] * n_x + axis[inc][1][1] * n_y;
+    int inc_axis = std::abs(dot_x) >= std::abs(dot_y) ? 0 : 1;
+    float inc_sign = (inc_axis == 0 ? dot_x : dot_y) > 0 ? -1.0f : 1.0f;
+
+    int edge_axis = 1 - inc_axis;
+    float center_x = I.pos_x + inc_sign * axis[inc][inc_axis][0] * half[inc][inc_axis];
+    float center_y = I.pos_y + inc_sign * axis[inc][inc_axis][1] * half[inc][inc_axis];
+    float e_x = axis[inc][edge_axis][0] * half[inc][edge_axis];
+    float e_y = axis[inc][edge_axis][1] * half[inc][edge_axis];
+
+    float incident_edge[2][2] = {
+        {center_x + e_x, center_y + e_y},
+        {center_x - e_x, center_y - e_y}
+    };
+
+    // ------------------------------------------------------------------------------------
+    // Clip the incident edge against the side planes of the reference face
+
+    float clipped[3][2];
+    float clipped_edge[3][2];
+
+    if(clip_segment(incident_edge, clipped, t_x, t_y, side + half[ref][side_axis]) < 2)
+        return 0;
+    if(clip_segment(clipped, clipped_edge, -t_x, -t_y, - side + half[ref][side_axis]) < 2)
+        return 0;
+
+    // ------------------------------------------------------------------------------------
+    // The clipped points under the reference face are the contacts
+
+    int count = 0;
+
+    for(int i = 0; i < 2; i++){
+
+        float p_x = clipped_edge[i][0];
+        float p_y = clipped_edge[i][1];
+        float separation = n_x * p_x + n_y * p_y - front;
+        if(separation >= 0)
+            continue;
+
+        contact_data& contact = out_contacts[count++];
+        contact.pen = - separation;
+        contact.body_a = I.body;
+        contact.body_b = R.body;
+        contact.ws_n_x = n_x;
+        contact.ws_n_y = n_y;
+
+        // Point on the incident box and its projection on the reference face
+        world_to_model_offset(I.angle, p_x - I.pos_x, p_y - I.pos_y, contact.ms_qa_x, contact.ms_qa_y);
+        world_to_model_offset(R.angle, p_x - separation * n_x - R.pos_x, p_y - separation * n_y - R.pos_y, contact.ms_qb_x, contact.ms_qb_y);
+
+        set_contact_material(contact, coll_A, coll_B);
+    }
+
+    if(count == 2 && out_contacts[1].pen > out_contacts[0].pen)
+        std::swap(out_contacts[0], out_contacts[1]);
+
+    return count;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //             COLLISION DETECTION: CONTACT GENERATION - BoxBox contact generation naive algorithm
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -566,7 +914,7 @@ physic::dim2::contact_data physic::dim2::generate_spherebox_contactdata_norotati
 //        di uno dei rigidbody e il collider dell'altro rigidbody.
 //
 physic::dim2::contact_data physic::dim2::generate_boxbox_contactdata_naive_alg(
-    rigidbody& A, rigidbody& B, collider_box& coll_A, collider_box& coll_B
+    const body_pose& A, const body_pose& B, collider_box& coll_A, collider_box& coll_B
 ){
 
     // hold the resulting contact
@@ -593,14 +941,16 @@ physic::dim2::contact_data physic::dim2::generate_boxbox_contactdata_naive_alg(
     
     if (AB_contact.pen > BA_contact.pen) {
         res_contact = AB_contact;
-        res_contact.rb_a = &A;
-        res_contact.rb_b = &B;
+        res_contact.body_a = A.body;
+        res_contact.body_b = B.body;
     }else{
         res_contact = BA_contact;
-        res_contact.rb_a = &B;
-        res_contact.rb_b = &A;
+        res_contact.body_a = B.body;
+        res_contact.body_b = A.body;
     }
 
+    set_contact_material(res_contact, coll_A, coll_B);
+
     return res_contact;
 
 }
@@ -612,7 +962,7 @@ physic::dim2::contact_data physic::dim2::generate_boxbox_contactdata_naive_alg(
 // Writes in res_contact the contact with the biggest penetration.
 //
 physic::dim2::contact_data physic::dim2::generate_boxboxvertices_max_contactdata(
-    rigidbody& A, rigidbody& B, collider_box& coll_A, collider_box& coll_B
+    const body_pose& A, const body_pose& B, collider_box& coll_A, collider_box& coll_B
 ){
     
     // ------------------------------------------------------------------------------------
@@ -659,8 +1009,8 @@ physic::dim2::contact_data physic::dim2::generate_boxboxvertices_max_contactdata
             res_contact = vertex_contact;
             res_contact.ms_qa_x = A_collider_vertices[i][0];
             res_contact.ms_qa_y = A_collider_vertices[i][1];
-            res_contact.rb_a = &A;
-            res_contact.rb_b = &B;
+            res_contact.body_a = A.body;
+            res_contact.body_b = B.body;
         }
 
     }
@@ -680,7 +1030,7 @@ physic::dim2::contact_data physic::dim2::generate_boxboxvertices_max_contactdata
 // l'edge di B rispetto al quale la penetrazione è minima.
 //
 physic::dim2::contact_data physic::dim2::generate_pointbox_contactdata_naive_alg(
-    float world_point_x, float world_point_y, rigidbody& rb, collider_box& coll
+    float world_point_x, float world_point_y, const body_pose& rb, collider_box& coll
 ){
     // hold the resulting contact
     contact_data res_contact;
@@ -756,8 +1106,8 @@ physic::dim2::contact_data physic::dim2::generate_pointbox_contactdata_naive_alg
         // res_contact.qa_y: this is setup in the calling function.
         res_contact.ms_qb_x = - coll.width/2;
         res_contact.ms_qb_y = point_y;
-        // res_contact.rb_a: this is setup in the calling function.
-        // res_contact.rb_b: this is setup in the calling function.
+        // res_contact.body_a: this is setup in the calling function.
+        // res_contact.body_b: this is setup in the calling function.
 
     }
 
@@ -782,8 +1132,8 @@ physic::dim2::contact_data physic::dim2::generate_pointbox_contactdata_naive_alg
         // res_contact.qa_y: this is setup in the calling function.
         res_contact.ms_qb_x = point_x;
         res_contact.ms_qb_y = coll.height/2;
-        // res_contact.rb_a: this is setup in the calling function.
-        // res_contact.rb_b: this is setup in the calling function.
+        // res_contact.body_a: this is setup in the calling function.
+        // res_contact.body_b: this is setup in the calling function.
 
     }
     
@@ -808,8 +1158,8 @@ physic::dim2::contact_data physic::dim2::generate_pointbox_contactdata_naive_alg
         // res_contact.qa_y: this is setup in the calling function.
         res_contact.ms_qb_x = coll.width/2;
         res_contact.ms_qb_y = point_y;
-        // res_contact.rb_a: this is setup in the calling function.
-        // res_contact.rb_b: this is setup in the calling function.
+        // res_contact.body_a: this is setup in the calling function.
+        // res_contact.body_b: this is setup in the calling function.
 
     }
 
@@ -834,456 +1184,567 @@ physic::dim2::contact_data physic::dim2::generate_pointbox_contactdata_naive_alg
         // res_contact.qa_y: this is setup in the calling function.
         res_contact.ms_qb_x = point_x;
         res_contact.ms_qb_y = - coll.height/2;
-        // res_contact.rb_a: this is setup in the calling function.
-        // res_contact.rb_b: this is setup in the calling function.
+        // res_contact.body_a: this is setup in the calling function.
+        // res_contact.body_b: this is setup in the calling function.
 
     }
         
     return res_contact;
 }
 
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-//                                                CONTACT SOLVER
+//                                              CONSTRAINT SOLVER
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 // =========================================================================|
-//                       contact_solver_dispatcher
+//                       constraint_solver_dispatcher
 // =========================================================================|
+// Solve all the contacts inside the "w.contacts" vector and all the joints 
+// inside the joint pools of the world with sequential impulses:
+//
+//  - batches: color the constraints (see build_solver_batches)
+//
+//  - prestep: precompute per constraint the data that doesn't change during 
+//    the iterations (lever arms, effective masses, bias velocities)
+//
+//  - velocity: iterate w.velocity_iterations times over all the colors; 
+//    each iteration corrects the impulses accumulated by the previous ones,
+//    so that constraints sharing a rigidbody converge toward a common solution
+//
+//  - interpenetration: move the rigidbodies out of penetration
+//
+// With w.parallel the prestep and every color are parallel_for: the constraints
+// of a color don't share dynamic bodies, so the order they are solved in 
+// doesn't change the result. The overflow color is always sequential, and so
+// is the single batch of a small scene.
+//
+
+static const int solver_grain = 64;
+
+// The contacts of a manifold are consecutive, with the same bodies and normal
+static bool same_manifold(const physic::dim2::contact_data& a, const physic::dim2::contact_data& b){
+    return a.body_a == b.body_a && a.body_b == b.body_b && a.ws_n_x == b.ws_n_x && a.ws_n_y == b.ws_n_y;
+}
+
+void physic::dim2::constraint_solver_dispatcher(world& w, float delta_time){
+
+    float inv_delta_time = delta_time > 0 ? 1 / delta_time : 0;
+    bool parallel = w.parallel && !small_scene(w.bodies);
+    const solver_batches& batches = w.batches;
+
+    resolve_joint_rows(w);
+    build_solver_batches(w);
 
-void physic::dim2::contact_solver_dispatcher(){
+    if(!w.warm_starting)
+        reset_joint_impulses(w);
     
-    for( contact_data& contact : contacts){
+    parallel_for(parallel, batches.constraints.size(), solver_grain, [&](int begin, int end, int){
+        for( int c = begin; c < end; c++){
+            prestep_constraint(w, batches.constraints[c], inv_delta_time);
+        }
+    });
+
+    int colors_number = (int) batches.color_begin.size() - 1;
+
+    if(w.warm_starting){
+        for( int color = 0; color < colors_number; color++){
+
+            int first = batches.color_begin[color];
+            int count = batches.color_begin[color+1] - first;
+
+            parallel_for(color == max_solver_colors ? false : parallel, count, solver_grain, [&](int begin, int end, int){
+                for( int c = first + begin; c < first + end; c++){
+                    warm_start_constraint(w, batches.constraints[c]);
+                }
+            });
+        }
+    }
+
+    for( int i = 0; i < w.velocity_iterations; i++){
+        for( int color = 0; color < colors_number; color++){
+
+            int first = batches.color_begin[color];
+            int count = batches.color_begin[color+1] - first;
 
-        solve_velocity(contact);
-        solve_interpenetration(contact);
+            parallel_for(color == max_solver_colors ? false : parallel, count, solver_grain, [&](int begin, int end, int){
+                for( int c = first + begin; c < first + end; c++){
+                    solve_constraint(w, batches.constraints[c]);
+                }
+            });
+        }
+    }
+
+    store_contact_impulses(w);
 
+    float separated = 0;
+    for( int c = 0; c < w.contacts.size(); c++){
+        if(c == 0 || !same_manifold(w.contacts[c-1], w.contacts[c]))
+            separated = 0;
+        separated += solve_interpenetration(w.bodies, w.contacts[c], separated);
     }
 
+    for( int i = 0; i < w.joint_position_iterations; i++)
+        solve_joint_positions(w);
+
 }
 
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-//                                        CONTACT SOLVER: Velocity solver
-///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Determina le velocità in risposta al contatto
+// =========================================================================|
+//                          build_solver_batches
+// =========================================================================|
+// Greedy coloring of all the constraints: each constraint takes the lowest 
+// color not yet used by one of its dynamic rigidbodies. Every body row keeps
+// a bitmask of the colors already touching it; static bodies (row -1) never
+// limit the coloring since the solver doesn't write them.
+// The constraints are then counting-sorted by color and, inside a color, by
+// type; the sort is stable so the result only depends on the order of the
+// constraints in their containers.
+// A small scene is solved sequentially: a single batch in collection order.
 //
 
-void physic::dim2::solve_velocity(contact_data& contact){
+void physic::dim2::build_solver_batches(world& w){
 
-    // Note: With this configuration, rbA contact happen on a vertex while rbB contact
-    // happen on a surface. Hence the normal of contact specify the normal surface of B
+    solver_batches& out_batches = w.batches;
+    int bodies_number = body_count(w.bodies);
 
-    // ====================================================================================
-    // Setup model matrices for each rigid body
+    const arena_array<contact_data>& contacts = w.contacts;
+    const distance_joint_pool& distance_joints = w.distance_joints;
+    const revolute_joint_pool& revolute_joints = w.revolute_joints;
+    const weld_joint_pool& weld_joints = w.weld_joints;
 
-    rigidbody tmpRb;
+    // ------------------------------------------------------------------------------------
+    // Collect the constraints
 
-    rigidbody* rbB_ptr;
+    arena_array<constraint_ref> refs{&w.memory};
+    refs.reserve(contacts.size() + distance_joints.body_a.size() + revolute_joints.body_a.size() + weld_joints.body_a.size());
 
-    // If contact.rb_b == nullptr it means that the B object is a static object
-    if(contact.rb_b == nullptr){
-        tmpRb.angle = 0;
-        tmpRb.I = 100000000;
-        tmpRb.m = 100000000;
-        tmpRb.pos_x = 0;
-        tmpRb.pos_y = 0;
-        tmpRb.vel_x = 0;
-        tmpRb.vel_y = 0;
-        tmpRb.w = 0;
-        rbB_ptr = &tmpRb;
+    for(int i = 0; i < contacts.size(); i++)                    refs.push_back({constraint_ref::CONTACT, i});
+    for(int i = 0; i < distance_joints.body_a.size(); i++)      if(joint_active(distance_joints, i)) refs.push_back({constraint_ref::DISTANCE_JOINT, i});
+    for(int i = 0; i < revolute_joints.body_a.size(); i++)      if(joint_active(revolute_joints, i)) refs.push_back({constraint_ref::REVOLUTE_JOINT, i});
+    for(int i = 0; i < weld_joints.body_a.size(); i++)          if(joint_active(weld_joints, i)) refs.push_back({constraint_ref::WELD_JOINT, i});
 
-        contact.rb_b = contact.rb_a;
-        
-    }else{
-        rbB_ptr = contact.rb_b;
+    if(small_scene(w.bodies)){
+        out_batches.constraints.assign(refs.begin(), refs.end());
+        out_batches.color_begin.assign(1, 0);
+        if(!refs.empty())
+            out_batches.color_begin.push_back(refs.size());
+        return;
     }
 
-    rigidbody& rbA = *(contact.rb_a);
-    rigidbody& rbB = *rbB_ptr;
-
-    mat4x4 model_matrix_A;
-    mat4x4 model_matrix_B;
-    mat4x4 rotation_matrix_A;
-    mat4x4 rotation_matrix_B;
-
-    mat4x4 inverse_model_matrix_A;
-    mat4x4 inverse_model_matrix_B;
-    mat4x4 inverse_rotation_matrix_A;
-    mat4x4 inverse_rotation_matrix_B;
-
-
-    build_model_matrix(model_matrix_A, rbA.pos_x, rbA.pos_y, rbA.angle);
-    build_model_matrix(model_matrix_B, rbB.pos_x, rbB.pos_y, rbB.angle);
-    build_model_matrix(rotation_matrix_A, 0, 0, rbA.angle);
-    build_model_matrix(rotation_matrix_B, 0, 0, rbB.angle);
-
-    mat4x4_invert(inverse_model_matrix_A, model_matrix_A);
-    mat4x4_invert(inverse_model_matrix_B, model_matrix_B);
-    mat4x4_invert(inverse_rotation_matrix_A, rotation_matrix_A);
-    mat4x4_invert(inverse_rotation_matrix_B, rotation_matrix_B);
-
-    // ====================================================================================
-    // Find the world velocity of the point q_a on rbA.
-    // The total velocity is composed by 2 components:
-    //      - The linear velocity of the rigdbody center of mass
-    //      - The angular velocity of the rigidbody itself
-    //
-    // To find the total velocity we must find the linear velocity caused by each component
-    // and sum them:
-    //      
-    //  ○   Tot_qa_velocity = rbA_linear_velocity + linear_qa_angular_velocity
-    // 
-
     // ------------------------------------------------------------------------------------
-    // Find the linear velocity effect on qa caused by rbA angular velocity:
+    // Assign the colors
 
-    // Find the linear velocity on qa caused by the angular velocity of the rigid body, 
-    // in the model space of the rigidbody: (from v = w ∧ r )
-    //
-    //  ○   local_v = rbA.w ∧ q_a
-    //
-    float local_va_x = - rbA.w * contact.ms_qa_y;
-    float local_va_y = rbA.w * contact.ms_qa_x;
+    const int overflow_color = max_solver_colors;
+    uint64_t* body_colors = arena_allocate<uint64_t>(w.memory, bodies_number);
+    int* ref_colors = arena_allocate<int>(w.memory, refs.size());
+    int color_count[max_solver_colors + 1] = {};
 
-    // Translate the previous velocity vector from model space to world space
-    vec4 local_rotation_va = { local_va_x, local_va_y, 0, 0};
-    vec4 world_rotation_va;
-    mat4x4_mul_vec4(world_rotation_va, rotation_matrix_A, local_rotation_va);
+    std::fill(body_colors, body_colors + bodies_number, 0);
 
-    // ------------------------------------------------------------------------------------
-    // Find the total world velocity of q_a:
-
-    float va_x = rbA.vel_x + world_rotation_va[0];
-    float va_y = rbA.vel_y + world_rotation_va[1];
-
-    // ====================================================================================
-    // Find the world velocity of the point q_b on rbB.
-    // The total velocity is composed by 2 components:
-    //      - The linear velocity of the rigdbody center of mass
-    //      - The angular velocity of the rigidbody itself
-    //
-    // To find the total velocity we must find the linear velocity caused by each component
-    // and sum them:
-    //      
-    //  ○   Tot_qb_velocity = rbB_linear_velocity + linear_qb_angular_velocity
-    // 
+    for(int i = 0; i < refs.size(); i++){
+        
+        int body_a;
+        int body_b;
+        get_constraint_bodies(w, refs[i], body_a, body_b);
 
-    // ------------------------------------------------------------------------------------
-    // Find the linear velocity effect on qb caused by rbB angular velocity:
+        uint64_t used = 0;
+        if(body_a >= 0) used |= body_colors[body_a];
+        if(body_b >= 0) used |= body_colors[body_b];
 
-    // Find the linear velocity on qa caused by the angular velocity of the rigid body, 
-    // in the model space of the rigidbody: (from v = w ∧ r )
-    //      
-    //  ○   local_v = rbB.w ∧ q_b
-    //
+        int color = overflow_color;
+        if(used != ~(uint64_t)0){
+            color = 0;
+            while( used & ((uint64_t)1 << color) ) color++;
 
-    float local_vb_x = - rbB.w * contact.ms_qb_y;
-    float local_vb_y = rbB.w * contact.ms_qb_x;
+            if(body_a >= 0) body_colors[body_a] |= (uint64_t)1 << color;
+            if(body_b >= 0) body_colors[body_b] |= (uint64_t)1 << color;
+        }
 
-    // Translate the previous velocity vector from model space to world space
-    vec4 local_rotation_vb = { local_vb_x, local_vb_y, 0, 0};
-    vec4 world_rotation_vb;
-    mat4x4_mul_vec4(world_rotation_vb, rotation_matrix_B, local_rotation_vb);
+        ref_colors[i] = color;
+        color_count[color]++;
+    }
 
     // ------------------------------------------------------------------------------------
-    // Find the total world velocity of q_b:
+    // Sort by color and type
 
-    float vb_x = rbB.vel_x + world_rotation_vb[0];
-    float vb_y = rbB.vel_y + world_rotation_vb[1];
+    int used_colors = 0;
+    for(int c = 0; c <= max_solver_colors; c++){
+        if(color_count[c] > 0) used_colors = c + 1;
+    }
 
-    // ====================================================================================
-    // Find the velocity at which points q_a and q_b are approaching (closing velocity)
+    out_batches.color_begin.assign(used_colors + 1, 0);
+    for(int c = 0; c < used_colors; c++){
+        out_batches.color_begin[c+1] = out_batches.color_begin[c] + color_count[c];
+    }
 
-    // ------------------------------------------------------------------------------------
-    // Now we have the world velocity va and vb of the points q_a and q_b.
-    // We first find velocities of q_a and q_b along the normal contact; to do so we 
-    // project va and vb along n using the dot product:
-    //      
-    //  ○   va_n = va ⋅ n
-    //  ○   vb_n = vb ⋅ n
-    //
+    out_batches.constraints.resize(refs.size());
+    int write_pos[max_solver_colors + 1];
+    std::copy(out_batches.color_begin.begin(), out_batches.color_begin.end() - 1, write_pos);
 
-    float va_n = va_x*contact.ws_n_x + va_y*contact.ws_n_y;
-    float vb_n = vb_x*contact.ws_n_x + vb_y*contact.ws_n_y;
+    // refs is already grouped by type, so a stable pass per color keeps the types grouped
+    for(int i = 0; i < refs.size(); i++){
+        out_batches.constraints[ write_pos[ref_colors[i]]++ ] = refs[i];
+    }
+}
 
-    // ------------------------------------------------------------------------------------
-    // Find the closing velocity: 
-    // This is just a scalar representing a relative velocity along the normal of contact
-    //
+// =========================================================================|
+//                     constraint interface dispatch
+// =========================================================================|
 
-    float vc = vb_n - va_n;
+// The joint rows must be resolved (resolve_joint_rows) before the bodies
+// of a joint are asked.
+//
+void physic::dim2::get_constraint_bodies(const world& w, constraint_ref ref, int& out_body_a, int& out_body_b){
+    switch(ref.type){
+        case constraint_ref::CONTACT:
+            out_body_a = w.contacts[ref.index].body_a;
+            out_body_b = w.contacts[ref.index].body_b;
+            break;
+        case constraint_ref::DISTANCE_JOINT:
+            out_body_a = w.distance_joints.row_a[ref.index];
+            out_body_b = w.distance_joints.row_b[ref.index];
+            break;
+        case constraint_ref::REVOLUTE_JOINT:
+            out_body_a = w.revolute_joints.row_a[ref.index];
+            out_body_b = w.revolute_joints.row_b[ref.index];
+            break;
+        case constraint_ref::WELD_JOINT:
+            out_body_a = w.weld_joints.row_a[ref.index];
+            out_body_b = w.weld_joints.row_b[ref.index];
+            break;
+    }
+}
 
-    // If the closing velocity is negative, it means the two points are already
-    // separating, hence exit the function
-    if(vc<0)
-        return;
+// With the joint position passes on, the velocity pass of the joints has no Baumgarte bias: the bias
+// on top of the warm started impulses overshoots (a weld chain oscillates, then explodes) and the
+// position passes already remove the error.
+void physic::dim2::prestep_constraint(world& w, constraint_ref ref, float inv_delta_time){
+    body_storage& bodies = w.bodies;
+    float baumgarte = w.joint_position_iterations > 0 ? 0 : w.joint_baumgarte;
+    switch(ref.type){
+        case constraint_ref::CONTACT:           prestep_contact(bodies, w.contacts[ref.index], w.restitution_velocity_threshold); break;
+        case constraint_ref::DISTANCE_JOINT:    prestep_distance_joint(bodies, w.distance_joints, ref.index, inv_delta_time, baumgarte); break;
+        case constraint_ref::REVOLUTE_JOINT:    prestep_revolute_joint(bodies, w.revolute_joints, ref.index, inv_delta_time, baumgarte); break;
+        case constraint_ref::WELD_JOINT:        prestep_weld_joint(bodies, w.weld_joints, ref.index, inv_delta_time, baumgarte); break;
+    }
+}
 
-    // ------------------------------------------------------------------------------------
-    // Find the closing velocity after the collision
+void physic::dim2::warm_start_constraint(world& w, constraint_ref ref){
+    body_storage& bodies = w.bodies;
+    switch(ref.type){
+        case constraint_ref::CONTACT:           warm_start_contact(w, w.contacts[ref.index]); break;
+        case constraint_ref::DISTANCE_JOINT:    warm_start_distance_joint(bodies, w.distance_joints, ref.index); break;
+        case constraint_ref::REVOLUTE_JOINT:    warm_start_revolute_joint(bodies, w.revolute_joints, ref.index); break;
+        case constraint_ref::WELD_JOINT:        warm_start_weld_joint(bodies, w.weld_joints, ref.index); break;
+    }
+}
 
-    float vc_s = - 0.98 * vc; // before it was 0.88
+void physic::dim2::solve_constraint(world& w, constraint_ref ref){
+    body_storage& bodies = w.bodies;
+    switch(ref.type){
+        case constraint_ref::CONTACT:           solve_velocity(bodies, w.contacts[ref.index]); break;
+        case constraint_ref::DISTANCE_JOINT:    solve_distance_joint(bodies, w.distance_joints, ref.index); break;
+        case constraint_ref::REVOLUTE_JOINT:    solve_revolute_joint(bodies, w.revolute_joints, ref.index); break;
+        case constraint_ref::WELD_JOINT:        solve_weld_joint(bodies, w.weld_joints, ref.index); break;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                        CONTACT SOLVER: Velocity solver
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Determina le velocità in risposta al contatto
+//
+// Note: With this configuration, rbA contact happen on a vertex while rbB contact
+// happen on a surface. Hence the normal of contact specify the normal surface of B
+// and points from B toward A.
+// If contact.body_b == -1 the B object is a static object (infinite mass).
+//
+
+// =========================================================================|
+//                              prestep_contact
+// =========================================================================|
+// Precompute the solver data of a contact; must be called once, before the
+// velocity iterations.
+//
+//  - Lever arms: the model space contact points q rotated in world space
+//
+//      r = R(angle) * q
+//
+//  - Effective mass along a direction d: the inverse of the change of 
+//    relative velocity (along d) produced by a unit impulse along d
+//
+//      k = 1/m_a + 1/m_b + (r_a ∧ d)^2 / I_a + (r_b ∧ d)^2 / I_b
+//      mass = 1 / k
+//
+//    It is computed both for the normal n and for the tangent t.
+//
+//  - Velocity bias: if the bodies are approaching faster than 
+//    restitution_velocity_threshold, the solver targets a separating 
+//    velocity of -restitution * vn
+//
+void physic::dim2::prestep_contact(body_storage& bodies, contact_data& contact, float restitution_velocity_threshold){
+
+    int a = contact.body_a;
+    int b = contact.body_b;
+
+    float n_x = contact.ws_n_x;
+    float n_y = contact.ws_n_y;
+    float t_x = n_y;
+    float t_y = - n_x;
 
     // ------------------------------------------------------------------------------------
-    // Find the delta velocity:
-    // This is the difference between the closing velocity before and after the collision.
-    // It will be used to determine the nature of the impulse (which indeed produces this
-    // change in velocity)
-    //
-
-    //float actual_vc_change = std::min(abs(vc_s - vc), 50.f );   
-    float actual_vc_change = abs(vc_s - vc);
-
-    // ====================================================================================
-    // Determine the effect of a unit impulse on the contact points:
-    // We must determine the impulse that cause the previous velocity change.
-    // To do so we first study the effect of an unit impulse on the different kind of 
-    // velocities when applied on the contact points (with a direction equal to the
-    // normal of contact).
-    //
+    // Lever arms in world space
+
+    float cos_a = std::cos(bodies.angle[a]);
+    float sin_a = std::sin(bodies.angle[a]);
+    contact.ws_ra_x = cos_a * contact.ms_qa_x - sin_a * contact.ms_qa_y;
+    contact.ws_ra_y = sin_a * contact.ms_qa_x + cos_a * contact.ms_qa_y;
+
+    float inv_m_a = 1 / bodies.m[a];
+    float inv_i_a = 1 / bodies.I[a];
+    float inv_m_b = 0;
+    float inv_i_b = 0;
+
+    if(b >= 0){
+        float cos_b = std::cos(bodies.angle[b]);
+        float sin_b = std::sin(bodies.angle[b]);
+        contact.ws_rb_x = cos_b * contact.ms_qb_x - sin_b * contact.ms_qb_y;
+        contact.ws_rb_y = sin_b * contact.ms_qb_x + cos_b * contact.ms_qb_y;
+        inv_m_b = 1 / bodies.m[b];
+        inv_i_b = 1 / bodies.I[b];
+    }else{
+        contact.ws_rb_x = 0;
+        contact.ws_rb_y = 0;
+    }
 
     // ------------------------------------------------------------------------------------
-    // Unit impulse effect on linear velocity:
-    // We first find the change of linear velocity of the contact points due to the effect 
-    // of a unit impulse:
-    // (Since the impulse is along the normal, we directly find the velocity change along 
-    // the normal)
-    // From J = p1 - p2 = v1*m - v2*m we have:
-    //
-    //  ○   dv = |J| / mass = 1 / mass
-    //
-
-    float lin_dva_n = 1/rbA.m; 
-    float lin_dvb_n = 1/rbB.m;                                      
-
-    // Total closing velocity change due to linear effect of unit impulse:
-    float linear_effect = lin_dva_n + lin_dvb_n;
+    // Effective masses
+
+    float rn_a = contact.ws_ra_x * n_y - contact.ws_ra_y * n_x;
+    float rn_b = contact.ws_rb_x * n_y - contact.ws_rb_y * n_x;
+    float k_normal = inv_m_a + inv_m_b + rn_a * rn_a * inv_i_a + rn_b * rn_b * inv_i_b;
+    contact.normal_mass = k_normal > 0 ? 1 / k_normal : 0;
+
+    float rt_a = contact.ws_ra_x * t_y - contact.ws_ra_y * t_x;
+    float rt_b = contact.ws_rb_x * t_y - contact.ws_rb_y * t_x;
+    float k_tangent = inv_m_a + inv_m_b + rt_a * rt_a * inv_i_a + rt_b * rt_b * inv_i_b;
+    contact.tangent_mass = k_tangent > 0 ? 1 / k_tangent : 0;
 
     // ------------------------------------------------------------------------------------
-    // NEW: Transform the normal of contact from world space to A model space
+    // Restitution bias from the relative normal velocity before the collision
 
-    float ms_na_x;
-    float ms_na_y;
+    float va_x, va_y, vb_x, vb_y;
+    point_velocity(bodies, a, contact.ws_ra_x, contact.ws_ra_y, va_x, va_y);
+    point_velocity(bodies, b, contact.ws_rb_x, contact.ws_rb_y, vb_x, vb_y);
 
-    {   
-        vec4 ws_n = { contact.ws_n_x, contact.ws_n_y, 0.0, 0};
-        vec4 ms_n;
-        mat4x4_mul_vec4(ms_n, inverse_rotation_matrix_A, ws_n);
+    float vn = (va_x - vb_x) * n_x + (va_y - vb_y) * n_y;
 
-        vec2 normalizer = {ms_n[0], ms_n[1]};
-        float norm = vec2_len( normalizer);
-        
-        ms_na_x = normalizer[0] / norm;
-        ms_na_y = normalizer[1] / norm;
-
-        /* std::cout << " ================================  " << std::endl << std::flush;
-        std::cout << " TRANSFORMING NORMAL: " << std::endl << std::flush;
-        std::cout << "ws normal: " << contact.ws_n_x << ", " << contact.ws_n_y << std::endl << std::flush;
-        std::cout << "normalizer: " << normalizer[0] << ", " << normalizer[1] << std::endl << std::flush;
-        std::cout << "norm: " << norm << std::endl << std::flush;
-        std::cout << "ms_nb_x: " << ms_na_x << std::endl << std::flush;
-        std::cout << "ms_nb_y: " << ms_na_y << std::endl << std::flush; */
+    contact.velocity_bias = 0;
+    if(vn < - restitution_velocity_threshold){
+        contact.velocity_bias = - contact.restitution * vn;
     }
 
-    // ------------------------------------------------------------------------------------
-    // Unit impulse effect on angular velocity:
-    // Now we find the linear velocity change of qa due to angular effect of unit impulse:
+    contact.normal_impulse = 0;
+    contact.tangent_impulse = 0;
+}
 
-    // We first find the impulsive torque of a unit impulse:
-    // 
-    //  ○   u = q ∧ J
-    //
-    // In this case J = (n_x, n_y), hence we have:
+// =========================================================================|
+//                              solve_velocity
+// =========================================================================|
+// One sequential impulse iteration on a contact:
+//
+//  - Normal: find the impulse that brings the relative normal velocity to 
+//    velocity_bias; the accumulated normal impulse is clamped to be >= 0 
+//    (contacts can only push)
+//
+//      lambda = normal_mass * (velocity_bias - vn)
+//
+//  - Friction: find the impulse that cancels the relative tangent velocity;
+//    the accumulated tangent impulse is clamped inside the Coulomb cone
+//
+//      |tangent_impulse| <= friction * normal_impulse
+//
+void physic::dim2::solve_velocity(body_storage& bodies, contact_data& contact){
 
-    float ua = contact.ms_qa_x * ms_na_y - contact.ms_qa_y * ms_na_x ;
-    
-    // We then find the change in angular velocity with: (from 𝜏 = F ∧ r = Iα )
-    //
-    //  ○   dw = u / I
-    //
+    int a = contact.body_a;
+    int b = contact.body_b;
 
-    float dwa = 1/rbA.I * ua;
-    
-    // We then find the change in linear velocity produced by the previous change in 
-    // angular velocity:
-    //
-    //  ○   dv = dw ∧ q
-    //
+    float n_x = contact.ws_n_x;
+    float n_y = contact.ws_n_y;
+    float t_x = n_y;
+    float t_y = - n_x;
 
-    float dva_x = - dwa * contact.ms_qa_y;
-    float dva_y = dwa * contact.ms_qa_x;
+    float va_x, va_y, vb_x, vb_y;
 
-    // Finally we're interested only in the previous change of velocity ALONG the
-    // contact normal (because we want to see the effect of the unit impulse
-    // on the velocity along that normal )
+    // ------------------------------------------------------------------------------------
+    // Normal impulse
 
-    float ang_dva_n = dva_x * ms_na_x + dva_y * ms_na_y;
+    point_velocity(bodies, a, contact.ws_ra_x, contact.ws_ra_y, va_x, va_y);
+    point_velocity(bodies, b, contact.ws_rb_x, contact.ws_rb_y, vb_x, vb_y);
 
-    // ------------------------------------------------------------------------------------
-    // NEW: Transform the normal of contact from world space to B model space
+    float vn = (va_x - vb_x) * n_x + (va_y - vb_y) * n_y;
+    float lambda_n = contact.normal_mass * (contact.velocity_bias - vn);
 
-    float ms_nb_x;
-    float ms_nb_y;
+    float old_normal_impulse = contact.normal_impulse;
+    contact.normal_impulse = std::max(old_normal_impulse + lambda_n, 0.0f);
+    lambda_n = contact.normal_impulse - old_normal_impulse;
+
+    apply_world_impulse(bodies, a, contact.ws_ra_x, contact.ws_ra_y, lambda_n * n_x, lambda_n * n_y);
+    apply_world_impulse(bodies, b, contact.ws_rb_x, contact.ws_rb_y, - lambda_n * n_x, - lambda_n * n_y);
 
-    {       
-        vec4 ws_n = { -contact.ws_n_x, -contact.ws_n_y, 0.0, 0 };
-        vec4 ms_n;
-        mat4x4_mul_vec4(ms_n, inverse_rotation_matrix_B, ws_n);
-        
-        vec2 normalizer = {ms_n[0], ms_n[1]};
-        float norm = vec2_len( normalizer);
-        
-        ms_nb_x = normalizer[0] / norm;
-        ms_nb_y = normalizer[1] / norm;
-
-        /* std::cout << " ================================  " << std::endl << std::flush;
-        std::cout << " TRANSFORMING NORMAL: " << std::endl << std::flush;
-        std::cout << "ws normal: " << contact.ws_n_x << ", " << contact.ws_n_y << std::endl << std::flush;
-        std::cout << "normalizer: " << normalizer[0] << ", " << normalizer[1] << std::endl << std::flush;
-        std::cout << "norm: " << norm << std::endl << std::flush;
-        std::cout << "ms_nb_x: " << ms_nb_x << std::endl << std::flush;
-        std::cout << "ms_nb_y: " << ms_nb_y << std::endl << std::flush; */
-    }
-    
     // ------------------------------------------------------------------------------------
-    // Unit impulse effect on angular velocity:
-    // Now we find the linear velocity change of qb due to angular effect of unit impulse:
+    // Friction impulse
 
-    // We first find the impulsive torque of a unit impulse:
-    // 
-    //  ○   u = q ∧ J
-    //
-    // In this case J = (n_x, n_y), hence we have:
+    point_velocity(bodies, a, contact.ws_ra_x, contact.ws_ra_y, va_x, va_y);
+    point_velocity(bodies, b, contact.ws_rb_x, contact.ws_rb_y, vb_x, vb_y);
 
-    float ub = contact.ms_qb_x * ms_nb_y - contact.ms_qb_y * ms_nb_x;
+    float vt = (va_x - vb_x) * t_x + (va_y - vb_y) * t_y;
+    float lambda_t = - contact.tangent_mass * vt;
 
-    // We then find the change in angular velocity with: (from 𝜏 = F ∧ r = Iα )
-    //
-    //  ○   dw = u / I
-    //
+    float max_friction = contact.friction * contact.normal_impulse;
+    float old_tangent_impulse = contact.tangent_impulse;
+    contact.tangent_impulse = std::min(std::max(old_tangent_impulse + lambda_t, - max_friction), max_friction);
+    lambda_t = contact.tangent_impulse - old_tangent_impulse;
 
-    float dwb = 1/rbB.I * ub;
+    apply_world_impulse(bodies, a, contact.ws_ra_x, contact.ws_ra_y, lambda_t * t_x, lambda_t * t_y);
+    apply_world_impulse(bodies, b, contact.ws_rb_x, contact.ws_rb_y, - lambda_t * t_x, - lambda_t * t_y);
 
-    // We then find the change in linear velocity produced by the previous change in 
-    // angular velocity:
-    //
-    //  ○   dv = dw ∧ q
-    //
+    contact.resolved_impulse_mag = contact.normal_impulse;
+}
 
-    float dvb_x = - dwb * contact.ms_qb_y;
-    float dvb_y = dwb * contact.ms_qb_x;
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                        CONTACT SOLVER: Warm starting
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The cache is sorted by (id_a, id_b, point): the contacts of a pair are a
+// range found with a binary search, and the sort only depends on the 
+// content of the cache (deterministic mode).
+//
 
-    // Finally we're interested only in the previous change of velocity ALONG the
-    // contact normal (because we want to see the effect of the unit impulse
-    // on the velocity along that normal )
+static bool cached_contact_less(const physic::dim2::cached_contact& a, const physic::dim2::cached_contact& b){
+    if(a.id_a != b.id_a) return a.id_a < b.id_a;
+    if(a.id_b != b.id_b) return a.id_b < b.id_b;
+    if(a.ms_qa_x != b.ms_qa_x) return a.ms_qa_x < b.ms_qa_x;
+    return a.ms_qa_y < b.ms_qa_y;
+}
 
-    float ang_dvb_n = dvb_x * ms_nb_x + dvb_y * ms_nb_y;    
+// =========================================================================|
+//                            warm_start_contact
+// =========================================================================|
+// Pick the closest cached contact of the same bodies and normal (if any 
+// within warm_start_distance) and apply its impulses: the velocity 
+// iterations go on from the solution of the last step.
+//
+void physic::dim2::warm_start_contact(world& w, contact_data& contact){
 
-    // ------------------------------------------------------------------------------------
-    // Total closing velocity change due to angular effect of unit impulse:
-    float angular_effect = ang_dva_n + ang_dvb_n;
+    // Normals within ~8 degrees
+    const float min_normal_cos = 0.99f;
 
-    // ====================================================================================
+    body_storage& bodies = w.bodies;
+    int a = contact.body_a;
+    int b = contact.body_b;
 
-    // Total closing velocity change: With respect to the model of this contact, a unit 
-    // impulse on the contact point produces a change on the closing velocity equals to: 
+    cached_contact key;
+    key.id_a = bodies.id[a];
+    key.id_b = b >= 0 ? bodies.id[b] : -1;
+    key.ms_qa_x = - std::numeric_limits<float>::max();
+    key.ms_qa_y = - std::numeric_limits<float>::max();
 
-    float vc_change_per_imp_unit = linear_effect + angular_effect;
+    const cached_contact* best = nullptr;
+    float best_distance2 = w.warm_start_distance * w.warm_start_distance;
 
-    // Hence, the impulse that produced the actual change in closing velocity must have
-    // a magnitude equal to:
-    
-    float imp_mag = actual_vc_change / vc_change_per_imp_unit;
+    auto it = std::lower_bound(w.contact_cache.begin(), w.contact_cache.end(), key, cached_contact_less);
+    for(; it != w.contact_cache.end() && it->id_a == key.id_a && it->id_b == key.id_b; ++it){
 
-    // ====================================================================================        
-    // Apply the impulse
+        if(it->ws_n_x * contact.ws_n_x + it->ws_n_y * contact.ws_n_y < min_normal_cos)
+            continue;
 
-    impulse imp;
-    imp.mag = imp_mag;
+        float d_x = it->ms_qa_x - contact.ms_qa_x;
+        float d_y = it->ms_qa_y - contact.ms_qa_y;
+        float distance2 = d_x * d_x + d_y * d_y;
+        if(distance2 <= best_distance2){
+            best = &*it;
+            best_distance2 = distance2;
+        }
+    }
 
-    imp.d_x = contact.ws_n_x;
-    imp.d_y = contact.ws_n_y;
-    imp.q_x = contact.ms_qa_x;
-    imp.q_y = contact.ms_qa_y;
+    if(!best)
+        return;
 
-    apply_impulse( rbA, imp);
+    contact.normal_impulse = best->normal_impulse;
+    contact.tangent_impulse = best->tangent_impulse;
 
-    imp.d_x = - contact.ws_n_x;
-    imp.d_y = - contact.ws_n_y;
-    imp.q_x = contact.ms_qb_x;
-    imp.q_y = contact.ms_qb_y;
+    float p_x = contact.normal_impulse * contact.ws_n_x + contact.tangent_impulse * contact.ws_n_y;
+    float p_y = contact.normal_impulse * contact.ws_n_y - contact.tangent_impulse * contact.ws_n_x;
 
-    apply_impulse( rbB, imp);
-    
-    contact.resolved_impulse_mag = imp.mag;
-
-    /* std::cout << "=====================================================" << std::endl << std::flush;
-    std::cout << "VELOCITY SOLVER DATA: " << std::endl << std::flush;
-    std::cout << "local_va_x: " << local_va_x << std::endl << std::flush;
-    std::cout << "local_va_y: " << local_va_y << std::endl << std::flush;
-    std::cout << "va_x: " << va_x << std::endl << std::flush;
-    std::cout << "va_y: " << va_y << std::endl << std::flush;
-    std::cout << "local_vb_x: " << local_vb_x << std::endl << std::flush;
-    std::cout << "local_vb_y: " << local_vb_y << std::endl << std::flush;
-    std::cout << "vb_x: " << vb_x << std::endl << std::flush;
-    std::cout << "vb_y: " << vb_y << std::endl << std::flush;
-    std::cout << "va_n: " << va_n << std::endl << std::flush;
-    std::cout << "vb_n: " << vb_n << std::endl << std::flush;
-    std::cout << "vc: " << vc << std::endl << std::flush;
-    std::cout << "vc_s: " << vc_s << std::endl << std::flush;
-    std::cout << "actual_vc_change: " << actual_vc_change << std::endl << std::flush;
-    std::cout << "lin_dva_n: " << lin_dva_n << std::endl << std::flush;
-    std::cout << "lin_dvb_n: " << lin_dvb_n << std::endl << std::flush;
-    std::cout << "linear_effect: " << linear_effect << std::endl << std::flush;
-    std::cout << "ua: " << ua << std::endl << std::flush;
-    std::cout << "dwa: " << dwa << std::endl << std::flush;
-    std::cout << "dva_x: " << dva_x << std::endl << std::flush;
-    std::cout << "dva_y: " << dva_y << std::endl << std::flush;
-    std::cout << "ang_dva_n: " << ang_dva_n << std::endl << std::flush;
-    std::cout << "ub: " << ub << std::endl << std::flush;
-    std::cout << "dwb: " << dwb << std::endl << std::flush;
-    std::cout << "dvb_x: " << dvb_x << std::endl << std::flush;
-    std::cout << "dvb_y: " << dvb_y << std::endl << std::flush;
-    std::cout << "ang_dvb_n: " << ang_dvb_n << std::endl << std::flush;
-    std::cout << "angular_effect: " << angular_effect << std::endl << std::flush;
-    std::cout << "vc_change_per_imp_unit: " << vc_change_per_imp_unit << std::endl << std::flush;
-    std::cout<< "Impulse Magnitude: " << imp.mag << std::endl << std::flush; */
+    apply_world_impulse(bodies, a, contact.ws_ra_x, contact.ws_ra_y, p_x, p_y);
+    apply_world_impulse(bodies, b, contact.ws_rb_x, contact.ws_rb_y, - p_x, - p_y);
+}
 
+// =========================================================================|
+//                          store_contact_impulses
+// =========================================================================|
+
+void physic::dim2::store_contact_impulses(world& w){
+
+    std::vector<cached_contact>& cache = w.contact_cache;
+    cache.clear();
+
+    if(!w.warm_starting)
+        return;
+
+    cache.resize(w.contacts.size());
+    for(int c = 0; c < w.contacts.size(); c++){
+        const contact_data& contact = w.contacts[c];
+        cached_contact& cached = cache[c];
+        cached.id_a = w.bodies.id[contact.body_a];
+        cached.id_b = contact.body_b >= 0 ? w.bodies.id[contact.body_b] : -1;
+        cached.ms_qa_x = contact.ms_qa_x;
+        cached.ms_qa_y = contact.ms_qa_y;
+        cached.ws_n_x = contact.ws_n_x;
+        cached.ws_n_y = contact.ws_n_y;
+        cached.normal_impulse = contact.normal_impulse;
+        cached.tangent_impulse = contact.tangent_impulse;
+    }
+
+    std::sort(cache.begin(), cache.end(), cached_contact_less);
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //                                        CONTACT SOLVER: Interpenetration solver
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Risolve le interpenetrazioni presenti alla registrazione del contatto
+// Risolve le interpenetrazioni presenti alla registrazione del contatto;
+// the penetration is split between the two bodies proportionally to their
+// inverse mass (a static B takes none of it).
+// "separated" is the separation along n already given to the same bodies by
+// the previous contacts of their manifold: only the rest is resolved. Returns
+// the separation given by this contact.
 //
 
-void physic::dim2::solve_interpenetration(contact_data& contact){
-
-    rigidbody tmpRb;
-    if(contact.rb_b == nullptr){
-        tmpRb.angle = 0;
-        tmpRb.I = 100000000;
-        tmpRb.m = 100000000;
-        tmpRb.pos_x = contact.rb_a->pos_x;
-        tmpRb.pos_y = contact.rb_a->pos_y;
-        tmpRb.vel_x = 0;
-        tmpRb.vel_y = 0;
-        tmpRb.w = 0;
-        contact.rb_b = &tmpRb;
-    }
+float physic::dim2::solve_interpenetration(body_storage& bodies, contact_data& contact, float separated){
 
+    int a = contact.body_a;
+    int b = contact.body_b;
 
-    // With this configuration, rbA contact happen on a vertex while rbB contact
-    // happen on a surface. Hence the normal of contact specify the normal surface of B
-    rigidbody& rbA = *(contact.rb_a);
-    rigidbody& rbB = *(contact.rb_b);
+    float pen = contact.pen - separated;
+    if(pen <= 0)
+        return 0;
 
-    float mass_factor_A = rbB.m / (rbA.m + rbB.m);
-    float mass_factor_B = rbA.m / (rbA.m + rbB.m);
+    float inv_m_a = 1 / bodies.m[a];
+    float inv_m_b = b >= 0 ? 1 / bodies.m[b] : 0;
+
+    float mass_factor_A = inv_m_a / (inv_m_a + inv_m_b);
+    float mass_factor_B = inv_m_b / (inv_m_a + inv_m_b);
     
-    float disp_x = contact.pen * contact.ws_n_x;
-    float disp_y = contact.pen * contact.ws_n_y;
+    float disp_x = pen * contact.ws_n_x;
+    float disp_y = pen * contact.ws_n_y;
+
+    bodies.pos_x[a] += disp_x * mass_factor_A;
+    bodies.pos_y[a] += disp_y * mass_factor_A;
+
+    if(b >= 0){
+        bodies.pos_x[b] -= disp_x * mass_factor_B;
+        bodies.pos_y[b] -= disp_y * mass_factor_B;
+    }
 
-    rbA.pos_x += disp_x * mass_factor_A;
-    rbA.pos_y += disp_y * mass_factor_A;
-    rbB.pos_x -= disp_x * mass_factor_B;
-    rbB.pos_y -= disp_y * mass_factor_B;
+    return pen;
 }
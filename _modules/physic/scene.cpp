@@ -0,0 +1,589 @@
+#include "physic.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <unordered_set>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                              SCENE FILE
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static size_t section_align(size_t bytes){
+    return (bytes + physic::dim2::scene_section_alignment - 1) / physic::dim2::scene_section_alignment * physic::dim2::scene_section_alignment;
+}
+
+// Bytes of one element of every section
+static size_t section_element_size(int section){
+    switch(section){
+        case physic::dim2::SCENE_ID:         return sizeof(int);
+        case physic::dim2::SCENE_IS_STATIC:  return sizeof(unsigned char);
+        case physic::dim2::SCENE_SHAPE:      return sizeof(physic::dim2::collider_shape);
+        default:                             return sizeof(float);
+    }
+}
+
+// =========================================================================|
+//                               map / unmap
+// =========================================================================|
+// Read only mapping of the whole file.
+//
+static bool map_file(const char* path, physic::dim2::scene_file& scene){
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file, &size) || size.QuadPart == 0){
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(mapping == nullptr){
+        CloseHandle(file);
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(data == nullptr){
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    scene.data = static_cast<const unsigned char*>(data);
+    scene.size = (size_t) size.QuadPart;
+    scene.file = file;
+    scene.mapping = mapping;
+#else
+    int file = open(path, O_RDONLY);
+    if(file == -1)
+        return false;
+
+    struct stat info;
+    if(fstat(file, &info) != 0 || info.st_size == 0){
+        close(file);
+        return false;
+    }
+
+    // The mapping outlives the descriptor
+    void* data = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if(data == MAP_FAILED)
+        return false;
+
+    scene.data = static_cast<const unsigned char*>(data);
+    scene.size = (size_t) info.st_size;
+#endif
+
+    return true;
+}
+
+static void unmap_file(physic::dim2::scene_file& scene){
+
+    if(scene.data == nullptr)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(scene.data);
+    CloseHandle((HANDLE) scene.mapping);
+    CloseHandle((HANDLE) scene.file);
+#else
+    munmap(const_cast<unsigned char*>(scene.data), scene.size);
+#endif
+
+    scene = physic::dim2::scene_file{};
+}
+
+// =========================================================================|
+//                                 open_scene
+// =========================================================================|
+// Validate the header and the bounds of every section, then point the
+// columns of the view in the mapping.
+//
+bool physic::dim2::open_scene(const char* path, scene_file& out_scene){
+
+    close_scene(out_scene);
+
+    if(!map_file(path, out_scene))
+        return false;
+
+    scene_header header;
+    bool valid = out_scene.size >= sizeof(header);
+    if(valid){
+        std::memcpy(&header, out_scene.data, sizeof(header));
+        valid = header.magic == scene_magic
+            && header.version == scene_version
+            && header.shape_size == sizeof(collider_shape)
+            && header.body_count >= 0
+            && header.file_size == out_scene.size;
+    }
+
+    for(int section = 0; valid && section < SCENE_SECTIONS; section++){
+        uint64_t offset = header.section_offset[section];
+        uint64_t bytes = (uint64_t) header.body_count * section_element_size(section);
+        valid = offset % scene_section_alignment == 0 && offset >= sizeof(header) && offset + bytes <= out_scene.size;
+    }
+
+    if(!valid){
+        close_scene(out_scene);
+        return false;
+    }
+
+    out_scene.source_hash = header.source_hash;
+
+    auto section_data = [&](int section){ return out_scene.data + header.section_offset[section]; };
+
+    scene_view& view = out_scene.view;
+    view.body_count = header.body_count;
+    view.id         = reinterpret_cast<const int*>(section_data(SCENE_ID));
+    view.is_static  = section_data(SCENE_IS_STATIC);
+    view.pos_x      = reinterpret_cast<const float*>(section_data(SCENE_POS_X));
+    view.pos_y      = reinterpret_cast<const float*>(section_data(SCENE_POS_Y));
+    view.angle      = reinterpret_cast<const float*>(section_data(SCENE_ANGLE));
+    view.vel_x      = reinterpret_cast<const float*>(section_data(SCENE_VEL_X));
+    view.vel_y      = reinterpret_cast<const float*>(section_data(SCENE_VEL_Y));
+    view.w          = reinterpret_cast<const float*>(section_data(SCENE_W));
+    view.m          = reinterpret_cast<const float*>(section_data(SCENE_M));
+    view.I          = reinterpret_cast<const float*>(section_data(SCENE_I));
+    view.shape      = reinterpret_cast<const collider_shape*>(section_data(SCENE_SHAPE));
+
+    return true;
+}
+
+void physic::dim2::close_scene(scene_file& scene){
+    unmap_file(scene);
+}
+
+// =========================================================================|
+//                                write_scene
+// =========================================================================|
+
+bool physic::dim2::write_scene(const char* path, const body_storage& bodies, uint64_t source_hash){
+
+    int count = body_count(bodies);
+
+    const void* columns[SCENE_SECTIONS];
+    columns[SCENE_ID]        = bodies.id.data();
+    columns[SCENE_IS_STATIC] = bodies.is_static.data();
+    columns[SCENE_POS_X]     = bodies.pos_x.data();
+    columns[SCENE_POS_Y]     = bodies.pos_y.data();
+    columns[SCENE_ANGLE]     = bodies.angle.data();
+    columns[SCENE_VEL_X]     = bodies.vel_x.data();
+    columns[SCENE_VEL_Y]     = bodies.vel_y.data();
+    columns[SCENE_W]         = bodies.w.data();
+    columns[SCENE_M]         = bodies.m.data();
+    columns[SCENE_I]         = bodies.I.data();
+    columns[SCENE_SHAPE]     = bodies.shape.data();
+
+    scene_header header = {};
+    header.magic = scene_magic;
+    header.version = scene_version;
+    header.shape_size = sizeof(collider_shape);
+    header.body_count = count;
+    header.source_hash = source_hash;
+
+    uint64_t offset = section_align(sizeof(header));
+    for(int section = 0; section < SCENE_SECTIONS; section++){
+        header.section_offset[section] = offset;
+        offset += section_align(count * section_element_size(section));
+    }
+    header.file_size = offset;
+
+    FILE* file = std::fopen(path, "wb");
+    if(file == nullptr)
+        return false;
+
+    static const unsigned char padding[scene_section_alignment] = {};
+
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1
+        && std::fwrite(padding, 1, section_align(sizeof(header)) - sizeof(header), file) == section_align(sizeof(header)) - sizeof(header);
+
+    for(int section = 0; written && section < SCENE_SECTIONS; section++){
+        size_t bytes = count * section_element_size(section);
+        size_t pad = section_align(bytes) - bytes;
+        written = (bytes == 0 || std::fwrite(columns[section], 1, bytes, file) == bytes)
+            && (pad == 0 || std::fwrite(padding, 1, pad, file) == pad);
+    }
+
+    written &= std::fclose(file) == 0;
+    return written;
+}
+
+// =========================================================================|
+//                                 load_scene
+// =========================================================================|
+
+void physic::dim2::load_scene(world& w, const scene_view& scene){
+
+    body_storage& bodies = w.bodies;
+    int count = scene.body_count;
+
+    clear_bodies(bodies);
+    w.destroy_queue.clear();
+    w.bp.sorted.clear();
+    w.contacts.clear();
+    w.contact_cache.clear();
+
+    // ------------------------------------------------------------------------------------
+    // Persistent columns: bulk copies
+
+    bodies.id.assign(scene.id, scene.id + count);
+    bodies.is_static.assign(scene.is_static, scene.is_static + count);
+    bodies.pos_x.assign(scene.pos_x, scene.pos_x + count);
+    bodies.pos_y.assign(scene.pos_y, scene.pos_y + count);
+    bodies.angle.assign(scene.angle, scene.angle + count);
+    bodies.vel_x.assign(scene.vel_x, scene.vel_x + count);
+    bodies.vel_y.assign(scene.vel_y, scene.vel_y + count);
+    bodies.w.assign(scene.w, scene.w + count);
+    bodies.m.assign(scene.m, scene.m + count);
+    bodies.I.assign(scene.I, scene.I + count);
+    bodies.shape.assign(scene.shape, scene.shape + count);
+
+    // ------------------------------------------------------------------------------------
+    // Derived columns (as add_body and write_body set them)
+
+    bodies.prev_pos_x = bodies.pos_x;
+    bodies.prev_pos_y = bodies.pos_y;
+    bodies.prev_angle = bodies.angle;
+
+    bodies.force_x.assign(count, 0);
+    bodies.force_y.assign(count, 0);
+    bodies.torque.assign(count, 0);
+
+    bodies.inv_mass.resize(count);
+    bodies.inv_inertia.resize(count);
+    for(int row = 0; row < count; row++){
+        bodies.inv_mass[row] = bodies.is_static[row] ? 0 : 1 / bodies.m[row];
+        bodies.inv_inertia[row] = bodies.is_static[row] ? 0 : 1 / bodies.I[row];
+    }
+
+    // ------------------------------------------------------------------------------------
+    // Handles: the free slots first (their generation was bumped by clear_bodies)
+
+    bodies.row_handle.resize(count);
+    for(int row = 0; row < count; row++){
+        int slot;
+        if(!bodies.free_handles.empty()){
+            slot = bodies.free_handles.back();
+            bodies.free_handles.pop_back();
+        }else{
+            slot = (int) bodies.handle_row.size();
+            bodies.handle_row.push_back(-1);
+            bodies.handle_generation.push_back(0);
+        }
+        bodies.handle_row[slot] = row;
+        bodies.row_handle[row] = slot;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                              SCENE TEXT
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static const int scene_text_version = 1;
+
+// FNV-1a of the text; the version of the binary layout is mixed in, a cache of an older layout never matches
+static uint64_t scene_text_hash(const std::string& text){
+
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&](const void* data, size_t size){
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for(size_t i = 0; i < size; i++){
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+
+    uint32_t layout[2] = { physic::dim2::scene_version, (uint32_t) sizeof(physic::dim2::collider_shape) };
+    mix(layout, sizeof(layout));
+    mix(text.data(), text.size());
+    return hash;
+}
+
+static bool read_text_file(const char* path, std::string& out_text){
+
+    FILE* file = std::fopen(path, "rb");
+    if(file == nullptr)
+        return false;
+
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+
+    out_text.resize(size > 0 ? (size_t) size : 0);
+    bool read = size >= 0 && std::fread(&out_text[0], 1, out_text.size(), file) == out_text.size();
+    std::fclose(file);
+    return read;
+}
+
+// =========================================================================|
+//                              parse_scene_text
+// =========================================================================|
+// Line by line: the tokens of a line are split on blanks, a key takes the 
+// following one or two numbers. Every number must be consumed whole.
+//
+static bool scene_text_error(std::string* out_error, int line, const std::string& reason){
+    if(out_error != nullptr)
+        *out_error = "line " + std::to_string(line) + ": " + reason;
+    return false;
+}
+
+static bool parse_float(const std::string& token, float& out_value){
+    char* end;
+    out_value = std::strtof(token.c_str(), &end);
+    return !token.empty() && *end == '\0';
+}
+
+static bool parse_int(const std::string& token, int& out_value){
+    char* end;
+    long value = std::strtol(token.c_str(), &end, 10);
+    out_value = (int) value;
+    return !token.empty() && *end == '\0' && value >= 0 && value <= 0x7fffffff;
+}
+
+bool physic::dim2::parse_scene_text(const char* text, size_t size, body_storage& bodies, std::string* out_error){
+
+    std::unordered_set<int> ids(bodies.id.begin(), bodies.id.end());
+    std::vector<std::string> tokens;
+    bool header_read = false;
+
+    const char* cursor = text;
+    const char* end = text + size;
+
+    for(int line = 1; cursor < end; line++){
+
+        // ------------------------------------------------------------------------------------
+        // Tokens of the line, without the comment
+
+        const char* line_end = std::find(cursor, end, '\n');
+        const char* comment = std::find(cursor, line_end, '#');
+
+        tokens.clear();
+        for(const char* c = cursor; c < comment; ){
+            while(c < comment && std::isspace((unsigned char) *c))
+                c++;
+            const char* token_begin = c;
+            while(c < comment && !std::isspace((unsigned char) *c))
+                c++;
+            if(c > token_begin)
+                tokens.emplace_back(token_begin, c);
+        }
+
+        cursor = line_end < end ? line_end + 1 : end;
+
+        if(tokens.empty())
+            continue;
+
+        if(!header_read){
+            int version;
+            if(tokens.size() != 2 || tokens[0] != "scene" || !parse_int(tokens[1], version))
+                return scene_text_error(out_error, line, "expected \"scene <version>\"");
+            if(version != scene_text_version)
+                return scene_text_error(out_error, line, "unsupported version " + tokens[1]);
+            header_read = true;
+            continue;
+        }
+
+        // ------------------------------------------------------------------------------------
+        // Body: shape keyword, then key value pairs
+
+        collider_box box;
+        box.width = 1;
+        box.height = 1;
+        collider_sphere sphere;
+        sphere.radius = 0.5f;
+        collider_halfspace halfspace;
+        halfspace.normal_x = 0;
+        halfspace.normal_y = 1;
+        halfspace.origin_offset = 0;
+
+        collider* coll;
+        if(tokens[0] == "box")              coll = &box;
+        else if(tokens[0] == "sphere")      coll = &sphere;
+        else if(tokens[0] == "halfspace")   coll = &halfspace;
+        else return scene_text_error(out_error, line, "unknown shape \"" + tokens[0] + "\"");
+
+        bool is_static = coll->type == collider::HALFSPACE;
+
+        rigidbody rb;
+        rb.pos_x = 0;
+        rb.pos_y = 0;
+        rb.vel_x = 0;
+        rb.vel_y = 0;
+
+        int id = -1;
+
+        for(size_t t = 1; t < tokens.size(); ){
+
+            const std::string& key = tokens[t];
+
+            // Key -> the values it sets (nullptr if the shape hasn't it)
+            float* values[2] = { nullptr, nullptr };
+            int arity = 1;
+            bool known = true;
+
+            if(key == "id"){
+                if(t + 1 >= tokens.size() || !parse_int(tokens[t + 1], id))
+                    return scene_text_error(out_error, line, "id must be a non negative integer");
+                t += 2;
+                continue;
+            }
+            else if(key == "pos")           { arity = 2; if(!is_static){ values[0] = &rb.pos_x; values[1] = &rb.pos_y; } }
+            else if(key == "angle")         { if(!is_static) values[0] = &rb.angle; }
+            else if(key == "vel")           { arity = 2; if(!is_static){ values[0] = &rb.vel_x; values[1] = &rb.vel_y; } }
+            else if(key == "w")             { if(!is_static) values[0] = &rb.w; }
+            else if(key == "mass")          { if(!is_static) values[0] = &rb.m; }
+            else if(key == "inertia")       { if(!is_static) values[0] = &rb.I; }
+            else if(key == "friction")      { values[0] = &coll->friction; }
+            else if(key == "restitution")   { values[0] = &coll->restitution; }
+            else if(key == "size")          { arity = 2; if(coll == &box){ values[0] = &box.width; values[1] = &box.height; } }
+            else if(key == "radius")        { if(coll == &sphere) values[0] = &sphere.radius; }
+            else if(key == "normal")        { arity = 2; if(is_static){ values[0] = &halfspace.normal_x; values[1] = &halfspace.normal_y; } }
+            else if(key == "offset")        { if(is_static) values[0] = &halfspace.origin_offset; }
+            else known = false;
+
+            if(!known)
+                return scene_text_error(out_error, line, "unknown key \"" + key + "\"");
+            if(values[0] == nullptr)
+                return scene_text_error(out_error, line, "\"" + key + "\" is not a property of " + tokens[0]);
+            if(t + arity >= tokens.size())
+                return scene_text_error(out_error, line, "\"" + key + "\" needs " + std::to_string(arity) + " values");
+
+            for(int v = 0; v < arity; v++)
+                if(!parse_float(tokens[t + 1 + v], *values[v]))
+                    return scene_text_error(out_error, line, "\"" + tokens[t + 1 + v] + "\" is not a number");
+
+            t += 1 + arity;
+        }
+
+        if(id == -1)
+            return scene_text_error(out_error, line, "missing id");
+        if(!ids.insert(id).second)
+            return scene_text_error(out_error, line, "duplicate id " + std::to_string(id));
+        if(!is_static && (rb.m <= 0 || rb.I <= 0))
+            return scene_text_error(out_error, line, "mass and inertia must be positive");
+
+        rb.prev_pos_x = rb.pos_x;
+        rb.prev_pos_y = rb.pos_y;
+        rb.prev_angle = rb.angle;
+
+        add_body(bodies, id, is_static ? nullptr : &rb, *coll);
+    }
+
+    if(!header_read)
+        return scene_text_error(out_error, 1, "empty scene");
+
+    return true;
+}
+
+// =========================================================================|
+//                              write_scene_text
+// =========================================================================|
+
+// Shortest of %.6g ... %.9g that parses back to the same float (9 digits always do)
+struct scene_text_float{
+    char text[32];
+};
+
+static scene_text_float format_float(float value){
+
+    scene_text_float out;
+    for(int precision = 6; precision <= 9; precision++){
+        std::snprintf(out.text, sizeof(out.text), "%.*g", precision, value);
+        if(std::strtof(out.text, nullptr) == value || value != value)
+            break;
+    }
+    return out;
+}
+
+bool physic::dim2::write_scene_text(const char* path, const body_storage& bodies){
+
+    FILE* file = std::fopen(path, "w");
+    if(file == nullptr)
+        return false;
+
+    auto f = [](float value){ return format_float(value); };
+
+    std::fprintf(file, "scene %d\n", scene_text_version);
+
+    for(int row = 0; row < body_count(bodies); row++){
+
+        const collider_shape& shape = bodies.shape[row];
+        const collider& coll = shape_collider(shape);
+
+        if(shape.type == collider::HALFSPACE){
+            std::fprintf(file, "halfspace id %d  normal %s %s  offset %s", bodies.id[row], 
+                f(shape.halfspace.normal_x).text, f(shape.halfspace.normal_y).text, f(shape.halfspace.origin_offset).text);
+        }else{
+            std::fprintf(file, "%s id %d  pos %s %s  angle %s  vel %s %s  w %s  mass %s  inertia %s",
+                shape.type == collider::BOX ? "box" : "sphere", bodies.id[row],
+                f(bodies.pos_x[row]).text, f(bodies.pos_y[row]).text, f(bodies.angle[row]).text,
+                f(bodies.vel_x[row]).text, f(bodies.vel_y[row]).text, f(bodies.w[row]).text,
+                f(bodies.m[row]).text, f(bodies.I[row]).text);
+
+            if(shape.type == collider::BOX)
+                std::fprintf(file, "  size %s %s", f(shape.box.width).text, f(shape.box.height).text);
+            else
+                std::fprintf(file, "  radius %s", f(shape.sphere.radius).text);
+        }
+
+        std::fprintf(file, "  friction %s  restitution %s\n", f(coll.friction).text, f(coll.restitution).text);
+    }
+
+    return std::fclose(file) == 0;
+}
+
+// =========================================================================|
+//                              open_scene_text
+// =========================================================================|
+// Hash the text; map the cache if it was compiled from the same text,
+// otherwise parse, write the cache and map it.
+//
+bool physic::dim2::open_scene_text(const char* path, scene_file& out_scene, std::string* out_error){
+
+    close_scene(out_scene);
+
+    std::string text;
+    if(!read_text_file(path, text)){
+        if(out_error != nullptr)
+            *out_error = std::string("can't read ") + path;
+        return false;
+    }
+
+    uint64_t hash = scene_text_hash(text);
+    std::string cache_path = std::string(path) + ".bin";
+
+    if(open_scene(cache_path.c_str(), out_scene)){
+        if(out_scene.source_hash == hash)
+            return true;
+        close_scene(out_scene);
+    }
+
+    body_storage bodies;
+    if(!parse_scene_text(text.data(), text.size(), bodies, out_error))
+        return false;
+
+    if(!write_scene(cache_path.c_str(), bodies, hash) || !open_scene(cache_path.c_str(), out_scene)){
+        if(out_error != nullptr)
+            *out_error = "can't write the cache " + cache_path;
+        return false;
+    }
+
+    return true;
+}
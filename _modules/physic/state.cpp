@@ -0,0 +1,406 @@
+#include "physic.h"
+#include <cassert>
+#include <algorithm>
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                          WORLD STATE SNAPSHOT
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Increase it every time visit_world changes: an old blob is refused instead of misread
+static const uint32_t world_state_magic = 0x57535431;          // "WST1"
+static const uint32_t world_state_version = 4;
+
+struct world_state_header{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;                                              // bytes of the whole blob
+};
+
+// =========================================================================|
+//                                visit_world
+// =========================================================================|
+// The list of the fields of the state, walked by every archive in the same
+// order. World is "const world" when saving.
+//
+template<typename pool_type, typename Archive>
+static void visit_joint_handles(Archive& ar, pool_type& pool){
+    ar.column(pool.body_a);
+    ar.column(pool.body_b);
+    ar.column(pool.ms_qa_x);
+    ar.column(pool.ms_qa_y);
+    ar.column(pool.ms_qb_x);
+    ar.column(pool.ms_qb_y);
+    ar.column(pool.row_a);
+    ar.column(pool.row_b);
+    ar.column(pool.ws_ra_x);
+    ar.column(pool.ws_ra_y);
+    ar.column(pool.ws_rb_x);
+    ar.column(pool.ws_rb_y);
+}
+
+template<typename Archive, typename World>
+static void visit_world(Archive& ar, World& w){
+
+    using namespace physic::dim2;
+
+    // ------------------------------------------------------------------------------------
+    // Configuration and counters
+
+    ar.value(w.mode);
+    ar.value(w.xpbd_substeps);
+    ar.value(w.xpbd_contact_compliance);
+    ar.value(w.velocity_iterations);
+    ar.value(w.warm_starting);
+    ar.value(w.warm_start_distance);
+    ar.value(w.restitution_velocity_threshold);
+    ar.value(w.joint_baumgarte);
+    ar.value(w.joint_position_iterations);
+    ar.value(w.deterministic);
+    ar.value(w.fixed_delta_time);
+    ar.value(w.step_count);
+    ar.value(w.checksum);
+    ar.value(w.gravity_x);
+    ar.value(w.gravity_y);
+    ar.column(w.force_generators);
+
+    // ------------------------------------------------------------------------------------
+    // Bodies
+
+    auto& bodies = w.bodies;
+    ar.column(bodies.id);
+    ar.column(bodies.is_static);
+    ar.column(bodies.pos_x);
+    ar.column(bodies.pos_y);
+    ar.column(bodies.angle);
+    ar.column(bodies.vel_x);
+    ar.column(bodies.vel_y);
+    ar.column(bodies.w);
+    ar.column(bodies.m);
+    ar.column(bodies.I);
+    ar.column(bodies.inv_mass);
+    ar.column(bodies.inv_inertia);
+    ar.column(bodies.prev_pos_x);
+    ar.column(bodies.prev_pos_y);
+    ar.column(bodies.prev_angle);
+    ar.column(bodies.force_x);
+    ar.column(bodies.force_y);
+    ar.column(bodies.torque);
+    ar.column(bodies.shape);
+
+    ar.column(bodies.handle_row);
+    ar.column(bodies.handle_generation);
+    ar.column(bodies.free_handles);
+    ar.column(bodies.row_handle);
+
+    ar.column(w.destroy_queue);
+
+    // ------------------------------------------------------------------------------------
+    // Broad phase proxies and contacts of the last step
+
+    ar.column(w.bp.boxes);
+    ar.column(w.bp.sorted);
+    ar.column(w.bp.halfspaces);
+    ar.value(w.bp.max_width);
+
+    ar.column(w.contacts);
+    ar.column(w.contact_cache);
+
+    // ------------------------------------------------------------------------------------
+    // Joints
+
+    auto& distance_joints = w.distance_joints;
+    visit_joint_handles(ar, distance_joints);
+    ar.column(distance_joints.rest_length);
+    ar.column(distance_joints.ws_n_x);
+    ar.column(distance_joints.ws_n_y);
+    ar.column(distance_joints.mass);
+    ar.column(distance_joints.bias);
+    ar.column(distance_joints.impulse);
+
+    auto& revolute_joints = w.revolute_joints;
+    visit_joint_handles(ar, revolute_joints);
+    ar.column(revolute_joints.inv_k11);
+    ar.column(revolute_joints.inv_k12);
+    ar.column(revolute_joints.inv_k22);
+    ar.column(revolute_joints.bias_x);
+    ar.column(revolute_joints.bias_y);
+    ar.column(revolute_joints.impulse_x);
+    ar.column(revolute_joints.impulse_y);
+
+    auto& weld_joints = w.weld_joints;
+    visit_joint_handles(ar, weld_joints);
+    ar.column(weld_joints.reference_angle);
+    ar.column(weld_joints.inv_k11);
+    ar.column(weld_joints.inv_k12);
+    ar.column(weld_joints.inv_k13);
+    ar.column(weld_joints.inv_k22);
+    ar.column(weld_joints.inv_k23);
+    ar.column(weld_joints.inv_k33);
+    ar.column(weld_joints.bias_x);
+    ar.column(weld_joints.bias_y);
+    ar.column(weld_joints.angular_bias);
+    ar.column(weld_joints.impulse_x);
+    ar.column(weld_joints.impulse_y);
+    ar.column(weld_joints.angular_impulse);
+}
+
+// =========================================================================|
+//                             save_world_state
+// =========================================================================|
+// Two passes: size the blob (grown only if the world grew), then copy.
+//
+void physic::dim2::save_world_state(const world& w, world_state& out_state){
+
+    world_state_header header;
+    header.magic = world_state_magic;
+    header.version = world_state_version;
+
+    blob_sizer sizer;
+    sizer.value(header);
+    visit_world(sizer, w);
+    header.size = sizer.size;
+
+    if(out_state.blob.size() * blob_alignment < sizer.size)
+        out_state.blob.resize(sizer.size / blob_alignment);
+    out_state.size = sizer.size;
+
+    blob_writer writer;
+    writer.cursor = reinterpret_cast<unsigned char*>(out_state.blob.data());
+    writer.value(header);
+    visit_world(writer, w);
+}
+
+// =========================================================================|
+//                            restore_world_state
+// =========================================================================|
+
+bool physic::dim2::restore_world_state(world& w, const world_state& state){
+
+    if(state.size < sizeof(world_state_header))
+        return false;
+
+    blob_reader reader;
+    reader.cursor = reinterpret_cast<const unsigned char*>(state.blob.data());
+    reader.end = reader.cursor + state.size;
+
+    world_state_header header;
+    reader.value(header);
+    if(header.magic != world_state_magic || header.version != world_state_version || header.size != state.size)
+        return false;
+
+    visit_world(reader, w);
+    assert(reader.cursor == reader.end);
+
+    return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                             REWIND BUFFER
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+static physic::dim2::rewind_frame& frame_slot(physic::dim2::rewind_buffer& buffer, int frame){
+    return buffer.frames[(buffer.first + frame) % buffer.capacity];
+}
+
+static const physic::dim2::rewind_frame& frame_slot(const physic::dim2::rewind_buffer& buffer, int frame){
+    return buffer.frames[(buffer.first + frame) % buffer.capacity];
+}
+
+static unsigned char* state_bytes(physic::dim2::world_state& state){
+    return reinterpret_cast<unsigned char*>(state.blob.data());
+}
+
+static const unsigned char* state_bytes(const physic::dim2::world_state& state){
+    return reinterpret_cast<const unsigned char*>(state.blob.data());
+}
+
+// =========================================================================|
+//                            encode / decode delta
+// =========================================================================|
+// The delta is a sequence of runs: 
+//
+//      [uint32 equal bytes][uint32 changed bytes][changed bytes of current ^ previous]
+//
+// A changed run ends only at 8 equal bytes in a row (shorter equal runs 
+// cost less as changed bytes than as a new run header); the worst case 
+// is then the size of the state plus 8 bytes.
+// The states can have different sizes (the contacts change every step):
+// past its end the previous state reads as zeros.
+//
+static const size_t min_equal_run = 8;
+
+static void encode_delta(const unsigned char* current, size_t size, const unsigned char* previous, size_t previous_size, std::vector<unsigned char>& out){
+
+    out.resize(2 * size + 16);
+    unsigned char* cursor = out.data();
+
+    auto previous_byte = [&](size_t b) -> unsigned char { return b < previous_size ? previous[b] : 0; };
+
+    size_t i = 0;
+    while(i < size){
+
+        size_t equal_end = i;
+        while(equal_end < size && current[equal_end] == previous_byte(equal_end))
+            equal_end++;
+
+        size_t changed_end = equal_end;
+        size_t equal_run = 0;
+        while(changed_end + equal_run < size && equal_run < min_equal_run){
+            if(current[changed_end + equal_run] == previous_byte(changed_end + equal_run)){
+                equal_run++;
+            }else{
+                changed_end += equal_run + 1;
+                equal_run = 0;
+            }
+        }
+
+        uint32_t run[2] = { (uint32_t) (equal_end - i), (uint32_t) (changed_end - equal_end) };
+        std::memcpy(cursor, run, sizeof(run));
+        cursor += sizeof(run);
+
+        for(size_t b = equal_end; b < changed_end; b++)
+            *cursor++ = current[b] ^ previous_byte(b);
+
+        i = changed_end;
+    }
+
+    out.resize(cursor - out.data());
+}
+
+// XOR the delta on the previous state, in place. The state grows to the
+// size of the frame, the new bytes start from zero
+static void decode_delta(const physic::dim2::rewind_frame& frame, physic::dim2::world_state& state){
+
+    using namespace physic::dim2;
+
+    size_t blocks = blob_align(frame.state_size) / blob_alignment;
+    if(state.blob.size() < blocks)
+        state.blob.resize(blocks);
+    if(frame.state_size > state.size)
+        std::memset(state_bytes(state) + state.size, 0, frame.state_size - state.size);
+    state.size = frame.state_size;
+
+    const unsigned char* cursor = frame.data.data();
+    const unsigned char* end = cursor + frame.data.size();
+    unsigned char* bytes = state_bytes(state);
+
+    size_t i = 0;
+    while(cursor < end){
+        uint32_t run[2];
+        std::memcpy(run, cursor, sizeof(run));
+        cursor += sizeof(run);
+
+        i += run[0];
+        for(uint32_t b = 0; b < run[1]; b++)
+            bytes[i++] ^= *cursor++;
+    }
+}
+
+// =========================================================================|
+//                             record_world_state
+// =========================================================================|
+
+void physic::dim2::record_world_state(rewind_buffer& buffer, const world& w){
+
+    if(buffer.frames.size() != buffer.capacity){
+        buffer.frames.resize(buffer.capacity);
+        clear_rewind(buffer);
+    }
+
+    // After a seek the history continues from the sought frame
+    buffer.count = buffer.cursor + 1;
+
+    // Full: drop the oldest keyframe group
+    if(buffer.count == buffer.capacity){
+        do{
+            buffer.first = (buffer.first + 1) % buffer.capacity;
+            buffer.count--;
+        }while(buffer.count > 0 && !frame_slot(buffer, 0).keyframe);
+    }
+
+    save_world_state(w, buffer.scratch);
+
+    int since_keyframe = 0;
+    while(since_keyframe < buffer.count && !frame_slot(buffer, buffer.count - 1 - since_keyframe).keyframe)
+        since_keyframe++;
+
+    bool keyframe = buffer.count == 0 || since_keyframe + 1 >= buffer.keyframe_interval;
+
+    rewind_frame& frame = frame_slot(buffer, buffer.count);
+    frame.state_size = buffer.scratch.size;
+    frame.step_count = w.step_count;
+    frame.keyframe = keyframe;
+
+    const unsigned char* current = state_bytes(buffer.scratch);
+    if(keyframe)
+        frame.data.assign(current, current + buffer.scratch.size);
+    else{
+        encode_delta(current, buffer.scratch.size, state_bytes(buffer.last_state), buffer.last_state.size, buffer.delta);
+        frame.data.assign(buffer.delta.begin(), buffer.delta.end());
+
+        // A slot reused from a keyframe would keep the memory of a whole state
+        if(frame.data.capacity() > 2 * frame.data.size())
+            frame.data.shrink_to_fit();
+    }
+
+    std::swap(buffer.last_state, buffer.scratch);
+    buffer.cursor = buffer.count;
+    buffer.count++;
+}
+
+// =========================================================================|
+//                               rebuild_frame
+// =========================================================================|
+
+bool physic::dim2::rebuild_frame(const rewind_buffer& buffer, int frame, world_state& out_state){
+
+    if(frame < 0 || frame >= buffer.count)
+        return false;
+
+    if(frame == buffer.cursor){
+        out_state.blob.resize(std::max(out_state.blob.size(), buffer.last_state.blob.size()));
+        std::memcpy(state_bytes(out_state), state_bytes(buffer.last_state), buffer.last_state.size);
+        out_state.size = buffer.last_state.size;
+        return true;
+    }
+
+    int keyframe = frame;
+    while(!frame_slot(buffer, keyframe).keyframe)
+        keyframe--;
+
+    const rewind_frame& key = frame_slot(buffer, keyframe);
+    size_t blocks = blob_align(key.state_size) / blob_alignment;
+    out_state.blob.resize(std::max(out_state.blob.size(), blocks));
+    std::memcpy(state_bytes(out_state), key.data.data(), key.state_size);
+    out_state.size = key.state_size;
+
+    for(int f = keyframe + 1; f <= frame; f++)
+        decode_delta(frame_slot(buffer, f), out_state);
+
+    return true;
+}
+
+bool physic::dim2::seek_frame(rewind_buffer& buffer, int frame, world& w){
+
+    if(!rebuild_frame(buffer, frame, buffer.scratch) || !restore_world_state(w, buffer.scratch))
+        return false;
+
+    std::swap(buffer.last_state, buffer.scratch);
+    buffer.cursor = frame;
+    return true;
+}
+
+void physic::dim2::clear_rewind(rewind_buffer& buffer){
+    buffer.first = 0;
+    buffer.count = 0;
+    buffer.cursor = -1;
+}
+
+size_t physic::dim2::rewind_memory(const rewind_buffer& buffer){
+
+    size_t bytes = (buffer.last_state.blob.capacity() + buffer.scratch.blob.capacity()) * blob_alignment + buffer.delta.capacity();
+    for( auto& frame : buffer.frames )
+        bytes += frame.data.capacity();
+    return bytes;
+}
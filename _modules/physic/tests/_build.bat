@@ -3,10 +3,34 @@ if not exist "binaries/" mkdir binaries
 cl /c /Fo"binaries/" ^
 /I "..\includes" ^
 /I "..\..\opengl-libs\includes" ^
+/I "..\..\jobs\includes" ^
 ..\physic.cpp ^
+..\joints.cpp ^
+..\world.cpp ^
+..\integrator.cpp ^
+..\broadphase.cpp ^
+..\parallel.cpp ^
+..\arena.cpp ^
+..\state.cpp ^
+..\scene.cpp ^
+..\batch.cpp ^
+..\..\jobs\jobs.cpp ^
 main.cpp
 
 cl /Fe: _main.exe ^
 binaries\physic.obj ^
+binaries\joints.obj ^
+binaries\world.obj ^
+binaries\integrator.obj ^
+binaries\broadphase.obj ^
+binaries\parallel.obj ^
+binaries\arena.obj ^
+binaries\state.obj ^
+binaries\scene.obj ^
+binaries\batch.obj ^
+binaries\jobs.obj ^
 binaries\main.obj
 
+
+_main.exe
+if errorlevel 1 exit /b 1
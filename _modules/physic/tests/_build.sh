@@ -0,0 +1,11 @@
+#!/bin/sh
+# Test runner for Linux / macOS: builds the physic tests and runs them, failing on any failed check.
+# Usage: ./_build.sh [compiler]   (default c++)
+set -e
+cd "$(dirname "$0")"
+CXX="${1:-c++}"
+"$CXX" -std=c++14 -O2 -pthread \
+    -I ../includes -I ../../opengl-libs/includes -I ../../jobs/includes \
+    ../physic.cpp ../joints.cpp ../world.cpp ../integrator.cpp ../broadphase.cpp ../parallel.cpp ../arena.cpp ../state.cpp ../scene.cpp ../batch.cpp ../../jobs/jobs.cpp \
+    main.cpp -o _main
+./_main
@@ -1,13 +1,524 @@
 #include<vector>
 #include<utility>
 #include<iostream>
+#include<cmath>
+#include<algorithm>
+#include<memory>
 
 #include "physic.h"
+#include "../benchmarks/bench_random.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                            PHYSIC MODULE TESTS
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Every test builds a small world, steps it and checks the result against the expected values within
+// a tolerance. A failed check prints its name and the values; the exit code is the number of failed
+// checks, so the build scripts stop on a mismatch.
+//
+
+static int failed_checks = 0;
+
+static void check(bool condition, const char* name){
+    if(!condition){
+        std::cout << "FAIL " << name << std::endl;
+        failed_checks++;
+    }
+}
+
+static void check_near(float value, float expected, float tolerance, const char* name){
+    if(!(std::fabs(value - expected) <= tolerance)){
+        std::cout << "FAIL " << name << ": " << value << " expected " << expected << " +- " << tolerance << std::endl;
+        failed_checks++;
+    }
+}
+
+// ====================================================================================
+// Scene helpers
+
+static physic::dim2::body_handle add_floor(physic::dim2::world& w, int id){
+    physic::dim2::collider_halfspace floor;
+    floor.normal_x = 0;
+    floor.normal_y = 1;
+    floor.origin_offset = 0;
+    return physic::dim2::add_body(w.bodies, id, nullptr, floor);
+}
+
+static physic::dim2::rigidbody make_body(float pos_x, float pos_y){
+    physic::dim2::rigidbody rb;
+    rb.pos_x = pos_x;
+    rb.pos_y = pos_y;
+    rb.vel_x = 0;
+    rb.vel_y = 0;
+    return rb;
+}
+
+static physic::dim2::body_handle add_box(physic::dim2::world& w, int id, float pos_x, float pos_y, float width, float height){
+    physic::dim2::rigidbody rb = make_body(pos_x, pos_y);
+    physic::dim2::collider_box box;
+    box.width = width;
+    box.height = height;
+    return physic::dim2::add_body(w.bodies, id, &rb, box);
+}
+
+// A 1 x 0.2 plank with the inertia of a solid box, the link of the joint tests
+static physic::dim2::body_handle add_plank(physic::dim2::world& w, int id, float pos_x, float pos_y){
+    physic::dim2::rigidbody rb = make_body(pos_x, pos_y);
+    rb.I = rb.m * (1 * 1 + 0.2f * 0.2f) / 12;
+    physic::dim2::collider_box box;
+    box.width = 1;
+    box.height = 0.2f;
+    return physic::dim2::add_body(w.bodies, id, &rb, box);
+}
+
+// World space position of the model space point q of a body
+static void world_point(const physic::dim2::world& w, physic::dim2::body_handle body, float q_x, float q_y, float& out_x, float& out_y){
+    int row = physic::dim2::body_row(w.bodies, body);
+    float c = std::cos(w.bodies.angle[row]);
+    float s = std::sin(w.bodies.angle[row]);
+    out_x = w.bodies.pos_x[row] + c * q_x - s * q_y;
+    out_y = w.bodies.pos_y[row] + s * q_x + c * q_y;
+}
+
+static void step_world(physic::dim2::world& w, int steps){
+    for(int i = 0; i < steps; i++)
+        physic::dim2::step(w, w.fixed_delta_time);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                  TESTS
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// ====================================================================================
+// A unit box sunk 0.1 in the floor touches it with both the vertices of its lower face
+
+static void test_box_floor_contacts(){
+
+    physic::dim2::world world;
+    add_floor(world, 0);
+    add_box(world, 1, 0, 0.4f, 1, 1);
+
+    physic::dim2::contact_detection_dispatcher(world);
+
+    check(world.contacts.size() == 2, "box-floor: contact count");
+    for(const physic::dim2::contact_data& contact : world.contacts){
+        check_near(contact.pen, 0.1f, 1e-5f, "box-floor: penetration");
+        check_near(contact.ws_n_y, 1, 1e-6f, "box-floor: normal");
+        check_near(contact.ms_qa_y, -0.5f, 1e-6f, "box-floor: contact on the lower face");
+    }
+}
+
+// ====================================================================================
+// A sphere thrown sliding on the floor rolls without slipping (v = - w * r) and without bouncing:
+// the lever arm of its contact must stay under the center while it spins. 
+// A disc ends rolling at 2/3 of the initial velocity.
+
+static void test_sphere_rolling(physic::dim2::world::solver_mode mode){
+
+    physic::dim2::world world;
+    world.mode = mode;
+
+    physic::dim2::collider_halfspace floor;
+    floor.normal_x = 0;
+    floor.normal_y = 1;
+    floor.origin_offset = 0;
+    floor.restitution = 0;
+    physic::dim2::add_body(world.bodies, 0, nullptr, floor);
+
+    physic::dim2::rigidbody rb = make_body(0, 0.5f);
+    rb.vel_x = 3;
+    rb.I = rb.m * 0.5f * 0.5f / 2;
+    physic::dim2::collider_sphere coll;
+    coll.radius = 0.5f;
+    coll.restitution = 0;
+    physic::dim2::body_handle sphere = physic::dim2::add_body(world.bodies, 1, &rb, coll);
+
+    step_world(world, 120);
+
+    int row = physic::dim2::body_row(world.bodies, sphere);
+    check_near(world.bodies.vel_x[row] + world.bodies.w[row] * 0.5f, 0, 1e-3f, "sphere rolling: v = - w * r");
+    check_near(world.bodies.vel_x[row], 2, 1e-2f, "sphere rolling: final velocity");
+    check_near(world.bodies.vel_y[row], 0, 1e-3f, "sphere rolling: no bounce");
+    check_near(world.bodies.pos_y[row], 0.5f, 1e-2f, "sphere rolling: on the floor");
+}
+
+// ====================================================================================
+// A box sunk 0.05 in another one, shifted sideways, touches it with the two ends of the
+// overlapping edge; the normal goes from B to A
+
+static void test_box_box_contacts(){
+
+    physic::dim2::world world;
+    add_box(world, 1, 0, 0.5f, 1, 1);
+    add_box(world, 2, 0.2f, 1.45f, 1, 1);
+
+    physic::dim2::contact_detection_dispatcher(world);
+
+    check(world.contacts.size() == 2, "box-box: contact count");
+    for(const physic::dim2::contact_data& contact : world.contacts){
+        int a = contact.body_a;
+        int b = contact.body_b;
+        float direction = (world.bodies.pos_x[a] - world.bodies.pos_x[b]) * contact.ws_n_x + (world.bodies.pos_y[a] - world.bodies.pos_y[b]) * contact.ws_n_y;
+        check_near(contact.pen, 0.05f, 1e-5f, "box-box: penetration");
+        check_near(std::fabs(contact.ws_n_y), 1, 1e-6f, "box-box: normal");
+        check(direction > 0, "box-box: normal from B to A");
+    }
+}
+
+// ====================================================================================
+// The stack of the default scene: three unit boxes, the middle one shifted sideways. It 
+// must come to rest, standing.
+
+static void test_box_stack_rest(){
+
+    physic::dim2::world world;
+    add_floor(world, 0);
+
+    physic::dim2::body_handle boxes[3] = {
+        add_box(world, 1, 0, 0.5f, 1, 1),
+        add_box(world, 2, 0.2f, 1.51f, 1, 1),
+        add_box(world, 3, 0, 2.52f, 1, 1)
+    };
+
+    step_world(world, 300);
+
+    float max_velocity = 0;
+    float max_angular_velocity = 0;
+    for(physic::dim2::body_handle box : boxes){
+        int row = physic::dim2::body_row(world.bodies, box);
+        max_velocity = std::max(max_velocity, std::sqrt(world.bodies.vel_x[row] * world.bodies.vel_x[row] + world.bodies.vel_y[row] * world.bodies.vel_y[row]));
+        max_angular_velocity = std::max(max_angular_velocity, std::fabs(world.bodies.w[row]));
+    }
+
+    int top = physic::dim2::body_row(world.bodies, boxes[2]);
+    check_near(max_velocity, 0, 1e-3f, "box stack: |v| at rest");
+    check_near(max_angular_velocity, 0, 1e-3f, "box stack: |w| at rest");
+    check_near(world.bodies.pos_x[top], 0, 0.05f, "box stack: top box x");
+    check_near(world.bodies.pos_y[top], 2.5f, 0.05f, "box stack: top box y");
+    check_near(world.bodies.angle[top], 0, 0.01f, "box stack: top box angle");
+}
+
+// ====================================================================================
+// A pendulum on a distance joint of length 2, released horizontal: the rope must not 
+// stretch while it swings
+
+static void test_pendulum_length(physic::dim2::world::solver_mode mode){
+
+    physic::dim2::world world;
+    world.mode = mode;
+
+    physic::dim2::body_handle bob = add_box(world, 1, 2, 5, 0.2f, 0.2f);
+    physic::dim2::add_distance_joint(world, bob, physic::dim2::null_body, 0, 0, 0, 5, 2);
+
+    float max_error = 0;
+    for(int i = 0; i < 600; i++){
+        step_world(world, 1);
+        float x, y;
+        world_point(world, bob, 0, 0, x, y);
+        max_error = std::max(max_error, std::fabs(std::sqrt(x * x + (y - 5) * (y - 5)) - 2));
+    }
+
+    check_near(max_error, 0, 5e-3f, "pendulum: rope length");
+}
+
+// ====================================================================================
+// A chain of 5 planks on revolute joints, hanging from the world and released horizontal: 
+// the anchors of every joint must stay together
+
+static void test_revolute_chain(physic::dim2::world::solver_mode mode){
+
+    physic::dim2::world world;
+    world.mode = mode;
+
+    physic::dim2::body_handle links[5];
+    for(int i = 0; i < 5; i++)
+        links[i] = add_plank(world, 1 + i, 0.5f + i, 5);
+
+    physic::dim2::add_revolute_joint(world, links[0], physic::dim2::null_body, -0.5f, 0, 0, 5);
+    for(int i = 1; i < 5; i++)
+        physic::dim2::add_revolute_joint(world, links[i], links[i - 1], -0.5f, 0, 0.5f, 0);
+
+    float max_gap = 0;
+    for(int step = 0; step < 600; step++){
+        step_world(world, 1);
+
+        float a_x, a_y, b_x, b_y;
+        world_point(world, links[0], -0.5f, 0, a_x, a_y);
+        max_gap = std::max(max_gap, std::sqrt(a_x * a_x + (a_y - 5) * (a_y - 5)));
+        for(int i = 1; i < 5; i++){
+            world_point(world, links[i], -0.5f, 0, a_x, a_y);
+            world_point(world, links[i - 1], 0.5f, 0, b_x, b_y);
+            max_gap = std::max(max_gap, std::sqrt((a_x - b_x) * (a_x - b_x) + (a_y - b_y) * (a_y - b_y)));
+        }
+    }
+
+    check_near(max_gap, 0, 0.02f, "revolute chain: anchor gap");
+}
+
+// ====================================================================================
+// A cantilever of 3 planks welded in a row to the world: it must hold under gravity, 
+// bending only a little, and come to rest
+
+static void test_weld_cantilever(physic::dim2::world::solver_mode mode){
+
+    physic::dim2::world world;
+    world.mode = mode;
+
+    physic::dim2::body_handle links[3];
+    for(int i = 0; i < 3; i++)
+        links[i] = add_plank(world, 1 + i, 0.5f + i, 5);
+
+    physic::dim2::add_weld_joint(world, links[0], physic::dim2::null_body, -0.5f, 0, 0, 5);
+    for(int i = 1; i < 3; i++)
+        physic::dim2::add_weld_joint(world, links[i], links[i - 1], -0.5f, 0, 0.5f, 0);
+
+    float max_angle = 0;
+    float max_drop = 0;
+    for(int step = 0; step < 600; step++){
+        step_world(world, 1);
+        for(physic::dim2::body_handle link : links)
+            max_angle = std::max(max_angle, std::fabs(world.bodies.angle[physic::dim2::body_row(world.bodies, link)]));
+        float tip_x, tip_y;
+        world_point(world, links[2], 0.5f, 0, tip_x, tip_y);
+        max_drop = std::max(max_drop, std::fabs(tip_y - 5));
+    }
+
+    int tip = physic::dim2::body_row(world.bodies, links[2]);
+    check_near(max_angle, 0, 0.05f, "weld cantilever: link angle");
+    check_near(max_drop, 0, 0.1f, "weld cantilever: tip drop");
+    check_near(world.bodies.w[tip], 0, 1e-2f, "weld cantilever: at rest");
+}
+
+// ====================================================================================
+// A bounded uniform generator pushes up only the bodies whose AABB overlaps its region: 
+// a row of spheres without gravity, the first three inside the region
+
+static void test_bounded_force_generator(){
+
+    physic::dim2::world world;
+    world.gravity_x = 0;
+    world.gravity_y = 0;
+
+    physic::dim2::body_handle spheres[6];
+    for(int i = 0; i < 6; i++){
+        physic::dim2::rigidbody rb = make_body((float) i, 0);
+        physic::dim2::collider_sphere coll;
+        coll.radius = 0.25f;
+        spheres[i] = physic::dim2::add_body(world.bodies, 1 + i, &rb, coll);
+    }
+
+    physic::dim2::force_generator gen;
+    gen.type = physic::dim2::force_generator::UNIFORM;
+    gen.accel_y = 10;
+    gen.bounded = true;
+    gen.region = { -0.5f, -1, 2.5f, 1 };
+    world.force_generators.push_back(gen);
+
+    step_world(world, 1);
+
+    for(int i = 0; i < 6; i++){
+        int row = physic::dim2::body_row(world.bodies, spheres[i]);
+        float expected = i < 3 ? 10 * world.fixed_delta_time : 0;
+        check_near(world.bodies.vel_y[row], expected, 1e-5f, "bounded generator: velocity");
+        check_near(world.bodies.vel_x[row], 0, 1e-6f, "bounded generator: direction");
+    }
+}
+
+// ====================================================================================
+// The sort and sweep pairs of a random scene (rotated boxes, spheres and two halfspaces) 
+// are the pairs of the brute force AABB test
+
+static void test_broadphase_pairs(){
+
+    physic::dim2::world world;
+    add_floor(world, 0);
+
+    physic::dim2::collider_halfspace wall;
+    wall.normal_x = 0.8f;
+    wall.normal_y = 0.6f;
+    wall.origin_offset = -8;
+    physic::dim2::add_body(world.bodies, 1, nullptr, wall);
+
+    random_seed(1234);
+    for(int i = 0; i < 200; i++){
+        physic::dim2::rigidbody rb = make_body(random_range(-20, 20), random_range(-2, 20));
+        rb.angle = random_range(-3.14f, 3.14f);
+        if(i % 2 == 0){
+            physic::dim2::collider_box box;
+            box.width = random_range(0.2f, 2);
+            box.height = random_range(0.2f, 2);
+            physic::dim2::add_body(world.bodies, 2 + i, &rb, box);
+        }else{
+            physic::dim2::collider_sphere sphere;
+            sphere.radius = random_range(0.1f, 1);
+            physic::dim2::add_body(world.bodies, 2 + i, &rb, sphere);
+        }
+    }
+
+    const physic::dim2::body_storage& bodies = world.bodies;
+    physic::dim2::build_broadphase(world.bp, bodies);
+    physic::dim2::broadphase_pairs(world.bp, bodies, world.pairs);
+    std::vector<std::pair<int, int>> sweep(world.pairs.begin(), world.pairs.end());
+
+    // Brute force: every pair but the static-static ones; a halfspace is tested against the AABB of the other body
+    std::vector<std::pair<int, int>> brute;
+    int count = physic::dim2::body_count(bodies);
+    for(int i = 0; i < count; i++){
+        for(int j = i + 1; j < count; j++){
+            if(bodies.is_static[i] && bodies.is_static[j])
+                continue;
+
+            const physic::dim2::collider& coll_i = physic::dim2::shape_collider(bodies.shape[i]);
+            const physic::dim2::collider& coll_j = physic::dim2::shape_collider(bodies.shape[j]);
+            physic::dim2::aabb box_i = physic::dim2::compute_aabb(bodies.pos_x[i], bodies.pos_y[i], bodies.angle[i], coll_i);
+            physic::dim2::aabb box_j = physic::dim2::compute_aabb(bodies.pos_x[j], bodies.pos_y[j], bodies.angle[j], coll_j);
+
+            bool overlap;
+            if(coll_i.type == physic::dim2::collider::HALFSPACE || coll_j.type == physic::dim2::collider::HALFSPACE){
+                const physic::dim2::collider_halfspace& plane = (const physic::dim2::collider_halfspace&) (coll_i.type == physic::dim2::collider::HALFSPACE ? coll_i : coll_j);
+                const physic::dim2::aabb& box = coll_i.type == physic::dim2::collider::HALFSPACE ? box_j : box_i;
+                float c_x = (box.min_x + box.max_x) * 0.5f;
+                float c_y = (box.min_y + box.max_y) * 0.5f;
+                float e_x = (box.max_x - box.min_x) * 0.5f;
+                float e_y = (box.max_y - box.min_y) * 0.5f;
+                overlap = c_x * plane.normal_x + c_y * plane.normal_y - plane.origin_offset - (e_x * std::fabs(plane.normal_x) + e_y * std::fabs(plane.normal_y)) <= 0;
+            }else{
+                overlap = physic::dim2::aabb_overlap(box_i, box_j);
+            }
+
+            if(overlap)
+                brute.push_back({ i, j });
+        }
+    }
+
+    check(!brute.empty(), "broadphase: the scene has overlaps");
+    check(sweep == brute, "broadphase: sort and sweep pairs = brute force pairs");
+}
+
+// ====================================================================================
+// Copies of a world stepped together by step_worlds, on the job system, end exactly like 
+// the same world stepped alone (deterministic mode: same checksum)
+
+static void build_step_worlds_scene(physic::dim2::world& w, physic::dim2::world::solver_mode mode){
+
+    w.mode = mode;
+    w.deterministic = true;
+    add_floor(w, 0);
+
+    for(int i = 0; i < 12; i++)
+        add_box(w, 1 + i, (i % 4) * 1.2f + 0.1f * (i / 4), 0.5f + (i / 4) * 1.05f, 1, 1);
+
+    physic::dim2::body_handle bob = add_box(w, 20, 8, 5, 0.2f, 0.2f);
+    physic::dim2::add_distance_joint(w, bob, physic::dim2::null_body, 0, 0, 6, 5, 2);
+}
+
+static void test_step_worlds(physic::dim2::world::solver_mode mode){
+
+    const int copies = 6;
+    const int steps = 120;
+
+    physic::dim2::world solo;
+    build_step_worlds_scene(solo, mode);
+    step_world(solo, steps);
+
+    std::vector<std::unique_ptr<physic::dim2::world>> worlds;
+    for(int i = 0; i < copies; i++){
+        worlds.emplace_back(new physic::dim2::world);
+        build_step_worlds_scene(*worlds.back(), mode);
+    }
+
+    check(solo.checksum != 0, "step_worlds: solo checksum");
+
+    jobs::start(3);
+    for(int i = 0; i < steps; i++)
+        physic::dim2::step_worlds(worlds, solo.fixed_delta_time);
+    jobs::stop();
+
+    for(const std::unique_ptr<physic::dim2::world>& w : worlds){
+        check(w->step_count == solo.step_count, "step_worlds: step count");
+        check(w->checksum == solo.checksum, "step_worlds: checksum = solo run");
+    }
+}
+
+// ====================================================================================
+// step_batch: every env has its block of observation_size floats, env after env, body after
+// body (pos_x, pos_y, angle, vel_x, vel_y, w); after a done the observation written is the
+// first observation of the new episode
+
+static void test_step_batch(){
+
+    physic::dim2::world prototype;
+    add_floor(prototype, 0);
+    add_box(prototype, 1, 0, 0.5f, 1, 1);
+    add_box(prototype, 2, 3, 2, 1, 1);
+
+    const int env_count = 4;
+    const int episode_length = 5;
+
+    physic::dim2::env_batch batch;
+    check(physic::dim2::create_env_batch(batch, prototype, env_count, { 1 }, { 1, 2 }), "step_batch: create");
+    batch.episode_length = episode_length;
+
+    int stride = physic::dim2::observation_size(batch);
+    check(stride == 12 && physic::dim2::action_size(batch) == 3, "step_batch: sizes");
+
+    std::vector<float> first(env_count * stride);
+    physic::dim2::write_observations(batch, first.data());
+    for(int env = 0; env < env_count; env++){
+        const float* block = first.data() + env * stride;
+        check(block[0] == 0 && block[1] == 0.5f && block[6] == 3 && block[7] == 2, "step_batch: first observation");
+    }
+
+    // A different push on every env: the blocks must follow their own env
+    std::vector<float> actions(env_count * physic::dim2::action_size(batch), 0.0f);
+    for(int env = 0; env < env_count; env++)
+        actions[env * 3] = 100.0f * env;
+
+    std::vector<float> observations(env_count * stride);
+    std::vector<unsigned char> dones(env_count);
+
+    for(int step = 1; step <= episode_length; step++){
+        physic::dim2::step_batch(batch, actions.data(), observations.data(), dones.data());
+
+        if(step < episode_length){
+            for(int env = 0; env < env_count; env++){
+                const physic::dim2::body_storage& bodies = batch.envs[env]->bodies;
+                check(dones[env] == 0, "step_batch: not done");
+                for(int k = 0; k < 2; k++){
+                    int row = physic::dim2::body_row(bodies, batch.observed[k]);
+                    const float* block = observations.data() + env * stride + k * 6;
+                    check(block[0] == bodies.pos_x[row] && block[1] == bodies.pos_y[row] && block[2] == bodies.angle[row] &&
+                          block[3] == bodies.vel_x[row] && block[4] == bodies.vel_y[row] && block[5] == bodies.w[row], "step_batch: observation layout");
+                }
+            }
+            check(observations[stride + 3] > observations[3], "step_batch: actions of their own env");
+        }
+    }
+
+    for(int env = 0; env < env_count; env++)
+        check(dones[env] == 1, "step_batch: done after episode_length steps");
+    check(observations == first, "step_batch: observation after done = first of the episode");
+}
 
 int main(){
-    std::vector<std::pair<physic::dim2::rigidbody, physic::dim2::collider>> world_bodies;
-    world_bodies.push_back({ {}, physic::dim2::collider_halfspace() } );
-    world_bodies.push_back({ {}, physic::dim2::collider_box() } );
 
-    physic::dim2::contact_detection_dispatcher(world_bodies);
-}
\ No newline at end of file
+    test_box_floor_contacts();
+    test_box_box_contacts();
+    test_box_stack_rest();
+    test_broadphase_pairs();
+    test_bounded_force_generator();
+    test_sphere_rolling(physic::dim2::world::IMPULSE);
+    test_sphere_rolling(physic::dim2::world::XPBD);
+    test_pendulum_length(physic::dim2::world::IMPULSE);
+    test_pendulum_length(physic::dim2::world::XPBD);
+    test_revolute_chain(physic::dim2::world::IMPULSE);
+    test_revolute_chain(physic::dim2::world::XPBD);
+    test_weld_cantilever(physic::dim2::world::IMPULSE);
+    test_weld_cantilever(physic::dim2::world::XPBD);
+    test_step_worlds(physic::dim2::world::IMPULSE);
+    test_step_worlds(physic::dim2::world::XPBD);
+    test_step_batch();
+
+    if(failed_checks == 0)
+        std::cout << "all tests passed" << std::endl;
+    return failed_checks;
+}
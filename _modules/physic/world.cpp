@@ -0,0 +1,916 @@
+#include "physic.h"
+#include <cmath>
+#include <algorithm>
+#include <numeric>
+#include <cassert>
+#include <chrono>
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                              BODY STORAGE
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+physic::dim2::collider& physic::dim2::shape_collider(collider_shape& shape){
+    switch(shape.type){
+        case collider::BOX:         return shape.box;
+        case collider::SPHERE:      return shape.sphere;
+        default:                    return shape.halfspace;
+    }
+}
+
+const physic::dim2::collider& physic::dim2::shape_collider(const collider_shape& shape){
+    return shape_collider(const_cast<collider_shape&>(shape));
+}
+
+physic::dim2::collider_shape physic::dim2::make_shape(const collider& coll){
+
+    collider_shape shape{};                                     // zeroed: the unused members are saved too
+    shape.type = coll.type;
+
+    switch(coll.type){
+        case collider::BOX:         shape.box = (const collider_box&) coll; break;
+        case collider::SPHERE:      shape.sphere = (const collider_sphere&) coll; break;
+        default:                    shape.halfspace = (const collider_halfspace&) coll; break;
+    }
+
+    return shape;
+}
+
+// =========================================================================|
+//                                 add_body
+// =========================================================================|
+// Append a row to every column; the new handle takes a free slot of the 
+// handle table (with its current generation) or a new one.
+//
+physic::dim2::body_handle physic::dim2::add_body(body_storage& bodies, int id, const rigidbody* rb, const collider& coll){
+
+    assert((rb != nullptr || coll.type == collider::HALFSPACE) && "only halfspaces can be static");
+    assert((rb == nullptr || coll.type != collider::HALFSPACE) && "halfspaces must be static");
+
+    int row = body_count(bodies);
+
+    body_handle handle;
+    if(!bodies.free_handles.empty()){
+        handle.index = bodies.free_handles.back();
+        bodies.free_handles.pop_back();
+    }else{
+        handle.index = (int) bodies.handle_row.size();
+        bodies.handle_row.push_back(-1);
+        bodies.handle_generation.push_back(0);
+    }
+    handle.generation = bodies.handle_generation[handle.index];
+
+    bodies.id.push_back(id);
+    bodies.is_static.push_back(rb == nullptr);
+
+    for( auto* column : { &bodies.pos_x, &bodies.pos_y, &bodies.angle, &bodies.vel_x, &bodies.vel_y, &bodies.w,
+                          &bodies.m, &bodies.I, &bodies.inv_mass, &bodies.inv_inertia,
+                          &bodies.prev_pos_x, &bodies.prev_pos_y, &bodies.prev_angle,
+                          &bodies.force_x, &bodies.force_y, &bodies.torque })
+        column->push_back(0);
+
+    bodies.shape.push_back(make_shape(coll));
+
+    bodies.handle_row[handle.index] = row;
+    bodies.row_handle.push_back(handle.index);
+
+    if(rb != nullptr)
+        write_body(bodies, row, *rb);
+
+    return handle;
+}
+
+// =========================================================================|
+//                          read_body / write_body
+// =========================================================================|
+
+physic::dim2::rigidbody physic::dim2::read_body(const body_storage& bodies, int row){
+
+    rigidbody rb;
+    rb.pos_x = bodies.pos_x[row];
+    rb.pos_y = bodies.pos_y[row];
+    rb.vel_x = bodies.vel_x[row];
+    rb.vel_y = bodies.vel_y[row];
+    rb.angle = bodies.angle[row];
+    rb.w = bodies.w[row];
+    rb.m = bodies.m[row];
+    rb.I = bodies.I[row];
+    rb.prev_pos_x = bodies.prev_pos_x[row];
+    rb.prev_pos_y = bodies.prev_pos_y[row];
+    rb.prev_angle = bodies.prev_angle[row];
+    rb.force_x = bodies.force_x[row];
+    rb.force_y = bodies.force_y[row];
+    rb.torque = bodies.torque[row];
+    return rb;
+}
+
+void physic::dim2::write_body(body_storage& bodies, int row, const rigidbody& rb){
+
+    if(bodies.is_static[row])
+        return;
+
+    bodies.pos_x[row] = rb.pos_x;
+    bodies.pos_y[row] = rb.pos_y;
+    bodies.vel_x[row] = rb.vel_x;
+    bodies.vel_y[row] = rb.vel_y;
+    bodies.angle[row] = rb.angle;
+    bodies.w[row] = rb.w;
+    bodies.m[row] = rb.m;
+    bodies.I[row] = rb.I;
+    bodies.inv_mass[row] = 1 / rb.m;
+    bodies.inv_inertia[row] = 1 / rb.I;
+    bodies.prev_pos_x[row] = rb.prev_pos_x;
+    bodies.prev_pos_y[row] = rb.prev_pos_y;
+    bodies.prev_angle[row] = rb.prev_angle;
+    bodies.force_x[row] = rb.force_x;
+    bodies.force_y[row] = rb.force_y;
+    bodies.torque[row] = rb.torque;
+}
+
+void physic::dim2::set_body_collider(body_storage& bodies, int row, const collider& coll){
+    assert((coll.type == collider::HALFSPACE) == (bool) bodies.is_static[row] && "a body can't change between static and dynamic");
+    bodies.shape[row] = make_shape(coll);
+}
+
+// =========================================================================|
+//                                remove_body
+// =========================================================================|
+// Move the last row in the row of the removed body (every column), then
+// free the slot of the removed handle bumping its generation.
+//
+template<typename Column>
+static void swap_pop_column(Column& column, int row){
+    column[row] = column.back();
+    column.pop_back();
+}
+
+void physic::dim2::remove_body(body_storage& bodies, body_handle handle){
+
+    int row = body_row(bodies, handle);
+    assert(row != -1 && "removing a body that doesn't exist");
+
+    int last = body_count(bodies) - 1;
+    int last_slot = bodies.row_handle[last];
+
+    swap_pop_column(bodies.id, row);
+    swap_pop_column(bodies.is_static, row);
+    for( auto* column : { &bodies.pos_x, &bodies.pos_y, &bodies.angle, &bodies.vel_x, &bodies.vel_y, &bodies.w,
+                          &bodies.m, &bodies.I, &bodies.inv_mass, &bodies.inv_inertia,
+                          &bodies.prev_pos_x, &bodies.prev_pos_y, &bodies.prev_angle,
+                          &bodies.force_x, &bodies.force_y, &bodies.torque })
+        swap_pop_column(*column, row);
+    swap_pop_column(bodies.shape, row);
+    swap_pop_column(bodies.row_handle, row);
+
+    bodies.handle_row[last_slot] = row;
+
+    bodies.handle_row[handle.index] = -1;
+    bodies.handle_generation[handle.index]++;
+    bodies.free_handles.push_back(handle.index);
+}
+
+// Free every slot: the handle table (and the generations) survive the clear
+void physic::dim2::clear_bodies(body_storage& bodies){
+
+    for(int row = body_count(bodies) - 1; row >= 0; row--){
+        int slot = bodies.row_handle[row];
+        bodies.handle_row[slot] = -1;
+        bodies.handle_generation[slot]++;
+        bodies.free_handles.push_back(slot);
+    }
+
+    body_storage cleared;
+    cleared.handle_row.swap(bodies.handle_row);
+    cleared.handle_generation.swap(bodies.handle_generation);
+    cleared.free_handles.swap(bodies.free_handles);
+    bodies = std::move(cleared);
+}
+
+physic::dim2::body_pose physic::dim2::get_body_pose(const body_storage& bodies, int row){
+    if(bodies.is_static[row])
+        return { -1, 0, 0, 0 };
+    return { row, bodies.pos_x[row], bodies.pos_y[row], bodies.angle[row] };
+}
+
+// =========================================================================|
+//                               column block
+// =========================================================================|
+// Every column starts at a max_align_t boundary. The top is atomic: envs 
+// stepped on different workers can grow their columns at the same time 
+// (the block refuses them once full, they move to the heap).
+//
+static size_t aligned_column_bytes(size_t bytes){
+    const size_t alignment = sizeof(std::max_align_t);
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+void physic::dim2::reserve_column_block(column_block& block, size_t bytes){
+
+    size_t units = aligned_column_bytes(bytes) / sizeof(std::max_align_t);
+    if(units * sizeof(std::max_align_t) > block.size){
+        block.memory.reset(new std::max_align_t[units]);
+        block.size = units * sizeof(std::max_align_t);
+    }
+    block.top = 0;
+}
+
+void* physic::dim2::column_block_allocate(column_block* block, size_t bytes){
+
+    if(block == nullptr || bytes == 0)
+        return nullptr;
+
+    size_t size = aligned_column_bytes(bytes);
+    size_t offset = block->top.fetch_add(size);
+    if(offset + size > block->size)
+        return nullptr;
+
+    return reinterpret_cast<unsigned char*>(block->memory.get()) + offset;
+}
+
+bool physic::dim2::column_block_owns(const column_block* block, const void* p){
+
+    if(block == nullptr || !block->memory)
+        return false;
+
+    const unsigned char* begin = reinterpret_cast<const unsigned char*>(block->memory.get());
+    const unsigned char* q = static_cast<const unsigned char*>(p);
+    return q >= begin && q < begin + block->size;
+}
+
+// ------------------------------------------------------------------------------------
+// Every column of the storage, handle table included
+template<typename Fn>
+static void for_each_column(physic::dim2::body_storage& bodies, Fn fn){
+    fn(bodies.id);
+    fn(bodies.is_static);
+    fn(bodies.pos_x);
+    fn(bodies.pos_y);
+    fn(bodies.angle);
+    fn(bodies.vel_x);
+    fn(bodies.vel_y);
+    fn(bodies.w);
+    fn(bodies.m);
+    fn(bodies.I);
+    fn(bodies.inv_mass);
+    fn(bodies.inv_inertia);
+    fn(bodies.prev_pos_x);
+    fn(bodies.prev_pos_y);
+    fn(bodies.prev_angle);
+    fn(bodies.force_x);
+    fn(bodies.force_y);
+    fn(bodies.torque);
+    fn(bodies.shape);
+    fn(bodies.handle_row);
+    fn(bodies.handle_generation);
+    fn(bodies.free_handles);
+    fn(bodies.row_handle);
+}
+
+size_t physic::dim2::column_block_bytes(int capacity){
+
+    size_t bytes = 0;
+    body_storage columns;
+    for_each_column(columns, [&](auto& column){
+        bytes += aligned_column_bytes(capacity * sizeof(column[0]));
+    });
+    return bytes;
+}
+
+// The columns are moved in the block in order: the storage takes a single
+// span of column_block_bytes(capacity)
+void physic::dim2::attach_column_block(body_storage& bodies, column_block* block, int capacity){
+
+    for_each_column(bodies, [&](auto& column){
+        assert(column.size() <= (size_t) capacity && "the column block must hold every column");
+        typename std::decay<decltype(column)>::type attached{ typename std::decay<decltype(column)>::type::allocator_type(block) };
+        attached.reserve(capacity);
+        attached.assign(column.begin(), column.end());
+        column = std::move(attached);
+    });
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                          SPAWNING AND DESPAWNING
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void physic::dim2::reserve_world(world& w, int capacity){
+
+    body_storage& bodies = w.bodies;
+
+    bodies.id.reserve(capacity);
+    bodies.is_static.reserve(capacity);
+    for( auto* column : { &bodies.pos_x, &bodies.pos_y, &bodies.angle, &bodies.vel_x, &bodies.vel_y, &bodies.w,
+                          &bodies.m, &bodies.I, &bodies.inv_mass, &bodies.inv_inertia,
+                          &bodies.prev_pos_x, &bodies.prev_pos_y, &bodies.prev_angle,
+                          &bodies.force_x, &bodies.force_y, &bodies.torque })
+        column->reserve(capacity);
+    for( auto* column : { &w.force_x, &w.force_y, &w.accel_x, &w.accel_y })
+        column->reserve(capacity);
+    bodies.shape.reserve(capacity);
+
+    bodies.handle_row.reserve(capacity);
+    bodies.handle_generation.reserve(capacity);
+    bodies.free_handles.reserve(capacity);
+    bodies.row_handle.reserve(capacity);
+
+    w.destroy_queue.reserve(capacity);
+    w.row_origin.reserve(capacity);
+    w.origin_row.reserve(capacity);
+
+    w.bp.boxes.reserve(capacity);
+    w.bp.sorted.reserve(capacity);
+    w.bp.halfspaces.reserve(capacity);
+    w.bp.listed.reserve(capacity);
+
+    w.contact_cache.reserve(capacity * max_pair_contacts);
+}
+
+void physic::dim2::destroy_body(world& w, body_handle handle){
+    w.destroy_queue.push_back(handle);
+}
+
+// =========================================================================|
+//                          flush_destroyed_bodies
+// =========================================================================|
+// Remove the queued bodies tracking where every row ends up (origin_row, 
+// -1 for the removed ones), then remap the row indices that outlive the
+// step: the contacts (for the rendering) and the broad phase proxies.
+// Invalid handles (already destroyed, queued twice) are skipped.
+//
+static void remap_rows(std::vector<int>& rows, const std::vector<int>& origin_row){
+    int kept = 0;
+    for(int i = 0; i < rows.size(); i++){
+        int row = rows[i] < origin_row.size() ? origin_row[rows[i]] : -1;
+        if(row != -1)
+            rows[kept++] = row;
+    }
+    rows.resize(kept);
+}
+
+void physic::dim2::flush_destroyed_bodies(world& w){
+
+    if(w.destroy_queue.empty())
+        return;
+
+    body_storage& bodies = w.bodies;
+    int count = body_count(bodies);
+
+    w.row_origin.resize(count);
+    w.origin_row.resize(count);
+    std::iota(w.row_origin.begin(), w.row_origin.end(), 0);
+    std::iota(w.origin_row.begin(), w.origin_row.end(), 0);
+
+    for( auto handle : w.destroy_queue ){
+
+        int row = body_row(bodies, handle);
+        if(row == -1)
+            continue;
+
+        // remove_body moves the last row in the removed one
+        int last = body_count(bodies) - 1;
+        w.origin_row[w.row_origin[row]] = -1;
+        if(row != last){
+            w.row_origin[row] = w.row_origin[last];
+            w.origin_row[w.row_origin[row]] = row;
+        }
+
+        remove_body(bodies, handle);
+    }
+
+    w.destroy_queue.clear();
+
+    // ------------------------------------------------------------------------------------
+    // Contacts of the last step
+
+    arena_array<contact_data>& contacts = w.contacts;
+
+    int kept = 0;
+    for(int c = 0; c < contacts.size(); c++){
+        contact_data contact = contacts[c];
+
+        contact.body_a = contact.body_a < count ? w.origin_row[contact.body_a] : -1;
+        if(contact.body_a == -1)
+            continue;
+
+        if(contact.body_b >= 0){
+            contact.body_b = contact.body_b < count ? w.origin_row[contact.body_b] : -1;
+            if(contact.body_b == -1)
+                continue;
+        }
+
+        contacts[kept++] = contact;
+    }
+    contacts.resize(kept);
+
+    // ------------------------------------------------------------------------------------
+    // Broad phase proxies (the AABBs are refreshed by the next build)
+
+    remap_rows(w.bp.sorted, w.origin_row);
+    remap_rows(w.bp.halfspaces, w.origin_row);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                WORLD STEP
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// =========================================================================|
+//                                   step
+// =========================================================================|
+// Advance the world of delta_time with the solver mode selected in the 
+// world. At the end of the step the "w.contacts" vector holds the contacts 
+// of the last contact generation (for rendering purposes).
+//
+// ------------------------------------------------------------------------------------
+// Sort the body rows by id; nothing to do if they already are. Every column
+// is permuted and the handles are pointed to the new rows.
+// The permuted column is copied back: the column keeps its storage (and its column block).
+template<typename Column>
+static void permute_column(Column& column, const std::vector<int>& order){
+    std::vector<typename Column::value_type> sorted(column.size());
+    for(int i = 0; i < order.size(); i++)
+        sorted[i] = column[order[i]];
+    std::copy(sorted.begin(), sorted.end(), column.begin());
+}
+
+static void sort_bodies_by_id(physic::dim2::body_storage& bodies){
+
+    if(std::is_sorted(bodies.id.begin(), bodies.id.end()))
+        return;
+
+    std::vector<int> order(bodies.id.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int a, int b){ return bodies.id[a] < bodies.id[b]; });
+
+    permute_column(bodies.id, order);
+    permute_column(bodies.is_static, order);
+    for( auto* column : { &bodies.pos_x, &bodies.pos_y, &bodies.angle, &bodies.vel_x, &bodies.vel_y, &bodies.w,
+                          &bodies.m, &bodies.I, &bodies.inv_mass, &bodies.inv_inertia,
+                          &bodies.prev_pos_x, &bodies.prev_pos_y, &bodies.prev_angle,
+                          &bodies.force_x, &bodies.force_y, &bodies.torque })
+        permute_column(*column, order);
+    permute_column(bodies.shape, order);
+    permute_column(bodies.row_handle, order);
+
+    for(int row = 0; row < bodies.row_handle.size(); row++)
+        bodies.handle_row[bodies.row_handle[row]] = row;
+}
+
+// ------------------------------------------------------------------------------------
+// Stage times of a profiled step: lap adds the time since the previous lap to a stage
+// of w.last_profile, skip drops it (time already counted by a nested clock)
+
+struct stage_clock{
+    bool enabled;
+    std::chrono::steady_clock::time_point last;
+
+    explicit stage_clock(bool enabled) : enabled(enabled){
+        if(enabled)
+            last = std::chrono::steady_clock::now();
+    }
+
+    void lap(double& stage_ms){
+        if(!enabled)
+            return;
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        stage_ms += std::chrono::duration<double, std::milli>(now - last).count();
+        last = now;
+    }
+
+    void skip(){
+        if(enabled)
+            last = std::chrono::steady_clock::now();
+    }
+};
+
+void physic::dim2::step(world& w, float delta_time){
+
+    if(w.profile)
+        w.last_profile = step_profile();
+    stage_clock clock(w.profile);
+    std::chrono::steady_clock::time_point step_begin = clock.last;
+
+    if(w.deterministic){
+        assert(delta_time == w.fixed_delta_time && "deterministic mode accepts only fixed_delta_time steps");
+        delta_time = w.fixed_delta_time;
+        sort_bodies_by_id(w.bodies);
+    }
+
+    // Save the poses for the rendering interpolation
+    w.bodies.prev_pos_x = w.bodies.pos_x;
+    w.bodies.prev_pos_y = w.bodies.pos_y;
+    w.bodies.prev_angle = w.bodies.angle;
+
+    clock.lap(w.last_profile.sync_ms);
+
+    switch(w.mode){
+        case world::IMPULSE:    step_impulse(w, delta_time); break;
+        case world::XPBD:       step_xpbd(w, delta_time); break;
+    }
+
+    clock.skip();
+    if(w.profile)
+        w.last_profile.contacts = w.contacts.size();
+
+    clear_forces(w);
+    flush_destroyed_bodies(w);
+
+    w.step_count++;
+    if(w.deterministic)
+        w.checksum = world_checksum(w);
+
+    clock.lap(w.last_profile.sync_ms);
+    if(w.profile)
+        w.last_profile.total_ms = std::chrono::duration<double, std::milli>(clock.last - step_begin).count();
+}
+
+// =========================================================================|
+//                                step_worlds
+// =========================================================================|
+// One world per task: the scheduler balances worlds of different size by
+// letting the idle workers take the remaining ones. Waiting inside a task
+// helps, so a world with parallel = true still can't deadlock.
+//
+void physic::dim2::step_worlds(world* const* worlds, int count, float delta_time){
+
+    jobs::parallel_for(count, [&](int begin, int end){
+        for(int i = begin; i < end; i++)
+            step(*worlds[i], delta_time);
+    });
+}
+
+void physic::dim2::step_worlds(std::vector<std::unique_ptr<world>>& worlds, float delta_time){
+
+    jobs::parallel_for((int) worlds.size(), [&](int begin, int end){
+        for(int i = begin; i < end; i++)
+            step(*worlds[i], delta_time);
+    });
+}
+
+// =========================================================================|
+//                               world_checksum
+// =========================================================================|
+// Hash of the bits (not the values: -0 != +0, NaN payloads count) of 
+// pose and velocity of every dynamic body together with its id. Two runs 
+// are bit-identical up to a step if and only if (modulo collisions) 
+// they have the same checksums up to that step.
+//
+static void fnv1a(uint64_t& hash, const void* data, size_t size){
+    const unsigned char* bytes = (const unsigned char*) data;
+    for(size_t i = 0; i < size; i++){
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+}
+
+uint64_t physic::dim2::world_checksum(const world& w){
+
+    uint64_t hash = 14695981039346656037ull;
+
+    const body_storage& bodies = w.bodies;
+
+    for(int i = 0; i < body_count(bodies); i++){
+        if(bodies.is_static[i])
+            continue;
+
+        int id = bodies.id[i];
+        float state[6] = { bodies.pos_x[i], bodies.pos_y[i], bodies.vel_x[i], bodies.vel_y[i], bodies.angle[i], bodies.w[i] };
+
+        fnv1a(hash, &id, sizeof(id));
+        fnv1a(hash, state, sizeof(state));
+    }
+
+    return hash;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                          WORLD STEP: Fixed time step
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// =========================================================================|
+//                             advance_scheduler
+// =========================================================================|
+
+int physic::dim2::advance_scheduler(fixed_step_scheduler& scheduler, float frame_delta_time){
+
+    scheduler.accumulator += std::max(frame_delta_time, 0.0f);
+
+    int steps = 0;
+    while(scheduler.accumulator >= scheduler.fixed_delta_time && steps < scheduler.max_steps_per_frame){
+        scheduler.accumulator -= scheduler.fixed_delta_time;
+        steps++;
+    }
+
+    // Clamp: drop whole steps we can't afford, keep the fraction for the interpolation
+    if(scheduler.accumulator >= scheduler.fixed_delta_time){
+        float excess = std::floor(scheduler.accumulator / scheduler.fixed_delta_time) * scheduler.fixed_delta_time;
+        scheduler.accumulator -= excess;
+        scheduler.dropped_time += excess;
+    }
+
+    scheduler.alpha = scheduler.accumulator / scheduler.fixed_delta_time;
+
+    return steps;
+}
+
+// =========================================================================|
+//                             interpolate_pose
+// =========================================================================|
+// Linear interpolation; alpha = 0 gives the previous pose, alpha = 1 the 
+// current one.
+//
+void physic::dim2::interpolate_pose(const rigidbody& rb, float alpha, float& out_pos_x, float& out_pos_y, float& out_angle){
+    out_pos_x = rb.prev_pos_x + (rb.pos_x - rb.prev_pos_x) * alpha;
+    out_pos_y = rb.prev_pos_y + (rb.pos_y - rb.prev_pos_y) * alpha;
+    out_angle = rb.prev_angle + (rb.angle - rb.prev_angle) * alpha;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                          WORLD STEP: Impulse solver
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// ------------------------------------------------------------------------------------
+// Candidate pairs of the narrow phase (the small scenes skip the broad phase)
+static void find_pairs(physic::dim2::world& w){
+    if(physic::dim2::small_scene(w.bodies)){
+        physic::dim2::all_pairs(w.bodies, w.pairs);
+    }else{
+        physic::dim2::build_broadphase(w.bp, w.bodies, w.parallel);
+        physic::dim2::broadphase_pairs(w.bp, w.bodies, w.pairs, w.parallel);
+    }
+}
+
+// =========================================================================|
+//                               step_impulse
+// =========================================================================|
+// Steps:
+//  - Integrate all the dynamic bodies with the batched integrator
+//  - Generate contacts: sort and sweep broad phase (all the pairs in a small scene), then 
+//    narrow phase on the candidate pairs
+//  - Solve contacts and joints with the iterative constraint solver
+//
+// The contacts, the pairs and the solver scratch of the last step are 
+// dropped with the reset of the step arena.
+//
+void physic::dim2::step_impulse(world& w, float delta_time){
+
+    stage_clock clock(w.profile);
+    step_profile& profile = w.last_profile;
+
+    reset_arena(w.memory);
+    w.contacts.clear();
+    w.pairs.clear();
+    clock.lap(profile.sync_ms);
+
+    integrate_world(w, delta_time);
+    clock.lap(profile.integration_ms);
+
+    find_pairs(w);
+    profile.pairs = w.pairs.size();
+    clock.lap(profile.broadphase_ms);
+
+    contact_detection_dispatcher(w, w.pairs);
+    clock.lap(profile.narrowphase_ms);
+
+    constraint_solver_dispatcher(w, delta_time);
+    clock.lap(profile.solver_ms);
+
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                           WORLD STEP: XPBD solver
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Extended position based dynamics with small steps (Macklin et al.). Each substep of length h:
+//
+//  - Integrate: save the previous pose and integrate the unconstrained motion
+//  - Collide: regenerate the contacts at the integrated poses
+//  - Project: for every contact move the two bodies along n to remove the penetration C;
+//    the position impulse is
+//
+//          dlambda = C / (w_a + w_b + compliance / h^2)
+//          w = 1/m + (r ∧ n)^2 / I
+//
+//  - Update velocities from the poses: v = (pos - prev_pos) / h, w = (angle - prev_angle) / h
+//  - Velocity pass: on every active contact apply dynamic friction (bounded by mu * lambda / h)
+//    and restitution (target separating velocity from the prestep); joints are solved here with 
+//    a single velocity iteration
+//
+
+// ------------------------------------------------------------------------------------
+// r = R(angle) * q
+static void rotate_point(float angle, float q_x, float q_y, float& out_x, float& out_y){
+    float c = std::cos(angle);
+    float s = std::sin(angle);
+    out_x = c * q_x - s * q_y;
+    out_y = s * q_x + c * q_y;
+}
+
+// ------------------------------------------------------------------------------------
+// Move a body by the position impulse P applied at lever arm r (row -1 is static)
+static void apply_position_impulse(physic::dim2::body_storage& bodies, int row, float r_x, float r_y, float p_x, float p_y){
+    if(row < 0)
+        return;
+    bodies.pos_x[row] += p_x / bodies.m[row];
+    bodies.pos_y[row] += p_y / bodies.m[row];
+    bodies.angle[row] += (r_x * p_y - r_y * p_x) / bodies.I[row];
+}
+
+// =========================================================================|
+//                                 step_xpbd
+// =========================================================================|
+
+void physic::dim2::step_xpbd(world& w, float delta_time){
+
+    int substeps = std::max(1, w.xpbd_substeps);
+    float h = delta_time / substeps;
+    if(h <= 0)
+        return;
+    float inv_h = 1 / h;
+    float alpha = w.xpbd_contact_compliance * inv_h * inv_h;
+
+    body_storage& bodies = w.bodies;
+    arena_array<contact_data>& contacts = w.contacts;
+    int count = body_count(bodies);
+
+    stage_clock clock(w.profile);
+    step_profile& profile = w.last_profile;
+
+    resolve_joint_rows(w);
+    reset_joint_impulses(w);
+
+    reset_arena(w.memory);
+    contacts.clear();
+    w.pairs.clear();
+    w.contact_cache.clear();                                    // warm starting is for the impulse solver only
+
+    // ------------------------------------------------------------------------------------
+    // Poses at the beginning of the substep (static rows never move, they can be included)
+
+    float* prev_pos_x = arena_allocate<float>(w.memory, count);
+    float* prev_pos_y = arena_allocate<float>(w.memory, count);
+    float* prev_angle = arena_allocate<float>(w.memory, count);
+
+    // Every substep regenerates the contacts: its arena memory is dropped at the next one
+    size_t substep_mark = arena_mark(w.memory);
+    clock.lap(profile.sync_ms);
+
+    for(int sub = 0; sub < substeps; sub++){
+
+        // ====================================================================================
+        // Integrate
+
+        std::copy(bodies.pos_x.begin(), bodies.pos_x.end(), prev_pos_x);
+        std::copy(bodies.pos_y.begin(), bodies.pos_y.end(), prev_pos_y);
+        std::copy(bodies.angle.begin(), bodies.angle.end(), prev_angle);
+        integrate_world(w, h);
+        clock.lap(profile.integration_ms);
+
+        // ====================================================================================
+        // Collide
+
+        arena_rewind(w.memory, substep_mark);
+        contacts.clear();
+        find_pairs(w);
+        profile.pairs = w.pairs.size();
+        clock.lap(profile.broadphase_ms);
+
+        contact_detection_dispatcher(w, w.pairs);
+        clock.lap(profile.narrowphase_ms);
+
+        // Per contact: world contact points at generation time and accumulated position impulse
+        float* ws_pa_x = arena_allocate<float>(w.memory, contacts.size());
+        float* ws_pa_y = arena_allocate<float>(w.memory, contacts.size());
+        float* ws_pb_x = arena_allocate<float>(w.memory, contacts.size());
+        float* ws_pb_y = arena_allocate<float>(w.memory, contacts.size());
+        float* lambda = arena_allocate<float>(w.memory, contacts.size());
+        std::fill(lambda, lambda + contacts.size(), 0.0f);
+
+        for(int c = 0; c < contacts.size(); c++){
+            contact_data& contact = contacts[c];
+
+            // Lever arms, effective masses and restitution bias from the pre-projection velocities
+            prestep_contact(bodies, contact, w.restitution_velocity_threshold);
+
+            int a = contact.body_a;
+            int b = contact.body_b;
+            ws_pa_x[c] = bodies.pos_x[a] + contact.ws_ra_x;
+            ws_pa_y[c] = bodies.pos_y[a] + contact.ws_ra_y;
+            ws_pb_x[c] = b >= 0 ? bodies.pos_x[b] + contact.ws_rb_x : 0;
+            ws_pb_y[c] = b >= 0 ? bodies.pos_y[b] + contact.ws_rb_y : 0;
+        }
+
+        // ====================================================================================
+        // Project positions
+
+        for(int c = 0; c < contacts.size(); c++){
+            contact_data& contact = contacts[c];
+            int a = contact.body_a;
+            int b = contact.body_b;
+
+            float n_x = contact.ws_n_x;
+            float n_y = contact.ws_n_y;
+
+            // Current penetration: the generated one minus the relative motion of the contact
+            // points along n caused by the projections already done in this substep
+            float ra_x, ra_y;
+            rotate_point(bodies.angle[a], contact.ms_qa_x, contact.ms_qa_y, ra_x, ra_y);
+            float delta_n = (bodies.pos_x[a] + ra_x - ws_pa_x[c]) * n_x + (bodies.pos_y[a] + ra_y - ws_pa_y[c]) * n_y;
+
+            float rb_x = 0, rb_y = 0;
+            float inv_m_b = 0, inv_i_b = 0;
+            if(b >= 0){
+                rotate_point(bodies.angle[b], contact.ms_qb_x, contact.ms_qb_y, rb_x, rb_y);
+                delta_n -= (bodies.pos_x[b] + rb_x - ws_pb_x[c]) * n_x + (bodies.pos_y[b] + rb_y - ws_pb_y[c]) * n_y;
+                inv_m_b = 1 / bodies.m[b];
+                inv_i_b = 1 / bodies.I[b];
+            }
+
+            float C = contact.pen - delta_n;
+            if(C <= 0)
+                continue;
+
+            float rn_a = ra_x * n_y - ra_y * n_x;
+            float rn_b = rb_x * n_y - rb_y * n_x;
+            float w_a = 1 / bodies.m[a] + rn_a * rn_a / bodies.I[a];
+            float w_b = inv_m_b + rn_b * rn_b * inv_i_b;
+
+            float dlambda = C / (w_a + w_b + alpha);
+            lambda[c] += dlambda;
+
+            apply_position_impulse(bodies, a, ra_x, ra_y, dlambda * n_x, dlambda * n_y);
+            apply_position_impulse(bodies, b, rb_x, rb_y, - dlambda * n_x, - dlambda * n_y);
+        }
+
+        // ====================================================================================
+        // Update velocities
+
+        for(int i = 0; i < count; i++){
+            if(bodies.is_static[i])
+                continue;
+            bodies.vel_x[i] = (bodies.pos_x[i] - prev_pos_x[i]) * inv_h;
+            bodies.vel_y[i] = (bodies.pos_y[i] - prev_pos_y[i]) * inv_h;
+            bodies.w[i] = (bodies.angle[i] - prev_angle[i]) * inv_h;
+        }
+
+        // ====================================================================================
+        // Velocity pass: friction and restitution on the active contacts
+
+        for(int c = 0; c < contacts.size(); c++){
+            if(lambda[c] <= 0)
+                continue;
+
+            contact_data& contact = contacts[c];
+            int a = contact.body_a;
+            int b = contact.body_b;
+
+            float n_x = contact.ws_n_x;
+            float n_y = contact.ws_n_y;
+            float t_x = n_y;
+            float t_y = - n_x;
+
+            float va_x, va_y, vb_x, vb_y;
+            point_velocity(bodies, a, contact.ws_ra_x, contact.ws_ra_y, va_x, va_y);
+            point_velocity(bodies, b, contact.ws_rb_x, contact.ws_rb_y, vb_x, vb_y);
+
+            float vn = (va_x - vb_x) * n_x + (va_y - vb_y) * n_y;
+            float vt = (va_x - vb_x) * t_x + (va_y - vb_y) * t_y;
+
+            // Dynamic friction
+            float max_friction = contact.friction * lambda[c] * inv_h;
+            float jt = std::min(std::max(- contact.tangent_mass * vt, - max_friction), max_friction);
+
+            // Restitution: reach the separating velocity computed before the projection
+            float jn = contact.normal_mass * (contact.velocity_bias - vn);
+
+            float p_x = jn * n_x + jt * t_x;
+            float p_y = jn * n_y + jt * t_y;
+            apply_world_impulse(bodies, a, contact.ws_ra_x, contact.ws_ra_y, p_x, p_y);
+            apply_world_impulse(bodies, b, contact.ws_rb_x, contact.ws_rb_y, - p_x, - p_y);
+
+            contact.normal_impulse = lambda[c] * inv_h;
+            contact.tangent_impulse = jt;
+            contact.resolved_impulse_mag = contact.normal_impulse;
+        }
+
+        // ------------------------------------------------------------------------------------
+        // Joints: one velocity iteration per substep
+
+        for(int i = 0; i < w.distance_joints.body_a.size(); i++){
+            if(!joint_active(w.distance_joints, i)) continue;
+            prestep_distance_joint(bodies, w.distance_joints, i, inv_h, w.joint_baumgarte);
+            solve_distance_joint(bodies, w.distance_joints, i);
+        }
+        for(int i = 0; i < w.revolute_joints.body_a.size(); i++){
+            if(!joint_active(w.revolute_joints, i)) continue;
+            prestep_revolute_joint(bodies, w.revolute_joints, i, inv_h, w.joint_baumgarte);
+            solve_revolute_joint(bodies, w.revolute_joints, i);
+        }
+        for(int i = 0; i < w.weld_joints.body_a.size(); i++){
+            if(!joint_active(w.weld_joints, i)) continue;
+            prestep_weld_joint(bodies, w.weld_joints, i, inv_h, w.joint_baumgarte);
+            solve_weld_joint(bodies, w.weld_joints, i);
+        }
+
+        clock.lap(profile.solver_ms);
+    }
+
+}
@@ -24,10 +24,13 @@ cl /c /MD -DSFML_STATIC /Fo"build/" ^
 /I "_modules\stb-image\includes" ^
 /I "_modules\imgui-docking\includes" ^
 /I "_modules\physic\includes" ^
+/I "_modules\jobs\includes" ^
 /I "includes" ^
 main.cpp ^
 editor_gui.cpp ^
 game_data.cpp ^
+simulation.cpp ^
+streaming.cpp ^
 logic.cpp
 
 :: -----------------------------------------------------|
@@ -45,6 +48,8 @@ _modules\dependencies.lib ^
 build\main.obj ^
 build\editor_gui.obj ^
 build\game_data.obj ^
+build\simulation.obj ^
+build\streaming.obj ^
 build\logic.obj
 
 
@@ -2,9 +2,11 @@
 
 #include "rendering.h"
 #include "game_data.h"
+#include "simulation.h"
 
 #include <string>
 #include <cmath>
+#include <algorithm>
 
 #include <iostream>
 
@@ -12,13 +14,9 @@
 //                                                  GUI
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-game_data::AliasGameObject selected_go;
-
 gui::gui_parameters gui::parameters;
 
-int gui::selected_box_array_pos = -1;
-int gui::selected_sphere_array_pos = -1;
-int gui::selected_halfspace_array_pos = -1;
+int gui::selected_entity = game_data::NullEntity;
 
 // =========================================================================|
 //                                  init
@@ -55,6 +53,35 @@ void gui::render_gui(){
 
     ImGui::BeginMainMenuBar();
     {
+        if (ImGui::BeginMenu("File")) 
+        {
+            // .txt: text scene (compiled once to scene.txt.bin), anything else: binary scene
+            static char scene_path[256] = "resources/scene.txt";
+            ImGui::InputText("Scene", scene_path, sizeof(scene_path));
+
+            if (ImGui::MenuItem("Save Scene")) {
+                if(!game_data::SaveScene(scene_path))
+                    std::cerr << "Error writing scene " << scene_path << std::endl << std::flush;
+            }
+
+            if (ImGui::MenuItem("Open Scene")) {
+                if(game_data::LoadScene(scene_path))
+                    selected_entity = game_data::NullEntity;
+            }
+
+            // Only the chunks around the camera are simulated (pan with the arrow keys)
+            static float chunk_size = 32;
+            ImGui::InputFloat("Chunk size", &chunk_size);
+            chunk_size = std::max(chunk_size, 1.0f);
+
+            if (ImGui::MenuItem("Stream Scene")) {
+                if(game_data::StreamScene(scene_path, chunk_size))
+                    selected_entity = game_data::NullEntity;
+            }
+
+        ImGui::EndMenu();
+        }
+
         if (ImGui::BeginMenu("Edit")) 
         {
             if (ImGui::MenuItem("Add BOX Game Object")) {
@@ -69,6 +96,11 @@ void gui::render_gui(){
                 game_data::AddHalfspaceObject();
                 std::cout << "ADDED HALFSPACE" << std::endl << std::flush;
             } 
+
+            if (ImGui::MenuItem("Remove Selected Game Object", nullptr, false, selected_entity != game_data::NullEntity)) {
+                game_data::DestroyEntity(selected_entity);
+                selected_entity = game_data::NullEntity;
+            }
             
         ImGui::EndMenu();
         }
@@ -79,6 +111,61 @@ void gui::render_gui(){
             ImGui::Checkbox("Show contact data", &game_data::debug_draw_contact_data);
             ImGui::Checkbox("Show impulses", &game_data::debug_draw_impulses);
 
+            ImGui::SeparatorText("Solver");
+
+            // The settings are applied by the simulation thread before its next step
+            simulation::settings& settings = simulation::requested_settings;
+            bool settings_changed = false;
+
+            int solver_mode = settings.mode;
+            settings_changed |= ImGui::RadioButton("Impulse", &solver_mode, physic::dim2::world::IMPULSE);
+            ImGui::SameLine();
+            settings_changed |= ImGui::RadioButton("XPBD", &solver_mode, physic::dim2::world::XPBD);
+            settings.mode = (physic::dim2::world::solver_mode) solver_mode;
+
+            if(settings.mode == physic::dim2::world::IMPULSE){
+                settings_changed |= ImGui::SliderInt("Iterations", &settings.velocity_iterations, 1, 32);
+            }else{
+                settings_changed |= ImGui::SliderInt("Substeps", &settings.xpbd_substeps, 1, 32);
+            }
+
+            settings_changed |= ImGui::DragFloat2("Gravity", &settings.gravity_x, 0.1f);
+
+            // The step length can't change while deterministic, a replay would diverge
+            static int step_rate = 60;
+            ImGui::BeginDisabled(settings.deterministic);
+            if(ImGui::SliderInt("Step rate (Hz)", &step_rate, 15, 240)){
+                settings.fixed_delta_time = 1.0f / step_rate;
+                settings_changed = true;
+            }
+            ImGui::EndDisabled();
+            settings_changed |= ImGui::SliderInt("Max steps per frame", &settings.max_steps_per_frame, 1, 16);
+
+            settings_changed |= ImGui::Checkbox("Record rewind", &settings.record_rewind);
+            settings_changed |= ImGui::Checkbox("Deterministic", &settings.deterministic);
+            if(settings.deterministic){
+                const simulation::snapshot& snap = simulation::current_snapshot();
+                ImGui::Text("Step %llu checksum %016llx", 
+                    (unsigned long long) snap.step_count, 
+                    (unsigned long long) snap.checksum);
+            }
+
+            if(settings_changed){
+                simulation::set_settings(settings);
+            }
+
+            ImGui::SeparatorText("Step memory");
+
+            const simulation::snapshot& snap = simulation::current_snapshot();
+            ImGui::Text("Last step %.1f KB, high water %.1f KB", snap.arena_last_step / 1024.0f, snap.arena_high_water / 1024.0f);
+            ImGui::Text("Arena capacity %.1f KB", snap.arena_capacity / 1024.0f);
+
+            if(snap.streaming){
+                ImGui::SeparatorText("Streaming");
+                ImGui::Text("Loaded chunks %d, pending jobs %d", snap.stream_loaded_chunks, snap.stream_pending_jobs);
+                ImGui::Text("Bodies on disk %d", snap.stream_stored_bodies);
+            }
+
         ImGui::EndMenu();
         }
         
@@ -103,101 +190,29 @@ void gui::render_gui(){
         
         ImGui::BeginChild("ResizableChild", ImVec2(-FLT_MIN, ImGui::GetTextLineHeightWithSpacing() * 8), ImGuiChildFlags_Border | ImGuiChildFlags_ResizeY);
         {
-            int index = 0;
-            // Iterate over all the world box gameobjects
-            for (auto& box_go : game_data::boxGameobjects){
+            const simulation::snapshot& snap = simulation::current_snapshot();
 
-                // Create a button with the current game object id; if selected, set game_object_list_selected_element_id
-                std::string text = "Box game object id: " + std::to_string(box_go.gameobject_id);
-                if (ImGui::Button(text.c_str())) {
+            // Iterate over all the entities with a body; the label is given by the shape of the body
+            game_data::Each([&](game_data::Entity entity, game_data::PhysicBody& body){
 
-                    selected_box_array_pos = index;
-                    selected_sphere_array_pos = -1;
-                    selected_halfspace_array_pos = -1;
-                    
-                }
-                index++;
+                const simulation::body_record* record = simulation::find_body(snap, body.body_id);
 
-            }
-
-            index = 0;
-            // Iterate over all the world sphere gameobjects
-            for (auto& sphere_go : game_data::sphereGameobjects){
-
-                // Create a button with the current game object id; if selected, set game_object_list_selected_element_id
-                std::string text = "Sphere game object id: " + std::to_string(sphere_go.gameobject_id);
-                if (ImGui::Button(text.c_str())) {
-                    
-                    selected_box_array_pos = -1;
-                    selected_sphere_array_pos = index;
-                    selected_halfspace_array_pos = -1;
-                    
+                std::string text = "Game object id: ";
+                if(record != nullptr){
+                    switch(record->shape.type){
+                        case physic::dim2::collider::BOX:       text = "Box game object id: "; break;
+                        case physic::dim2::collider::SPHERE:    text = "Sphere game object id: "; break;
+                        case physic::dim2::collider::HALFSPACE: text = "Halfspace game object id: "; break;
+                    }
                 }
-                index++;
+                text += std::to_string(entity);
 
-            }
-
-            index = 0;
-            // Iterate over all the world halfspace gameobjects
-            for (auto& halfspace_go : game_data::halfSpaceGameobjects) {
-
-                // Create a button with the current game object id; if selected, set game_object_list_selected_element_id
-                std::string text = "Halfspace game object id: " + std::to_string(halfspace_go.gameobject_id);
+                // Create a button with the current game object id; if pressed, select the entity
                 if (ImGui::Button(text.c_str())) {
-
-                    selected_box_array_pos = -1;
-                    selected_sphere_array_pos = -1;
-                    selected_halfspace_array_pos = index;
+                    selected_entity = entity;
                 }
-                index ++;
-            }
-
-            if(selected_box_array_pos > -1){
-                
-                game_data::BoxGameObject& box_go = game_data::boxGameobjects[selected_box_array_pos];
-
-                selected_go.coll = &box_go.coll;
-                selected_go.gameobject_id = &box_go.gameobject_id;
-                selected_go.rb = &box_go.rb;
-                selected_go.render_outline = nullptr;
-                selected_go.world_x_pos = &box_go.world_x_pos;
-                selected_go.world_x_scale = &box_go.world_x_scale;
-                selected_go.world_y_pos = &box_go.world_y_pos;
-                selected_go.world_y_scale = &box_go.world_y_scale;
-                selected_go.world_z_angle = &box_go.world_z_angle;
-
-            }
-
-            if(selected_sphere_array_pos > -1){
-
-                game_data::SphereGameObject& sphere_go = game_data::sphereGameobjects[selected_sphere_array_pos];
-
-                selected_go.coll = &sphere_go.coll;
-                selected_go.gameobject_id = &sphere_go.gameobject_id;
-                selected_go.rb = &sphere_go.rb;
-                selected_go.render_outline = nullptr;
-                selected_go.world_x_pos = &sphere_go.world_x_pos;
-                selected_go.world_x_scale = &sphere_go.world_x_scale;
-                selected_go.world_y_pos = &sphere_go.world_y_pos;
-                selected_go.world_y_scale = &sphere_go.world_y_scale;
-                selected_go.world_z_angle = &sphere_go.world_z_angle;
-            }
 
-            if(selected_halfspace_array_pos > -1){
-
-                game_data::HalfSpaceGameObject& halfspace_go = game_data::halfSpaceGameobjects[selected_halfspace_array_pos];
-
-                selected_go.coll = &halfspace_go.coll;
-                selected_go.gameobject_id = &halfspace_go.gameobject_id;
-                selected_go.rb = nullptr;
-                selected_go.render_outline = nullptr;
-                selected_go.world_x_pos = nullptr;
-                selected_go.world_x_scale = nullptr;
-                selected_go.world_y_pos = nullptr;
-                selected_go.world_y_scale = nullptr;
-                selected_go.world_z_angle = nullptr;
-
-            }
+            }, game_data::physicBodies);
 
         }
         ImGui::EndChild();
@@ -211,7 +226,7 @@ void gui::render_gui(){
         // If game object dragging is active, inspect the dragged gameobject
 
         /* if (game_data::event_is_dragging_active) {
-            selected_go = game_data::draggedGameObject;
+            selected_entity = game_data::draggedEntity;
         }  */
 
         // ====================================================================================
@@ -221,9 +236,23 @@ void gui::render_gui(){
         ImGui::SeparatorText("Inspector");
         ImGui::Indent();
         
-        // Inspect only if a selected element exists
-        if(selected_go.gameobject_id != nullptr)
+        // Inspect only if a selected element exists and the simulation already knows its body
+        game_data::Transform* selected_transform = game_data::Get(game_data::transforms, selected_entity);
+        game_data::PhysicBody* selected_physic_body = game_data::Get(game_data::physicBodies, selected_entity);
+
+        const simulation::body_record* selected_record = selected_physic_body != nullptr
+            ? simulation::find_body(simulation::current_snapshot(), selected_physic_body->body_id)
+            : nullptr;
+
+        if(selected_record != nullptr)
         {
+            // The inspector edits a copy of the body of this frame snapshot
+            simulation::body_record selected_body = *selected_record;
+            physic::dim2::rigidbody* selected_rb = selected_body.shape.type == physic::dim2::collider::HALFSPACE ? nullptr : &selected_body.rb;
+            physic::dim2::collider* selected_coll = &physic::dim2::shape_collider(selected_body.shape);
+
+            // Set by every edit; the edited body is sent to the simulation at the end of the inspector
+            bool body_edited = false;
             
             // ====================================================================================
             // Transform data
@@ -233,18 +262,21 @@ void gui::render_gui(){
             // ------------------------------------------------------------------------------------
             // Position
 
-            if( selected_go.world_x_pos != nullptr && selected_go.world_y_pos != nullptr && selected_go.rb != nullptr){
+            if( selected_transform != nullptr && selected_rb != nullptr){
 
                 static float t_pos_ui[2] = { 0.0f, 0.0f};
 
                 if(ImGui::InputFloat3("X-Y-Z", t_pos_ui)){
-                    *selected_go.world_x_pos = t_pos_ui[0];
-                    *selected_go.world_y_pos = t_pos_ui[1];
-                    selected_go.rb->pos_x = t_pos_ui[0];
-                    selected_go.rb->pos_y = t_pos_ui[1];
+                    body_edited = true;
+                    selected_transform->world_x_pos = t_pos_ui[0];
+                    selected_transform->world_y_pos = t_pos_ui[1];
+                    selected_rb->pos_x = t_pos_ui[0];
+                    selected_rb->pos_y = t_pos_ui[1];
+                    selected_rb->prev_pos_x = t_pos_ui[0];
+                    selected_rb->prev_pos_y = t_pos_ui[1];
                 }else{
-                    t_pos_ui[0] = *selected_go.world_x_pos;
-                    t_pos_ui[1] = *selected_go.world_y_pos;
+                    t_pos_ui[0] = selected_transform->world_x_pos;
+                    t_pos_ui[1] = selected_transform->world_y_pos;
                 }
 
             }
@@ -252,67 +284,76 @@ void gui::render_gui(){
             // ------------------------------------------------------------------------------------
             // Angle
 
-            if( selected_go.world_z_angle != nullptr && selected_go.rb != nullptr){
+            if( selected_transform != nullptr && selected_rb != nullptr){
     
                 static float slider_f;
                 static ImGuiSliderFlags flags = ImGuiSliderFlags_None;
                 if(ImGui::SliderFloat("Angle", &slider_f, 0.0f, 360.0f, "%.3f", flags))
                 {
+                    body_edited = true;
                     float rad_angle = slider_f * (2.0f * 3.14 / 360.0f);
-                    *selected_go.world_z_angle = rad_angle;
-                    selected_go.rb->angle = rad_angle;
+                    selected_transform->world_z_angle = rad_angle;
+                    selected_rb->angle = rad_angle;
+                    selected_rb->prev_angle = rad_angle;
                 }else{
-                    slider_f = *selected_go.world_z_angle / (2.0f * 3.14 / 360.0f);
+                    slider_f = selected_transform->world_z_angle / (2.0f * 3.14 / 360.0f);
                 }
 
             }
             // ------------------------------------------------------------------------------------
             // Scale
 
-            if( selected_go.coll != nullptr ){
+            if( selected_coll != nullptr ){
 
                 // IF HAS BOX COLLIDER
-                if(selected_go.coll->type == physic::dim2::collider::BOX){
+                if(selected_coll->type == physic::dim2::collider::BOX){
                     
                     static float t_size_ui[2] = { 0.0f, 0.0f};
 
                     if(ImGui::InputFloat2("Scale", t_size_ui)){
-                        *selected_go.world_x_scale = t_size_ui[0];
-                        *selected_go.world_y_scale = t_size_ui[1];
-                        ((physic::dim2::collider_box*) selected_go.coll)->width  = t_size_ui[0];
-                        ((physic::dim2::collider_box*) selected_go.coll)->height = t_size_ui[1];
+                        body_edited = true;
+                        if(selected_transform != nullptr){
+                            selected_transform->world_x_scale = t_size_ui[0];
+                            selected_transform->world_y_scale = t_size_ui[1];
+                        }
+                        ((physic::dim2::collider_box*) selected_coll)->width  = t_size_ui[0];
+                        ((physic::dim2::collider_box*) selected_coll)->height = t_size_ui[1];
                     }else{
-                        t_size_ui[0] = *selected_go.world_x_scale;
-                        t_size_ui[1] = *selected_go.world_y_scale;
+                        t_size_ui[0] = ((physic::dim2::collider_box*) selected_coll)->width;
+                        t_size_ui[1] = ((physic::dim2::collider_box*) selected_coll)->height;
                     }
 
                 }
 
                 // IF HAS SPHERE COLLIDER
 
-                if(selected_go.coll->type == physic::dim2::collider::SPHERE){
+                if(selected_coll->type == physic::dim2::collider::SPHERE){
                     
                     static float r_size_ui;
 
                     if(ImGui::InputFloat("Scale", &r_size_ui)){
-                        *selected_go.world_x_scale = r_size_ui;
-                        *selected_go.world_y_scale = r_size_ui;
-                        ((physic::dim2::collider_sphere*) selected_go.coll)->radius  = r_size_ui;
+                        body_edited = true;
+                        if(selected_transform != nullptr){
+                            selected_transform->world_x_scale = r_size_ui;
+                            selected_transform->world_y_scale = r_size_ui;
+                        }
+                        ((physic::dim2::collider_sphere*) selected_coll)->radius  = r_size_ui;
         
                     }else{
-                        r_size_ui = ((physic::dim2::collider_sphere*) selected_go.coll)->radius;
+                        r_size_ui = ((physic::dim2::collider_sphere*) selected_coll)->radius;
                     }
 
                 }
 
-                if(selected_go.coll->type == physic::dim2::collider::HALFSPACE){
+                if(selected_coll->type == physic::dim2::collider::HALFSPACE){
                     
-                    physic::dim2::collider_halfspace* coll = (physic::dim2::collider_halfspace*) selected_go.coll;
+                    physic::dim2::collider_halfspace* coll = (physic::dim2::collider_halfspace*) selected_coll;
 
                     static float slider_f;
                     static ImGuiSliderFlags flags = ImGuiSliderFlags_None;
                     if(ImGui::SliderFloat("Angle", &slider_f, 0.0f, 360.0f, "%.3f", flags))
                     {
+                        body_edited = true;
 
                         float rad_angle = slider_f * (2.0f * 3.14 / 360.0f);
                         mat4x4 rotation_matrix;
@@ -326,26 +367,50 @@ void gui::render_gui(){
                         vec2 new_normal = {new_normal4[0], new_normal4[1]};
                         float normalizer = vec2_len(new_normal);
 
-                        ((physic::dim2::collider_halfspace*) selected_go.coll)->normal_x = new_normal[0] / normalizer;
-                        ((physic::dim2::collider_halfspace*) selected_go.coll)->normal_y = new_normal[1] / normalizer;
+                        ((physic::dim2::collider_halfspace*) selected_coll)->normal_x = new_normal[0] / normalizer;
+                        ((physic::dim2::collider_halfspace*) selected_coll)->normal_y = new_normal[1] / normalizer;
 
                     }
                     
                     static float origin_offset_ui;
 
                     if(ImGui::InputFloat("Origin Off", &origin_offset_ui)){
+                        body_edited = true;
                         coll->origin_offset = origin_offset_ui;
                     }
                     
                 }
 
+                // ------------------------------------------------------------------------------------
+                // Surface material
+
+                ImGui::BulletText("Material");
+
+                static float coll_friction_ui;
+
+                if(ImGui::InputFloat("Friction", &coll_friction_ui)){
+                    body_edited = true;
+                    selected_coll->friction = std::max(coll_friction_ui, 0.0f);
+                }else{
+                    coll_friction_ui = selected_coll->friction;
+                }
+
+                static float coll_restitution_ui;
+
+                if(ImGui::InputFloat("Restitution", &coll_restitution_ui)){
+                    body_edited = true;
+                    selected_coll->restitution = std::min(std::max(coll_restitution_ui, 0.0f), 1.0f);
+                }else{
+                    coll_restitution_ui = selected_coll->restitution;
+                }
+
             }
 
 
             // ====================================================================================
             // Rigidbody data
 
-            if (selected_go.rb != nullptr) {
+            if (selected_rb != nullptr) {
                 
                 ImGui::BulletText("Rigidbody");
 
@@ -355,11 +420,12 @@ void gui::render_gui(){
                 static float rb_vel_ui[2] = { 0.0f, 0.0f};
 
                 if(ImGui::InputFloat2("X-Y vel", rb_vel_ui)){
-                    selected_go.rb->vel_x = rb_vel_ui[0];
-                    selected_go.rb->vel_y = rb_vel_ui[1];
+                    body_edited = true;
+                    selected_rb->vel_x = rb_vel_ui[0];
+                    selected_rb->vel_y = rb_vel_ui[1];
                 }else{
-                    rb_vel_ui[0] = selected_go.rb->vel_x;
-                    rb_vel_ui[1] = selected_go.rb->vel_y;
+                    rb_vel_ui[0] = selected_rb->vel_x;
+                    rb_vel_ui[1] = selected_rb->vel_y;
                 }
 
                 // ------------------------------------------------------------------------------------
@@ -368,9 +434,10 @@ void gui::render_gui(){
                 static float rb_w_ui;
 
                 if(ImGui::InputFloat("w", &rb_w_ui)){
-                    selected_go.rb->w = rb_w_ui;
+                    body_edited = true;
+                    selected_rb->w = rb_w_ui;
                 }else{
-                    rb_w_ui = selected_go.rb->w;
+                    rb_w_ui = selected_rb->w;
                 }
 
                 // ------------------------------------------------------------------------------------
@@ -379,9 +446,10 @@ void gui::render_gui(){
                 static float rb_m_ui;
 
                 if(ImGui::InputFloat("Mass", &rb_m_ui)){
-                    selected_go.rb->m = rb_m_ui;
+                    body_edited = true;
+                    selected_rb->m = rb_m_ui;
                 }else{
-                    rb_m_ui = selected_go.rb->m;
+                    rb_m_ui = selected_rb->m;
                 }
 
                 // ------------------------------------------------------------------------------------
@@ -390,12 +458,21 @@ void gui::render_gui(){
                 static float rb_i_ui;
 
                 if(ImGui::InputFloat("Moment", &rb_i_ui)){
-                    selected_go.rb->I = rb_i_ui;
+                    body_edited = true;
+                    selected_rb->I = rb_i_ui;
                 }else{
-                    rb_i_ui = selected_go.rb->I;
+                    rb_i_ui = selected_rb->I;
                 }
 
             }
+
+            // ====================================================================================
+            // Send the edits to the simulation
+
+            if(body_edited){
+                simulation::set_body(selected_body);
+            }
+
             // ====================================================================================
             // 
 
@@ -449,34 +526,22 @@ void gui::render_gui(){
         static float tot_k_energy = 0.0f;
         tot_k_energy = 0;
 
-        for( int i = 0; i < game_data::boxGameobjects.size(); i++ ){
-            
-            physic::dim2::rigidbody& rb = game_data::boxGameobjects[i].rb;
-            vec2 vel2 = {rb.vel_x, rb.vel_y};
-            float vel = vec2_len(vel2);
-            float lin_k_energy = 0.5 * rb.m * vel * vel;
-            float ang_k_energy = 0.5 * rb.I * rb.w * rb.w;
+        const simulation::snapshot& snap = simulation::current_snapshot();
 
-            k_energy = lin_k_energy + ang_k_energy;
-
-            tot_k_energy += k_energy;
-
-            char buf[32];
-            sprintf(buf, "%d/%d", (int)(k_energy), 1000);
-            ImGui::ProgressBar(k_energy / 1000, ImVec2(0.0f, 0.0f), buf);
-            ImGui::SameLine(0.0f, ImGui::GetStyle().ItemInnerSpacing.x);
-            ImGui::Text("Id: %d", game_data::boxGameobjects[i].gameobject_id);
-
-        }
-
-        for( int i = 0; i < game_data::sphereGameobjects.size(); i++ ){
+        game_data::Each([&](game_data::Entity entity, game_data::PhysicBody& body){
             
-            physic::dim2::rigidbody& rb = game_data::sphereGameobjects[i].rb;
+            // Halfspaces are static, spheres don't rotate
+            const simulation::body_record* record = simulation::find_body(snap, body.body_id);
+            if(record == nullptr || record->shape.type == physic::dim2::collider::HALFSPACE)
+                return;
+
+            const physic::dim2::rigidbody& rb = record->rb;
             vec2 vel2 = {rb.vel_x, rb.vel_y};
             float vel = vec2_len(vel2);
             float lin_k_energy = 0.5 * rb.m * vel * vel;
+            float ang_k_energy = record->shape.type == physic::dim2::collider::SPHERE ? 0 : 0.5 * rb.I * rb.w * rb.w;
 
-            k_energy = lin_k_energy;
+            k_energy = lin_k_energy + ang_k_energy;
 
             tot_k_energy += k_energy;
 
@@ -484,9 +549,9 @@ void gui::render_gui(){
             sprintf(buf, "%d/%d", (int)(k_energy), 1000);
             ImGui::ProgressBar(k_energy / 1000, ImVec2(0.0f, 0.0f), buf);
             ImGui::SameLine(0.0f, ImGui::GetStyle().ItemInnerSpacing.x);
-            ImGui::Text("Id: %d", game_data::sphereGameobjects[i].gameobject_id);
+            ImGui::Text("Id: %d", entity);
 
-        }
+        }, game_data::physicBodies);
 
         // Total system kinetic energy
         ImGui::Text("Tot k-energy: %f ", tot_k_energy);
@@ -604,6 +669,43 @@ void gui::render_gui(){
 
             // Pop styles configurations from the stack
             ImGui::PopStyleColor(3);
+
+            // ====================================================================================
+            // Manage the rewind timeline:
+            // Slider over the recorded frames at the bottom of the scene image; dragging it pauses 
+            // the simulation and brings the world back to the selected frame.
+
+            const simulation::snapshot& snap = simulation::current_snapshot();
+
+            if(snap.rewind_frames > 0){
+
+                float timeline_height = ImGui::GetFrameHeight();
+                ImVec2 timelinePos = ImVec2(
+                    std::max( ImGui::GetWindowPos().x , imagePos.x),
+                    imagePos.y + parameters.scene_window.inner_img_pixel_height - timeline_height - 4
+                );
+                ImGui::SetCursorScreenPos(timelinePos);
+                ImGui::SetNextItemWidth(std::min(parameters.scene_window.inner_img_pixel_width, windowSize.x));
+
+                // While the slider is dragged it keeps its value, otherwise it follows the simulation
+                static int timeline_frame = 0;
+                static bool timeline_dragged = false;
+                if(!timeline_dragged)
+                    timeline_frame = snap.rewind_cursor;
+
+                std::string label = "Step " + std::to_string(snap.rewind_first_step + timeline_frame) 
+                    + "  (" + std::to_string(snap.rewind_memory / 1024) + " KB)";
+
+                if(ImGui::SliderInt("##RewindTimeline", &timeline_frame, 0, snap.rewind_frames - 1, label.c_str())){
+                    
+                    if(simulation::requested_settings.running){
+                        simulation::requested_settings.running = false;
+                        simulation::set_settings(simulation::requested_settings);
+                    }
+                    simulation::seek_frame(timeline_frame);
+                }
+                timeline_dragged = ImGui::IsItemActive();
+            }
             
         }
         ImGui::EndChild();
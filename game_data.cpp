@@ -1,18 +1,24 @@
 #include <cassert>
 #include "game_data.h"
+#include "simulation.h"
 #include <iostream>
+#include <algorithm>
+#include <memory>
+#include <string>
 
-std::vector<game_data::BoxGameObject> game_data::boxGameobjects;
-std::vector<game_data::SphereGameObject> game_data::sphereGameobjects;
-std::vector<game_data::HalfSpaceGameObject> game_data::halfSpaceGameobjects;
-std::vector<game_data::BoxGameObject> game_data::stashedBoxGameobjects;
-std::vector<game_data::SphereGameObject> game_data::stashedSphereGameobjects;
-std::vector<game_data::HalfSpaceGameObject> game_data::stashedHalfSpaceGameobjects;
+game_data::ComponentPool<game_data::Transform> game_data::transforms;
+game_data::ComponentPool<game_data::PhysicBody> game_data::physicBodies;
+game_data::ComponentPool<game_data::QuadRenderer> game_data::quadRenderers;
+game_data::ComponentPool<game_data::SphereRenderer> game_data::sphereRenderers;
+game_data::ComponentPool<game_data::PlaneRenderer> game_data::planeRenderers;
+game_data::GameState game_data::stashedState;
 
 bool game_data::event_is_dragging_active = false;
-game_data::AliasGameObject game_data::draggedGameObject;
+game_data::Entity game_data::draggedEntity = game_data::NullEntity;
 
 int next_gameobject_id;
+int streamed_entity_limit = 0;                  // entities below it follow the streamed bodies, 0 when not streaming
+static std::vector<game_data::Entity> streamed_gone_scratch;
 
 /* std::map<int, physic::impulse> game_data::starting_impulses; */
 
@@ -25,22 +31,40 @@ bool game_data::debug_draw_impulses = false;
 
 std::vector<game_data::contact_circle_animation> game_data::contact_circle_animations;
 
-void game_data::AddBoxGameObject(){
+game_data::Entity game_data::CreateEntity(){
+    return next_gameobject_id++;
+}
+
+void game_data::DestroyEntity(Entity entity){
 
-    boxGameobjects.push_back({});
-    stashedBoxGameobjects.push_back({});
+    if(PhysicBody* body = Get(physicBodies, entity))
+        simulation::remove_body(body->body_id);
+
+    if(draggedEntity == entity){
+        draggedEntity = NullEntity;
+        event_is_dragging_active = false;
+    }
+
+    Remove(transforms, entity);
+    Remove(physicBodies, entity);
+    Remove(quadRenderers, entity);
+    Remove(sphereRenderers, entity);
+    Remove(planeRenderers, entity);
+}
+
+game_data::Entity game_data::AddBoxGameObject(){
 
     // ------------------------------------------------------------------------------------
-    // Initialize the new object data
+    // Initialize the new object components
+
+    Entity box_go = CreateEntity();
 
-    // Setup Gameobject fields
-    BoxGameObject& box_go = boxGameobjects[boxGameobjects.size()-1];
-    
-    box_go.gameobject_id = next_gameobject_id;
-    box_go.render_outline = false;
+    Emplace(transforms, box_go);
+    Emplace(quadRenderers, box_go);
+    PhysicBody& body = Emplace(physicBodies, box_go, {box_go});
 
     // Setup Gameobject box rigidbody
-    physic::dim2::rigidbody& rb = box_go.rb;
+    physic::dim2::rigidbody rb;
     rb.angle = 0;
     rb.I = 1;
     rb.m = 1;
@@ -51,34 +75,31 @@ void game_data::AddBoxGameObject(){
     rb.w = 0;
 
     // Setup Gameobject box collider
-    physic::dim2::collider_box & coll = box_go.coll;
+    physic::dim2::collider_box coll;
     coll.width = 1;
     coll.height = 1;
-    
-    // ------------------------------------------------------------------------------------
-    // Increase the counter for game objects ids:
-    
-    next_gameobject_id++;
-}
 
-void game_data::AddSphereGameObject(){
+    simulation::set_body(body.body_id, &rb, coll);
+
+    return box_go;
+}
 
-    sphereGameobjects.push_back({});
-    stashedSphereGameobjects.push_back({});
+game_data::Entity game_data::AddSphereGameObject(){
 
     // ------------------------------------------------------------------------------------
-    // Initialize the new object data
+    // Initialize the new object components
 
-    // Setup Gameobject fields
-    SphereGameObject& sphere_go = sphereGameobjects[sphereGameobjects.size()-1];
-    
-    sphere_go.gameobject_id = next_gameobject_id;
-    sphere_go.render_outline = false;
-    sphere_go.world_x_scale = 0.5;
-    sphere_go.world_y_scale = 0.5;
+    Entity sphere_go = CreateEntity();
 
-    // Setup Gameobject box rigidbody
-    physic::dim2::rigidbody& rb = sphere_go.rb;
+    Transform& transform = Emplace(transforms, sphere_go);
+    transform.world_x_scale = 0.5;
+    transform.world_y_scale = 0.5;
+
+    Emplace(sphereRenderers, sphere_go);
+    PhysicBody& body = Emplace(physicBodies, sphere_go, {sphere_go});
+
+    // Setup Gameobject sphere rigidbody
+    physic::dim2::rigidbody rb;
     rb.angle = 0;
     rb.I = 1;
     rb.m = 1;
@@ -88,37 +109,272 @@ void game_data::AddSphereGameObject(){
     rb.vel_y = 0;
     rb.w = 0;
 
-    // Setup Gameobject box collider
-    physic::dim2::collider_sphere & coll = sphere_go.coll;
+    // Setup Gameobject sphere collider
+    physic::dim2::collider_sphere coll;
     coll.radius = 0.5;
-    
+
+    simulation::set_body(body.body_id, &rb, coll);
+
+    return sphere_go;
+}
+
+game_data::Entity game_data::AddHalfspaceObject(float normal_x, float normal_y, float origin_offset){
+
     // ------------------------------------------------------------------------------------
-    // Increase the counter for game objects ids:
-    
-    next_gameobject_id++;
+    // Initialize the new object components
+
+    Entity halfspace_go = CreateEntity();
+
+    Emplace(planeRenderers, halfspace_go);
+    PhysicBody& body = Emplace(physicBodies, halfspace_go, {halfspace_go});
+
+    // Setup Gameobject halfspace collider
+    physic::dim2::collider_halfspace coll;
+    coll.normal_x = normal_x;
+    coll.normal_y = normal_y;
+    coll.origin_offset = origin_offset;
+
+    simulation::set_body(body.body_id, nullptr, coll);
+
+    return halfspace_go;
 }
 
-void game_data::AddHalfspaceObject(){
+void game_data::SetRenderOutline(Entity entity, bool render_outline){
 
-    halfSpaceGameobjects.push_back({});
+    if(QuadRenderer* quad = Get(quadRenderers, entity))
+        quad->render_outline = render_outline;
 
-    // ------------------------------------------------------------------------------------
-    // Initialize the new object data
+    if(SphereRenderer* sphere = Get(sphereRenderers, entity))
+        sphere->render_outline = render_outline;
+}
 
-    // Setup Gameobject fields
-    HalfSpaceGameObject& halfspace_go = halfSpaceGameobjects[halfSpaceGameobjects.size()-1];
-    
-    halfspace_go.gameobject_id = next_gameobject_id;
+// ====================================================================================
+// Stash and load
 
-    // Setup Gameobject box collider
-    physic::dim2::collider_halfspace & coll = halfspace_go.coll;
-    coll.normal_x = 0;
-    coll.normal_y = 1;
-    coll.origin_offset = 0;
-    
-    // ------------------------------------------------------------------------------------
-    // Increase the counter for game objects ids:
-    
-    next_gameobject_id++;
+template<typename Archive, typename T>
+static void VisitPool(Archive& ar, game_data::ComponentPool<T>& pool){
+    ar.column(pool.sparse);
+    ar.column(pool.dense);
+    ar.column(pool.components);
+}
+
+template<typename Archive>
+static void VisitGameState(Archive& ar){
+    ar.value(next_gameobject_id);
+    VisitPool(ar, game_data::transforms);
+    VisitPool(ar, game_data::physicBodies);
+    VisitPool(ar, game_data::quadRenderers);
+    VisitPool(ar, game_data::sphereRenderers);
+    VisitPool(ar, game_data::planeRenderers);
+}
+
+void game_data::StashScenario(){
+
+    physic::dim2::blob_sizer sizer;
+    VisitGameState(sizer);
+
+    if(stashedState.blob.size() * physic::dim2::blob_alignment < sizer.size)
+        stashedState.blob.resize(sizer.size / physic::dim2::blob_alignment);
+    stashedState.size = sizer.size;
+
+    physic::dim2::blob_writer writer;
+    writer.cursor = reinterpret_cast<unsigned char*>(stashedState.blob.data());
+    VisitGameState(writer);
+
+    simulation::save_state();
+}
+
+void game_data::LoadStashedScenario(){
+
+    if(stashedState.size == 0)
+        return;
+
+    physic::dim2::blob_reader reader;
+    reader.cursor = reinterpret_cast<const unsigned char*>(stashedState.blob.data());
+    reader.end = reader.cursor + stashedState.size;
+    VisitGameState(reader);
+
+    draggedEntity = NullEntity;
+    event_is_dragging_active = false;
+
+    simulation::restore_state();
+}
+
+
+// ====================================================================================
+// Scene files
+
+static bool IsTextScene(const std::string& path){
+    return path.size() >= 4 && path.compare(path.size() - 4, 4, ".txt") == 0;
+}
+
+bool game_data::SaveScene(const char* path){
+
+    const simulation::snapshot& snap = simulation::current_snapshot();
+
+    physic::dim2::body_storage bodies;
+    Each([&](Entity, PhysicBody& body){
+
+        const simulation::body_record* record = simulation::find_body(snap, body.body_id);
+        if(record == nullptr)
+            return;
+
+        bool is_static = record->shape.type == physic::dim2::collider::HALFSPACE;
+        physic::dim2::add_body(bodies, record->id, is_static ? nullptr : &record->rb, physic::dim2::shape_collider(record->shape));
+
+    }, physicBodies);
+
+    if(IsTextScene(path))
+        return physic::dim2::write_scene_text(path, bodies);
+    return physic::dim2::write_scene(path, bodies);
+}
+
+template<typename T>
+static void ClearPool(game_data::ComponentPool<T>& pool, int capacity){
+    pool = game_data::ComponentPool<T>{};
+    pool.dense.reserve(capacity);
+    pool.components.reserve(capacity);
+}
+
+// Closed by whichever thread drops it last
+static std::shared_ptr<physic::dim2::scene_file> OpenSceneFile(const char* path){
+
+    std::shared_ptr<physic::dim2::scene_file> scene(new physic::dim2::scene_file, [](physic::dim2::scene_file* file){
+        physic::dim2::close_scene(*file);
+        delete file;
+    });
+
+    std::string error;
+    bool opened = IsTextScene(path)
+        ? physic::dim2::open_scene_text(path, *scene, &error)
+        : physic::dim2::open_scene(path, *scene);
+
+    if(!opened){
+        std::cerr << "Error opening scene " << path << " " << error << std::endl << std::flush;
+        return nullptr;
+    }
+
+    return scene;
+}
+
+static void ClearGameObjects(int capacity){
+
+    ClearPool(game_data::transforms, capacity);
+    ClearPool(game_data::physicBodies, capacity);
+    ClearPool(game_data::quadRenderers, capacity);
+    ClearPool(game_data::sphereRenderers, capacity);
+    ClearPool(game_data::planeRenderers, capacity);
+
+    game_data::draggedEntity = game_data::NullEntity;
+    game_data::event_is_dragging_active = false;
+}
+
+// Gameobject of a scene body, with the id of the body: the components follow the shape
+static void EmplaceBodyGameObject(game_data::Entity entity, const physic::dim2::collider_shape& shape, float x, float y, float angle){
+
+    using namespace game_data;
+
+    Emplace(physicBodies, entity, {entity});
+
+    if(shape.type == physic::dim2::collider::HALFSPACE){
+        Emplace(planeRenderers, entity);
+        return;
+    }
+
+    Transform& transform = Emplace(transforms, entity);
+    transform.world_x_pos = x;
+    transform.world_y_pos = y;
+    transform.world_z_angle = angle;
+
+    if(shape.type == physic::dim2::collider::BOX){
+        transform.world_x_scale = shape.box.width;
+        transform.world_y_scale = shape.box.height;
+        Emplace(quadRenderers, entity);
+    }else{
+        transform.world_x_scale = shape.sphere.radius;
+        transform.world_y_scale = shape.sphere.radius;
+        Emplace(sphereRenderers, entity);
+    }
+}
+
+bool game_data::LoadScene(const char* path){
+
+    std::shared_ptr<physic::dim2::scene_file> scene = OpenSceneFile(path);
+    if(!scene)
+        return false;
+
+    const physic::dim2::scene_view& view = scene->view;
+    ClearGameObjects(view.body_count);
+
+    next_gameobject_id = 0;
+    streamed_entity_limit = 0;
+
+    for(int row = 0; row < view.body_count; row++){
+        EmplaceBodyGameObject(view.id[row], view.shape[row], view.pos_x[row], view.pos_y[row], view.angle[row]);
+        next_gameobject_id = std::max(next_gameobject_id, view.id[row] + 1);
+    }
+
+    simulation::load_scene(scene);
+    return true;
+}
+
+// ====================================================================================
+// Streamed scenes
+
+bool game_data::StreamScene(const char* path, float chunk_size){
+
+    std::shared_ptr<physic::dim2::scene_file> scene = OpenSceneFile(path);
+    if(!scene)
+        return false;
+
+    ClearGameObjects(0);
+
+    // New gameobjects get ids past the ones of the scene
+    next_gameobject_id = 0;
+    for(int row = 0; row < scene->view.body_count; row++)
+        next_gameobject_id = std::max(next_gameobject_id, scene->view.id[row] + 1);
+    streamed_entity_limit = next_gameobject_id;
+
+    simulation::stream_scene(scene, path, chunk_size);
+    return true;
+}
+
+// The bodies left the world on the sim thread: only the components go, no remove_body
+static void RemoveStreamedGameObject(game_data::Entity entity){
+
+    using namespace game_data;
+
+    if(draggedEntity == entity){
+        draggedEntity = NullEntity;
+        event_is_dragging_active = false;
+    }
+
+    Remove(transforms, entity);
+    Remove(physicBodies, entity);
+    Remove(quadRenderers, entity);
+    Remove(sphereRenderers, entity);
+    Remove(planeRenderers, entity);
+}
+
+void game_data::SyncStreamedGameObjects(const simulation::snapshot& snap){
+
+    // A snapshot published before the stream started still holds the bodies of the old scene
+    if(streamed_entity_limit == 0 || !snap.streaming)
+        return;
+
+    for( auto& record : snap.bodies ){
+        if(record.id >= streamed_entity_limit)
+            break;                                  // sorted by id
+        if(!Has(physicBodies, record.id))
+            EmplaceBodyGameObject(record.id, record.shape, record.rb.pos_x, record.rb.pos_y, record.rb.angle);
+    }
+
+    std::vector<Entity>& gone = streamed_gone_scratch;
+    gone.clear();
+    for(Entity entity : physicBodies.dense)
+        if(entity < streamed_entity_limit && simulation::find_body(snap, entity) == nullptr)
+            gone.push_back(entity);
 
+    for(Entity entity : gone)
+        RemoveStreamedGameObject(entity);
 }
\ No newline at end of file
@@ -24,9 +24,7 @@ namespace gui{
 
     extern gui_parameters parameters;
 
-    extern int selected_box_array_pos;
-    extern int selected_sphere_array_pos;
-    extern int selected_halfspace_array_pos;
+    extern int selected_entity;                 // game_data::Entity, NullEntity if nothing is selected
 
     extern int game_object_list_selected_element_id;
 
@@ -1,4 +1,5 @@
 #include "physic.h"
+#include "simulation.h"
 #include <utility>
 #include <vector>
 #include <array>
@@ -13,77 +14,204 @@ namespace game_data{
 
     //=================================================================================================================
 
-    //                                            GAME OBJECTS DEFINITION
+    //                                          ENTITY COMPONENT STORAGE
 
     //=================================================================================================================
-    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-    struct BoxGameObject{
-        int gameobject_id;
+    // A gameobject is an entity: just an id. Its data is split in components, each component type stored in its own
+    // sparse set (ComponentPool):
+    //  - sparse: entity id -> index of its component in the packed arrays (-1 if the entity hasn't the component)
+    //  - dense / components: packed arrays of owner entities and components, iterated without holes
+    // Add, remove and lookup are O(1); removing swaps the last component in the hole, so the packed arrays never
+    // have gaps (and pointers to components are valid only until the next add or remove on the same pool).
+    // Systems iterate only the pools of the components they read (see Each), so a new shape or render component
+    // is a new pool and a new loop, none of the existing loops change.
+
+    typedef int Entity;
+    const Entity NullEntity = -1;
+
+    template<typename T>
+    struct ComponentPool{
+        std::vector<int> sparse;
+        std::vector<Entity> dense;
+        std::vector<T> components;
+    };
 
-        bool render_outline;
+    template<typename T>
+    bool Has(const ComponentPool<T>& pool, Entity entity){
+        return entity >= 0 && entity < (int) pool.sparse.size() && pool.sparse[entity] != -1;
+    }
+
+    // nullptr if the entity hasn't the component
+    template<typename T>
+    T* Get(ComponentPool<T>& pool, Entity entity){
+        return Has(pool, entity) ? &pool.components[pool.sparse[entity]] : nullptr;
+    }
+
+    // Add the component to the entity (overwrite it if the entity already has one)
+    template<typename T>
+    T& Emplace(ComponentPool<T>& pool, Entity entity, const T& component = T{}){
+
+        if(Has(pool, entity)){
+            T& existing = pool.components[pool.sparse[entity]];
+            existing = component;
+            return existing;
+        }
+
+        if(entity >= (int) pool.sparse.size())
+            pool.sparse.resize(entity + 1, -1);
+
+        pool.sparse[entity] = (int) pool.dense.size();
+        pool.dense.push_back(entity);
+        pool.components.push_back(component);
+        return pool.components.back();
+    }
+
+    // Swap and pop: the last component takes the place of the removed one
+    template<typename T>
+    void Remove(ComponentPool<T>& pool, Entity entity){
+
+        if(!Has(pool, entity))
+            return;
+
+        int index = pool.sparse[entity];
+        Entity last = pool.dense.back();
+
+        pool.dense[index] = last;
+        pool.components[index] = pool.components.back();
+        pool.sparse[last] = index;
+
+        pool.dense.pop_back();
+        pool.components.pop_back();
+        pool.sparse[entity] = -1;
+    }
+
+    template<typename T>
+    int Size(const ComponentPool<T>& pool){
+        return (int) pool.dense.size();
+    }
+
+    inline bool HasAll(Entity){
+        return true;
+    }
+
+    template<typename T, typename... Others>
+    bool HasAll(Entity entity, const ComponentPool<T>& pool, const ComponentPool<Others>&... others){
+        return Has(pool, entity) && HasAll(entity, others...);
+    }
 
-        float world_x_scale = 1;
-        float world_y_scale = 1;
-        float world_x_pos = 0;
-        float world_y_pos = 0;
-        float world_z_angle = 0;   
+    // ====================================================================================
+    // View:
+    // Call fn(entity, lead_component, other_components...) for every entity that has all the components.
+    // The packed array of the first pool drives the iteration (the others are only looked up): pass the
+    // smallest pool first. fn must not add or remove components of the iterated pools.
+
+    template<typename T, typename... Others, typename Fn>
+    void Each(Fn fn, ComponentPool<T>& lead, ComponentPool<Others>&... others){
+        for(int i = 0; i < (int) lead.dense.size(); i++){
+            Entity entity = lead.dense[i];
+            if(HasAll(entity, others...))
+                fn(entity, lead.components[i], *Get(others, entity)...);
+        }
+    }
 
-        physic::dim2::rigidbody rb;
-        physic::dim2::collider_box coll;
-        
-    };
+    //=================================================================================================================
 
-    struct SphereGameObject{
-        int gameobject_id;
+    //                                            COMPONENTS DEFINITION
 
-        bool render_outline;
+    //=================================================================================================================
 
+    // Rendered transform, interpolated from the snapshots of the simulation
+    struct Transform{
         float world_x_scale = 1;
         float world_y_scale = 1;
         float world_x_pos = 0;
         float world_y_pos = 0;
-        float world_z_angle = 0;   
+        float world_z_angle = 0;
+    };
 
-        physic::dim2::rigidbody rb;
-        physic::dim2::collider_sphere coll;
+    // Body simulated in the world of the simulation thread (see simulation.h). The rigidbody and the
+    // collider are read from the snapshots and every change is sent with simulation::set_body.
+    struct PhysicBody{
+        int body_id;                    // handle of the body in the simulation world
+    };
 
+    // Textured quad (boxes)
+    struct QuadRenderer{
+        bool render_outline = false;
     };
 
-    struct HalfSpaceGameObject{
-        int gameobject_id;
-        physic::dim2::collider_halfspace coll;
+    // Textured circle (spheres)
+    struct SphereRenderer{
+        bool render_outline = false;
     };
 
-    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    // Debug lines of the plane of a halfspace body
+    struct PlaneRenderer{
+    };
 
     //=================================================================================================================
 
     //                                          GAME OBJECTS MEMORY
 
     //=================================================================================================================
-    // Box Gameobject
-    
-    extern std::vector<BoxGameObject> boxGameobjects;
-    extern std::vector<BoxGameObject> stashedBoxGameobjects;
 
-    void AddBoxGameObject();
+    extern ComponentPool<Transform> transforms;
+    extern ComponentPool<PhysicBody> physicBodies;
+    extern ComponentPool<QuadRenderer> quadRenderers;
+    extern ComponentPool<SphereRenderer> sphereRenderers;
+    extern ComponentPool<PlaneRenderer> planeRenderers;
+
+    Entity CreateEntity();
+
+    // Remove the entity components and despawn its simulation body (ids are not reused: a snapshot published
+    // before the removal still holds the old body)
+    void DestroyEntity(Entity entity);
+
+    // ------------------------------------------------------------------------------------
+    // Gameobjects: the Add functions create the entity and send its body to the simulation
+
+    Entity AddBoxGameObject();
+    Entity AddSphereGameObject();
+    Entity AddHalfspaceObject(float normal_x = 0, float normal_y = 1, float origin_offset = 0);
+
+    // Highlight the entity in every renderer it has
+    void SetRenderOutline(Entity entity, bool render_outline);
 
     // ------------------------------------------------------------------------------------
-    // Sphere Gameobject
+    // Stash and load of the whole scenario:
+    // The component pools are saved in one contiguous blob (bulk copies of the packed arrays) while the
+    // sim thread saves its world; loading restores both. Entities created after the stash disappear
+    // together with their bodies.
+
+    struct GameState{
+        std::vector<std::max_align_t> blob;
+        size_t size = 0;
+    };
 
-    extern std::vector<SphereGameObject> sphereGameobjects;
-    extern std::vector<SphereGameObject> stashedSphereGameobjects;
+    extern GameState stashedState;
 
-    void AddSphereGameObject();
+    void StashScenario();
+    void LoadStashedScenario();
 
     // ------------------------------------------------------------------------------------
-    // Halfspace Gameobjects
+    // Scene files (see physic::dim2::scene_file):
+    // Saving writes the body of every gameobject as the last snapshot shows it (bodies not simulated yet
+    // are skipped). Loading maps the file, replaces every gameobject with one per body of the scene (the
+    // components follow the shape: quad, sphere or plane) and sends the mapped scene to the simulation.
+    // Paths ending in .txt are text scenes, loaded through their binary cache.
 
-    extern std::vector<HalfSpaceGameObject> halfSpaceGameobjects;
-    extern std::vector<HalfSpaceGameObject> stashedHalfSpaceGameobjects;
+    bool SaveScene(const char* path);
+    bool LoadScene(const char* path);
 
-    void AddHalfspaceObject();
+    // ------------------------------------------------------------------------------------
+    // Streamed scenes (see simulation::stream_scene):
+    // Only the chunks around the camera are simulated. The gameobjects of the scene follow the snapshots:
+    // SyncStreamedGameObjects, called every frame, creates the gameobjects of the bodies that entered the
+    // world and drops the ones whose bodies left it. Gameobjects added afterwards are not streamed,
+    // their bodies stay in the world.
+
+    bool StreamScene(const char* path, float chunk_size);
+    void SyncStreamedGameObjects(const simulation::snapshot& snap);
 
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
     //                                       UTILITY GAME DATA DECLARATIONS
@@ -112,23 +240,7 @@ namespace game_data{
 
     extern bool event_is_dragging_active;
 
-    struct AliasGameObject{
-        int* gameobject_id = nullptr;
-
-        bool* render_outline = nullptr;
-
-        float* world_x_scale = nullptr;
-        float* world_y_scale = nullptr;
-        float* world_x_pos = nullptr;
-        float* world_y_pos = nullptr;
-        float* world_z_angle = nullptr;   
-
-        physic::dim2::rigidbody* rb = nullptr;
-        physic::dim2::collider* coll = nullptr;
-
-    };
-
-    extern AliasGameObject draggedGameObject;
+    extern Entity draggedEntity;
     
     // ====================================================================================
     // Data for managing simulation running
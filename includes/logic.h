@@ -31,6 +31,10 @@ namespace inputs{
     extern button_state stash_scenario_configuration_button;
     extern button_state load_stashed_scenario_configuration_button;
 
+    // Camera pan direction from the arrow keys held: -1, 0 or 1 on each axis
+    extern int camera_pan_x;
+    extern int camera_pan_y;
+
     bool check_if_click_is_on_scene();
     void convert_screen_pixel_coords_to_ndc(double& out_x_ndc, double& out_y_ndc, float x_pixel, float y_pixel);
     void convert_ndc_coords_to_world(float& out_x_world, float& out_y_world, float x_ndc, float y_ndc);
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "physic.h"
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+namespace simulation{
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    //                                            SIMULATION THREAD
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    // The physics world is owned and stepped by a dedicated thread, so a slow GUI frame or a stall on the
+    // swap buffers no longer delays the simulation (and a slow step no longer delays the rendering).
+    //
+    //  - Sim thread -> main thread: after the steps of every iteration the sim thread publishes an immutable
+    //    snapshot of the bodies (and of the contacts for the debug draw) through a lock-free triple buffer.
+    //    The main thread takes the newest snapshot once per frame and reads the poses from it.
+    //
+    //  - Main thread -> sim thread: the editor edits, the dragging, the new gameobjects and the solver
+    //    settings are pushed as commands on a queue; the sim thread applies them only between two steps.
+    //
+    // The main thread never touches the world and the physic globals (contacts, solver data) while the
+    // sim thread runs. The gameobjects only know the id of their body: every read goes through the
+    // snapshot and every write through a command.
+
+    // ====================================================================================
+    // Body record:
+    // Full state of a body as the simulation knows it, read from a row of the world body storage; the
+    // payload of the body commands and the elements of the snapshots. Halfspaces are static, their rb
+    // is unused.
+
+    struct body_record{
+        int id;
+        physic::dim2::rigidbody rb;
+        physic::dim2::collider_shape shape;
+    };
+
+    // ====================================================================================
+    // Snapshot:
+    // State published at the end of an iteration of the sim thread. Bodies are sorted by id.
+    // Contact points are already in world space, the main thread can't read the body rows.
+
+    struct contact_record{
+        float qa_x, qa_y;
+        float qb_x, qb_y;
+        float n_x, n_y;
+    };
+
+    struct snapshot{
+        std::vector<body_record> bodies;
+        std::vector<contact_record> contacts;
+
+        uint64_t step_count = 0;
+        uint64_t checksum = 0;
+
+        // Rewind timeline (see physic::dim2::rewind_buffer): frames recorded, frame of the current state
+        // and step of the oldest frame
+        int rewind_frames = 0;
+        int rewind_cursor = -1;
+        uint64_t rewind_first_step = 0;
+        size_t rewind_memory = 0;
+
+        // Step arena usage in bytes (see physic::dim2::step_arena)
+        size_t arena_last_step = 0;
+        size_t arena_high_water = 0;
+        size_t arena_capacity = 0;
+
+        // Chunk streaming (see streaming.h), zero when no scene is streamed
+        bool streaming = false;
+        int stream_loaded_chunks = 0;
+        int stream_pending_jobs = 0;
+        int stream_stored_bodies = 0;
+
+        double time = 0;                                        // clock_seconds() at the end of the last step
+        float fixed_delta_time = 1.0f / 60.0f;
+        bool running = true;
+    };
+
+    // Body with the given id, nullptr if the simulation doesn't know it yet
+    const body_record* find_body(const snapshot& snap, int id);
+
+    // Interpolation factor for the poses of the snapshot at the time now: the rendering lags one step
+    // behind the simulation and moves from the previous to the last pose while the next step is computed
+    float render_alpha(const snapshot& snap, double now);
+
+    double clock_seconds();
+
+    // ====================================================================================
+    // Triple buffer:
+    // Three snapshots: the writer fills back, the reader holds front and the third (middle) is the last
+    // one published. Publishing swaps back with middle and sets the fresh bit; the reader swaps front with
+    // middle only if the fresh bit is set. Neither side ever waits and the reader always gets the newest
+    // complete snapshot (intermediate ones are skipped).
+
+    struct triple_buffer{
+        snapshot slots[3];
+
+        std::atomic<int> middle{1};                             // index of the middle slot | fresh_bit
+        int back = 0;                                           // writer only
+        int front = 2;                                          // reader only
+    };
+
+    const int fresh_bit = 4;
+
+    snapshot& begin_write(triple_buffer& buffer);
+    void publish(triple_buffer& buffer);
+    const snapshot& read_latest(triple_buffer& buffer);
+
+    // ====================================================================================
+    // Settings of the world and of the scheduler, applied by the sim thread
+
+    struct settings{
+        bool running = true;
+
+        physic::dim2::world::solver_mode mode = physic::dim2::world::IMPULSE;
+        int velocity_iterations = 8;
+        int xpbd_substeps = 8;
+
+        float gravity_x = 0, gravity_y = -9.81f;
+
+        bool deterministic = false;
+        float fixed_delta_time = 1.0f / 60.0f;
+        int max_steps_per_frame = 5;
+
+        bool record_rewind = true;                              // record every step in the rewind buffer
+    };
+
+    // Settings edited by the GUI (main thread); send them with set_settings
+    extern settings requested_settings;
+
+    // ====================================================================================
+    // Commands
+
+    struct command{
+        enum command_type {SET_BODY, REMOVE_BODY, SET_SETTINGS, STEP_ONCE, SAVE_STATE, RESTORE_STATE, SEEK_FRAME, LOAD_SCENE, STREAM_SCENE};
+        command_type type;
+
+        int frame = 0;                                          // SEEK_FRAME
+        std::shared_ptr<const physic::dim2::scene_file> scene;  // LOAD_SCENE, STREAM_SCENE
+        std::string path;                                       // STREAM_SCENE
+        float chunk_size = 0;                                   // STREAM_SCENE
+
+        body_record body;                                       // SET_BODY: inserted or overwritten by id, REMOVE_BODY: only the id
+        settings new_settings;                                  // SET_SETTINGS
+    };
+
+    void push_command(const command& cmd);
+
+    // Insert or overwrite the body with the state the editor sees (rb nullptr for the static ones)
+    void set_body(int id, const physic::dim2::rigidbody* rb, const physic::dim2::collider& coll);
+    void set_body(const body_record& record);
+
+    // Despawn the body; its id can be sent again with set_body right after, even in the same frame
+    void remove_body(int id);
+
+    // Save the whole world in the sim thread (one contiguous blob, see physic::dim2::world_state) and
+    // bring it back; the solver settings are not part of it. Restoring without a saved state does nothing.
+    void save_state();
+    void restore_state();
+
+    // Bring the world back to a frame of the rewind timeline (0 = oldest); stepping again from there
+    // drops the frames after it. Pause the simulation first, or it steps away right after.
+    void seek_frame(int frame);
+
+    // Replace every body of the world with the ones of the mapped scene (see physic::dim2::scene_file);
+    // the mapping is read by both threads and closed when the last of them drops it. The rewind
+    // timeline starts over.
+    void load_scene(const std::shared_ptr<const physic::dim2::scene_file>& scene);
+
+    // Replace every body of the world with the chunks of the scene around the stream focus, loaded and
+    // unloaded in the background while the focus moves (see streaming.h); the chunk files are written
+    // next to path. Loading a scene or stopping the simulation ends the streaming. While streaming,
+    // restore_state and seek_frame do nothing: the bodies on disk are not part of the world state.
+    void stream_scene(const std::shared_ptr<const physic::dim2::scene_file>& scene, const std::string& path, float chunk_size);
+
+    // Center (the camera) and radius of the streamed area; can be called every frame, it's not a command
+    void set_stream_focus(float x, float y, float view_radius);
+
+    void set_settings(const settings& new_settings);
+    void step_once();
+
+    // ====================================================================================
+    // Thread control and snapshot access (main thread)
+
+    // The job system must be started before and stopped after the simulation.
+    // The world is preallocated for body_capacity bodies: below it spawning and despawning never allocate.
+    void start(int body_capacity = 1024);
+    void stop();
+
+    // Take the newest published snapshot; valid until the next call
+    const snapshot& read_snapshot();
+
+    // Snapshot taken by the last read_snapshot
+    const snapshot& current_snapshot();
+}
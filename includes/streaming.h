@@ -0,0 +1,65 @@
+#pragma once
+
+#include "physic.h"
+
+#include <memory>
+#include <string>
+#include <cstdint>
+
+namespace streaming{
+
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    //                                         CHUNKED WORLD STREAMING
+    ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    // A scene too big to simulate whole is split in square chunks of chunk_size world units; only the chunks
+    // around the focus (the camera) are in the world, the others wait on disk as binary scene files next
+    // to the scene (path + ".chunk_x_y", see physic::dim2::write_scene).
+    //
+    //  - The files are read and written only by the streaming thread. The sim thread queues the jobs (load,
+    //    store) and picks up the loaded chunks between two steps: a step never waits for the disk.
+    //
+    //  - A body belongs to the chunk its center is in, checked every update: a body that crosses from a
+    //    loaded chunk into another loaded one just keeps being simulated; one that crosses into a chunk
+    //    that isn't loaded is stored in that chunk (merged in its file) and comes back when it loads.
+    //    Unloading a chunk stores every body inside it at that moment.
+    //
+    //  - Loading a chunk deletes its file: a body is always either in the world or in exactly one file.
+    //    The jobs run in order, so a load queued after a store reads what the store wrote.
+    //
+    //  - Halfspaces don't belong to any chunk: they are loaded once and stay in the world. So do the bodies
+    //    added after begin (ids past the ones of the scene).
+    //
+    // The chunk files are a working copy of the scene made by begin (the scene file itself is never
+    // written) and are deleted by end: the state of the unloaded chunks is lost with them.
+    // Only the sim thread calls these functions.
+
+    // Chunk coordinates packed in one key: x in the high 32 bits, y in the low ones
+    inline int64_t chunk_key(int x, int y){ return (int64_t) (((uint64_t) (uint32_t) x << 32) | (uint32_t) y); }
+    inline int chunk_x(int64_t key){ return (int) (uint32_t) ((uint64_t) key >> 32); }
+    inline int chunk_y(int64_t key){ return (int) (uint32_t) key; }
+
+    int64_t chunk_of(float x, float y, float chunk_size);
+
+    // Start the streaming thread and queue the split of the scene in chunk files; the halfspaces enter
+    // the world with the first update
+    void begin(const std::shared_ptr<const physic::dim2::scene_file>& scene, const std::string& path, float chunk_size);
+
+    // Delete the chunk files and stop the streaming thread (waits for the queued jobs); the bodies in the
+    // world stay there
+    void end();
+
+    bool active();
+
+    // Between two steps: add the loaded chunks to the world, queue the loads of the chunks within view_radius
+    // of the focus and the unloads of the ones past it (plus one chunk of margin), store the bodies that
+    // are in chunks not loaded. True if bodies entered or left the world (their rows and handles changed).
+    bool update(physic::dim2::world& w, float focus_x, float focus_y, float view_radius);
+
+    struct stats{
+        int loaded_chunks = 0;
+        int pending_jobs = 0;                                   // queued or running on the streaming thread
+        int stored_bodies = 0;                                  // bodies in the chunk files
+    };
+
+    stats get_stats();
+}
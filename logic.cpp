@@ -22,6 +22,8 @@ inputs::button_state inputs::simulation_run_frame_button = inputs::IDLE;
 inputs::button_state inputs::simulation_run_toggle_button = inputs::IDLE;
 inputs::button_state inputs::stash_scenario_configuration_button = inputs::IDLE;
 inputs::button_state inputs::load_stashed_scenario_configuration_button = inputs::IDLE;
+int inputs::camera_pan_x = 0;
+int inputs::camera_pan_y = 0;
 
 bool inputs::check_if_click_is_on_scene(){
 
@@ -246,5 +248,11 @@ void inputs::update(){
         load_stashed_scenario_configuration_button = RELEASE; 
     } 
 
+    ///////////////////////////////////////////////////////////////////////////////////////
+    // Camera pan: held as long as the arrow keys are
+
+    camera_pan_x = (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) - (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS);
+    camera_pan_y = (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) - (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS);
+
     
 }
\ No newline at end of file
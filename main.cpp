@@ -7,11 +7,15 @@
 #include "editor_gui.h"
 #include "logic.h"
 #include "game_data.h"
+#include "jobs.h"
+#include "simulation.h"
 
 #include <vector>
 #include <iostream>
 #include <chrono>
 #include <math.h>
+#include <algorithm>
+#include <thread>
 
 // ====================================================================================
 // Global main data
@@ -96,26 +100,21 @@ int main(void){
 
     bool simulation_run = true;
 
+    // ====================================================================================
+    // Initialize job system and simulation thread
+    // The simulation thread submits the physics stages to the job workers and helps them while it waits
+
+    int job_workers = (int) std::thread::hardware_concurrency() - 1;
+    jobs::start(job_workers > 0 ? job_workers : 0);
+    simulation::start();
+
     // ====================================================================================
     // Initialize scenario
 
-    game_data::AddHalfspaceObject();
-    game_data::AddHalfspaceObject();
-    game_data::AddHalfspaceObject();
-    game_data::AddHalfspaceObject();
-
-    game_data::halfSpaceGameobjects[0].coll.origin_offset = - 9.5;
-    game_data::halfSpaceGameobjects[0].coll.normal_x = 0;
-    game_data::halfSpaceGameobjects[0].coll.normal_y = 1;
-    game_data::halfSpaceGameobjects[1].coll.origin_offset = - 15.5;
-    game_data::halfSpaceGameobjects[1].coll.normal_x = -1;
-    game_data::halfSpaceGameobjects[1].coll.normal_y = 0;
-    game_data::halfSpaceGameobjects[2].coll.origin_offset = - 9.5;
-    game_data::halfSpaceGameobjects[2].coll.normal_x = 0;
-    game_data::halfSpaceGameobjects[2].coll.normal_y = -1;
-    game_data::halfSpaceGameobjects[3].coll.origin_offset = - 15.5;
-    game_data::halfSpaceGameobjects[3].coll.normal_x = 1;
-    game_data::halfSpaceGameobjects[3].coll.normal_y = 0;
+    game_data::AddHalfspaceObject(0, 1, - 9.5);
+    game_data::AddHalfspaceObject(-1, 0, - 15.5);
+    game_data::AddHalfspaceObject(0, -1, - 9.5);
+    game_data::AddHalfspaceObject(1, 0, - 15.5);
     
     while (!glfwWindowShouldClose(window))
     { 
@@ -137,6 +136,7 @@ int main(void){
             inputs::update();
 
             if( inputs::simulation_run_toggle_button == inputs::PRESS ){
+                simulation_run = simulation::requested_settings.running;       // the timeline can pause it too
                 if(simulation_run == true){
                     simulation_run = false;
                     std::cout << "Simulation run false" << std::endl << std::flush;
@@ -144,6 +144,13 @@ int main(void){
                     simulation_run = true;
                     std::cout << "Simulation run true" << std::endl << std::flush;
                 }
+
+                simulation::requested_settings.running = simulation_run;
+                simulation::set_settings(simulation::requested_settings);
+            }
+
+            if ( inputs::simulation_run_frame_button == inputs::PRESS ) {
+                simulation::step_once();
             }
 
         } /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -157,26 +164,11 @@ int main(void){
         { /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
             if ( inputs::stash_scenario_configuration_button == inputs::PRESS ) {
-                
-                for(int i = 0; i < game_data::boxGameobjects.size(); i++){
-                    game_data::stashedBoxGameobjects[i] = game_data::boxGameobjects[i]; 
-                }
-
-                for(int i = 0; i < game_data::sphereGameobjects.size(); i++){
-                    game_data::stashedSphereGameobjects[i] = game_data::sphereGameobjects[i]; 
-                }
-
+                game_data::StashScenario();
             }
 
             if ( inputs::load_stashed_scenario_configuration_button == inputs::PRESS ){
-                
-                for(int i = 0; i < game_data::boxGameobjects.size(); i++){
-                    game_data::boxGameobjects[i] = game_data::stashedBoxGameobjects[i]; 
-                }
-
-                for(int i = 0; i < game_data::sphereGameobjects.size(); i++){
-                    game_data::sphereGameobjects[i] = game_data::stashedSphereGameobjects[i]; 
-                }
+                game_data::LoadStashedScenario();
             }
 
         } /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -190,89 +182,58 @@ int main(void){
         // DESCRIPTION: 
         // If the user left click anywhere on the app client, check if the click happens to be on the scene tab.
         // If it is, translate the click coordinates from screen space to game world coordinate; then iterate over 
-        // all box_gameobjects to check if the mouse hits a rigidbody.
-        // If it does set the flag "event_is_dragging_active" and store in "dragged_game_object_id" the id of the game 
-        // object hit by the mouse click
+        // all the entities with a PhysicBody to check if the mouse hits their collider.
+        // If it does set the flag "event_is_dragging_active" and store in "draggedEntity" the entity hit by the
+        // mouse click
         
         // Se è stato premuto il tasto sinistro del mouse e il click è sul tab della scena        
         if (inputs::mouse_left_button == inputs::PRESS && inputs::check_if_click_is_on_scene())
         { /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-            // Itera su tutti i box game objects
-            int index = 0;
-            for( auto& box_go : game_data::boxGameobjects) {
-  
-                // Controlla se le coordinate del mouse in world space sono dentro al box corrente
-                // NB: world_x_pos e world_y_pos del mouse click sono calcolate nello step di update degli inputs
-                if ( 
-                    physic::dim2::check_pointbox_collision(
-                        inputs::mouse_last_click.world_x_pos,
-                        inputs::mouse_last_click.world_y_pos,
-                        box_go.rb.pos_x,
-                        box_go.rb.pos_y,
-                        box_go.rb.angle,
-                        box_go.coll.width,
-                        box_go.coll.height) 
-                ){
-                    game_data::event_is_dragging_active = true;
-                    
-                    // Set draggedGameObject pointers
-                    // WARNING: Pointing to an array element
-                    game_data::draggedGameObject.world_x_pos = &box_go.world_x_pos;
-                    game_data::draggedGameObject.world_x_scale = &box_go.world_x_scale;
-                    game_data::draggedGameObject.world_y_pos = &box_go.world_y_pos;
-                    game_data::draggedGameObject.world_y_scale = &box_go.world_y_scale;
-                    game_data::draggedGameObject.world_z_angle = &box_go.world_z_angle;
-                    game_data::draggedGameObject.render_outline = &box_go.render_outline;
-                    game_data::draggedGameObject.rb = &box_go.rb;
-                    game_data::draggedGameObject.coll = &box_go.coll;
-                    game_data::draggedGameObject.gameobject_id = &box_go.gameobject_id;
-
-                    gui::selected_box_array_pos = index;
-                    gui::selected_sphere_array_pos = -1;
-                    gui::selected_halfspace_array_pos = -1;
-                }
+            const simulation::snapshot& snap = simulation::current_snapshot();
 
-                index++;
+            // Itera su tutti i game objects con un body
+            game_data::Each([&](game_data::Entity entity, game_data::PhysicBody& body){
 
-            }
-            
-            // Itera su tutti gli sphere game objects
-            index = 0;
-            for( auto& sphere_go : game_data::sphereGameobjects) {
+                // I body non ancora simulati non sono selezionabili
+                const simulation::body_record* record = simulation::find_body(snap, body.body_id);
+                if(record == nullptr)
+                    return;
   
-                // Controlla se le coordinate del mouse in world space sono dentro al box corrente
+                // Controlla se le coordinate del mouse in world space sono dentro al collider corrente
                 // NB: world_x_pos e world_y_pos del mouse click sono calcolate nello step di update degli inputs
-                if ( 
-                    physic::dim2::check_pointsphere_collision(
-                        inputs::mouse_last_click.world_x_pos,
-                        inputs::mouse_last_click.world_y_pos,
-                        sphere_go.rb.pos_x,
-                        sphere_go.rb.pos_y,
-                        sphere_go.coll.radius) 
-                ){
+                bool hit = false;
+                switch(record->shape.type){
+                    case physic::dim2::collider::BOX:
+                        hit = physic::dim2::check_pointbox_collision(
+                            inputs::mouse_last_click.world_x_pos,
+                            inputs::mouse_last_click.world_y_pos,
+                            record->rb.pos_x,
+                            record->rb.pos_y,
+                            record->rb.angle,
+                            record->shape.box.width,
+                            record->shape.box.height);
+                        break;
+                    case physic::dim2::collider::SPHERE:
+                        hit = physic::dim2::check_pointsphere_collision(
+                            inputs::mouse_last_click.world_x_pos,
+                            inputs::mouse_last_click.world_y_pos,
+                            record->rb.pos_x,
+                            record->rb.pos_y,
+                            record->shape.sphere.radius);
+                        break;
+                    default:
+                        // Gli halfspace non si trascinano
+                        break;
+                }
+
+                if(hit){
                     game_data::event_is_dragging_active = true;
-                    
-                    // Set draggedGameObject pointers
-                    // WARNING: Pointing to an array element
-                    game_data::draggedGameObject.world_x_pos = &sphere_go.world_x_pos;
-                    game_data::draggedGameObject.world_x_scale = &sphere_go.world_x_scale;
-                    game_data::draggedGameObject.world_y_pos = &sphere_go.world_y_pos;
-                    game_data::draggedGameObject.world_y_scale = &sphere_go.world_y_scale;
-                    game_data::draggedGameObject.world_z_angle = &sphere_go.world_z_angle;
-                    game_data::draggedGameObject.render_outline = &sphere_go.render_outline;
-                    game_data::draggedGameObject.rb = &sphere_go.rb;
-                    game_data::draggedGameObject.coll = &sphere_go.coll;
-                    game_data::draggedGameObject.gameobject_id = &sphere_go.gameobject_id;
-
-                    gui::selected_box_array_pos = -1;
-                    gui::selected_sphere_array_pos = index;
-                    gui::selected_halfspace_array_pos = -1;
+                    game_data::draggedEntity = entity;
+                    gui::selected_entity = entity;
                 }
 
-                index ++;
-            }
-            
+            }, game_data::physicBodies);
 
         } /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -289,177 +250,30 @@ int main(void){
         
         //=================================================================================================================
 
-        //                              PHYSIC UPDATE: Rigidbodies numeric integration
-        
-        //=================================================================================================================
-        
-        // DESCRIPTION:
-        // Update all rigidbodies data inside "world_rigidbodies_2d_box"
-        
-        if ( inputs::simulation_run_frame_button == inputs::PRESS || simulation_run)
-        { /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-            
-            for( auto& box_go : game_data::boxGameobjects){
-                physic::dim2::numeric_integration(box_go.rb, delta_time.count(), 0, 0, 0);
-            }
-
-            for (auto& sphere_go : game_data::sphereGameobjects){
-                physic::dim2::numeric_integration(sphere_go.rb, delta_time.count(), 0, 0, 0);
-            }
-    
-        } /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-       
-        //=================================================================================================================
-
-        //                           PHYSIC UPDATE: Generate contact data
-        
-        //=================================================================================================================
-
-        if ( inputs::simulation_run_frame_button == inputs::PRESS || simulation_run)
-        { /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-            // ====================================================================================
-            // Reset contact vector from eventual unresolved contacts from previous frame
-            
-            physic::dim2::contacts.clear();
-
-            // ====================================================================================
-            // Dispatch the collision tests and populate the contacts vector
-
-            // BOX-BOX DISPATCH: with naive algorithm
-
-            if(game_data::boxGameobjects.size() != 0){
-                for(int i = 0; i < game_data::boxGameobjects.size()-1; i ++){
-                    for(int j = i+1; j < game_data::boxGameobjects.size(); j++){
-
-                        game_data::BoxGameObject& boxA = game_data::boxGameobjects[i];
-                        game_data::BoxGameObject& boxB = game_data::boxGameobjects[j];
-
-                        physic::dim2::contact_data new_contact = physic::dim2::generate_boxbox_contactdata_naive_alg(boxA.rb, boxB.rb, boxA.coll, boxB.coll);
-
-                        if (new_contact.pen > 0){
-                            physic::dim2::contacts.push_back(new_contact);
-                        }
-                    }
-                }
-            }
-   
-            // SPHERE-SPHERE DISPATCH
-
-            if(game_data::sphereGameobjects.size() != 0){
-                for(int i = 0; i < game_data::sphereGameobjects.size()-1; i ++){
-                    for(int j = i+1; j < game_data::sphereGameobjects.size(); j++){
-
-                        game_data::SphereGameObject& sphereA = game_data::sphereGameobjects[i];
-                        game_data::SphereGameObject& sphereB = game_data::sphereGameobjects[j];
-
-                        physic::dim2::contact_data new_contact = physic::dim2::generate_spheresphere_contactdata_norotation(sphereA.rb, sphereB.rb, sphereA.coll, sphereB.coll);
-
-                        if (new_contact.pen > 0){
-                            physic::dim2::contacts.push_back(new_contact);
-                        }
-                    }
-                }
-            }
-
-            // BOX-SPHERE DISPATCH
-
-            if(game_data::boxGameobjects.size() != 0 && game_data::sphereGameobjects.size() != 0){
-                for(int i = 0; i < game_data::boxGameobjects.size(); i++){
-                    for(int j = 0; j < game_data::sphereGameobjects.size(); j++){
-
-                        game_data::BoxGameObject& box = game_data::boxGameobjects[i];
-                        game_data::SphereGameObject& sphere = game_data::sphereGameobjects[j];
-
-                        physic::dim2::contact_data new_contact = physic::dim2::generate_spherebox_contactdata_norotation(sphere.rb, box.rb, sphere.coll, box.coll);
-
-                        if (new_contact.pen > 0){
-                            physic::dim2::contacts.push_back(new_contact);
-                        }
-
-                    }
-                }
-            } 
-
-            // BOX-HALFSPACE DISPATCH
-
-            if(game_data::boxGameobjects.size() != 0 && game_data::halfSpaceGameobjects.size() != 0){
-                for(int i = 0; i < game_data::boxGameobjects.size(); i ++){
-                    for(int j = 0; j < game_data::halfSpaceGameobjects.size(); j++){
-
-                        game_data::BoxGameObject& box = game_data::boxGameobjects[i];
-                        game_data::HalfSpaceGameObject& halfspace = game_data::halfSpaceGameobjects[j];
-
-                        physic::dim2::contact_data new_contact = physic::dim2::generate_boxhalfspace_contactdata(box.rb, box.coll, halfspace.coll);
-
-                        if (new_contact.pen > 0){
-                            physic::dim2::contacts.push_back(new_contact);
-                        }
-                    }
-                }
-            }
-
-            // SPHERE-HALFSPACE DISPATCH
-
-            if ( game_data::sphereGameobjects.size() != 0 && game_data::halfSpaceGameobjects.size() != 0)
-            {
-                for(int i = 0; i < game_data::sphereGameobjects.size(); i++){
-                    for(int j = 0; j < game_data::halfSpaceGameobjects.size(); j++){
-
-                        game_data::SphereGameObject& sphere = game_data::sphereGameobjects[i];
-                        game_data::HalfSpaceGameObject& halfspace = game_data::halfSpaceGameobjects[j];
-
-                        physic::dim2::contact_data new_contact = physic::dim2::generate_spherehalfspace_contactdata(sphere.rb, sphere.coll, halfspace.coll);
-
-                        if (new_contact.pen > 0){
-                            physic::dim2::contacts.push_back(new_contact);
-                        }
-
-                    }
-                }
-            }
-
-        } /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-        //=================================================================================================================
-
-        //                                  PHYSIC UPDATE: Solve contact data
-
-        //=================================================================================================================
-
-        if ( inputs::simulation_run_frame_button == inputs::PRESS || simulation_run)
-        { /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-            physic::dim2::contact_solver_dispatcher();
-                
-        } /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-        
-        //=================================================================================================================
-
-        //                              UPDATE GAMEOBJECT TRANSFORMS WITH RIGIDBODY DATA
+        //                              UPDATE GAMEOBJECTS WITH THE SIMULATION SNAPSHOT
 
         //=================================================================================================================
         
         // DESCRIPTION:
-        // Update each gameobject transform with the data inside their rigidbody
+        // The physics runs on the simulation thread (see simulation.h). Take the newest snapshot it published and
+        // read the body of each gameobject from it (the gui and the picking read the same snapshot in this frame);
+        // the transform is interpolated between the last two steps of the snapshot, so the rendering stays smooth
+        // whatever the ratio between the rendering and the simulation rates.
+        // Gameobjects the simulation doesn't know yet (just added) keep their last transform.
+        // A streamed scene first gets the gameobjects of the bodies that entered or left the world.
         
         { /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-            // BOX GAMEOBJECTS
-            for( auto& box_go : game_data::boxGameobjects ) {
-                box_go.world_x_pos = box_go.rb.pos_x;
-                box_go.world_y_pos = box_go.rb.pos_y;
-                box_go.world_z_angle = box_go.rb.angle;
-            }
+            const simulation::snapshot& snap = simulation::read_snapshot();
+            float alpha = simulation::render_alpha(snap, simulation::clock_seconds());
 
-            // SPHERE GAMEOBJECTS
-            for( auto& sphere_go : game_data::sphereGameobjects ) {
-                sphere_go.world_x_pos = sphere_go.rb.pos_x;
-                sphere_go.world_y_pos = sphere_go.rb.pos_y;
-                sphere_go.world_z_angle = sphere_go.rb.angle;
+            game_data::SyncStreamedGameObjects(snap);
 
-                // Forcefully set rotation to 0 (Fix: 24-10-12 11:20)
-                sphere_go.rb.w = 0;
-            }
+            game_data::Each([&](game_data::Entity, game_data::Transform& transform, game_data::PhysicBody& body){
+                const simulation::body_record* record = simulation::find_body(snap, body.body_id);
+                if(record != nullptr)
+                    physic::dim2::interpolate_pose(record->rb, alpha, transform.world_x_pos, transform.world_y_pos, transform.world_z_angle);
+            }, game_data::transforms, game_data::physicBodies);
 
         } /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
         
@@ -471,19 +285,19 @@ int main(void){
         
         // DESCRIPTION:
         // If the flag "event_is_dragging_active" is set, update the dragged gameobject's transform and rigidbody data 
-        // with the world mouse position.
+        // with the world mouse position and send the rigidbody to the simulation (applied before its next step).
         
         { /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
             if(game_data::event_is_dragging_active){
 
                 // On first dragging frame, setup the renderer to highlight 
                 if (inputs::mouse_left_button == inputs::PRESS) {
-                    *game_data::draggedGameObject.render_outline = true;
+                    game_data::SetRenderOutline(game_data::draggedEntity, true);
                 }
 
                 // If mouse is released, remove event dragging and remove the highlight
                 if (inputs::mouse_left_button == inputs::RELEASE) {
-                    *game_data::draggedGameObject.render_outline = false;
+                    game_data::SetRenderOutline(game_data::draggedEntity, false);
                     game_data::event_is_dragging_active = false;
                 }
                 
@@ -503,12 +317,29 @@ int main(void){
                         curr_cursor_ndc_x, curr_cursor_ndc_y
                     );
 
-                    // Update the box gameobject positional data with the current cursor world position                
+                    // Update the gameobject positional data with the current cursor world position                
+
+                    game_data::Transform* transform = game_data::Get(game_data::transforms, game_data::draggedEntity);
+                    game_data::PhysicBody* body = game_data::Get(game_data::physicBodies, game_data::draggedEntity);
+
+                    if(transform != nullptr){
+                        transform->world_x_pos = curr_cursor_world_x;
+                        transform->world_y_pos = curr_cursor_world_y;
+                    }
+
+                    const simulation::body_record* dragged_record = body != nullptr
+                        ? simulation::find_body(simulation::current_snapshot(), body->body_id)
+                        : nullptr;
+
+                    if(dragged_record != nullptr){
+                        simulation::body_record record = *dragged_record;
+                        record.rb.pos_x = curr_cursor_world_x;
+                        record.rb.pos_y = curr_cursor_world_y;
+                        record.rb.prev_pos_x = curr_cursor_world_x;
+                        record.rb.prev_pos_y = curr_cursor_world_y;
 
-                    *game_data::draggedGameObject.world_x_pos = curr_cursor_world_x;
-                    *game_data::draggedGameObject.world_y_pos = curr_cursor_world_y;
-                    game_data::draggedGameObject.rb->pos_x = curr_cursor_world_x;
-                    game_data::draggedGameObject.rb->pos_y = curr_cursor_world_y;                 
+                        simulation::set_body(record);
+                    }
                 }
 
             }
@@ -562,6 +393,19 @@ int main(void){
             // Imposta la width della camera di gioco in modo che ciò che cattura nel game world rifletta 
             // il rapporto con cui viene mostrata sullo schermo
             rendering::camera.world_width_fov = rendering::game_scene_viewport.ratio * rendering::camera.world_height_fov;
+
+            // Pan with the arrow keys, half a view per second; a streamed scene loads the chunks the camera
+            // sees (the focus radius covers the corners of the view)
+            float pan_speed = rendering::camera.world_height_fov * 0.5f;
+            rendering::camera.world_x_pos += inputs::camera_pan_x * pan_speed * delta_time.count();
+            rendering::camera.world_y_pos += inputs::camera_pan_y * pan_speed * delta_time.count();
+
+            float half_width = rendering::camera.world_width_fov * 0.5f;
+            float half_height = rendering::camera.world_height_fov * 0.5f;
+            simulation::set_stream_focus(
+                rendering::camera.world_x_pos, rendering::camera.world_y_pos,
+                sqrtf(half_width * half_width + half_height * half_height)
+            );
         } /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
         
         //=================================================================================================================
@@ -571,7 +415,7 @@ int main(void){
         //=================================================================================================================
         
         // DESCRIPTION:
-        // Renders data inside game_data::world_gameobjects_box
+        // Renders the entities with a QuadRenderer and a Transform
         
         { /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
             // ====================================================================================
@@ -590,25 +434,25 @@ int main(void){
 
             float mvp [16];
 
-            for ( auto& box_go : game_data::boxGameobjects ) {
+            game_data::Each([&](game_data::Entity, game_data::QuadRenderer& quad, game_data::Transform& transform){
 
                 // Calculate MVP based on box transform
                 rendering::calculate_mvp(
                     mvp, 
-                    box_go.world_x_scale, 
-                    box_go.world_y_scale, 
-                    box_go.world_x_pos, 
-                    box_go.world_y_pos, 
-                    box_go.world_z_angle
+                    transform.world_x_scale, 
+                    transform.world_y_scale, 
+                    transform.world_x_pos, 
+                    transform.world_y_pos, 
+                    transform.world_z_angle
                 );
 
                 // Setup shader uniforms
-                rendering::quad_texture_shader::set_uniform_outline(box_go.render_outline);
+                rendering::quad_texture_shader::set_uniform_outline(quad.render_outline);
                 rendering::quad_texture_shader::set_uniform_mvp(mvp);
 
                 // Render on the currently bounded framebuffer
                 glDrawArrays(GL_TRIANGLES, 0, rendering::quad_texture_shader::quad_mesh_data_buffers.mesh_vertex_number);
-            }
+            }, game_data::quadRenderers, game_data::transforms);
         } /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
         
         //=================================================================================================================
@@ -618,7 +462,7 @@ int main(void){
         //=================================================================================================================
         
         // DESCRIPTION:
-        // Renders data inside game_data::world_gameobjects_box
+        // Renders the entities with a SphereRenderer and a Transform
         
         { /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
             // ====================================================================================
@@ -637,25 +481,25 @@ int main(void){
 
             float mvp [16];
 
-            for ( auto& sphere_go : game_data::sphereGameobjects ) {
+            game_data::Each([&](game_data::Entity, game_data::SphereRenderer& sphere, game_data::Transform& transform){
 
-                // Calculate MVP based on box transform
+                // Calculate MVP based on sphere transform
                 rendering::calculate_mvp(
                     mvp, 
-                    sphere_go.world_x_scale *2, 
-                    sphere_go.world_y_scale *2, 
-                    sphere_go.world_x_pos, 
-                    sphere_go.world_y_pos, 
-                    sphere_go.world_z_angle
+                    transform.world_x_scale *2, 
+                    transform.world_y_scale *2, 
+                    transform.world_x_pos, 
+                    transform.world_y_pos, 
+                    transform.world_z_angle
                 );
 
                 // Setup shader uniforms
-                rendering::sphere_shader::set_uniform_outline(sphere_go.render_outline);
+                rendering::sphere_shader::set_uniform_outline(sphere.render_outline);
                 rendering::sphere_shader::set_uniform_mvp(mvp);
 
                 // Render on the currently bounded framebuffer
                 glDrawArrays(GL_TRIANGLES, 0, rendering::sphere_shader::quad_mesh_data_buffers.mesh_vertex_number);
-            }
+            }, game_data::sphereRenderers, game_data::transforms);
 
             glDisable(GL_DEPTH_TEST); 
         } /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -667,7 +511,7 @@ int main(void){
         //=================================================================================================================
         
         // DESCRIPTION:
-        // Renders data inside game_data::world_gameobjects_box
+        // Renders the entities with a PlaneRenderer and a PhysicBody
         
         { /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
             
@@ -676,12 +520,18 @@ int main(void){
             glUseProgram(rendering::debug_line_shader::program_id);
             glBindVertexArray(rendering::debug_line_shader::gpu_line_data.line_data_pointers_buffer_id);
 
-            for (auto& halfspace_go : game_data::halfSpaceGameobjects){
+            game_data::Each([&](game_data::Entity, game_data::PlaneRenderer&, game_data::PhysicBody& body){
+
+                const simulation::body_record* record = simulation::find_body(simulation::current_snapshot(), body.body_id);
+                if(record == nullptr)
+                    return;
+
+                const physic::dim2::collider_halfspace& coll = record->shape.halfspace;
 
-                float normal_ort_x = halfspace_go.coll.normal_y;
-                float normal_ort_y = - halfspace_go.coll.normal_x;
-                float plane_offset_x = halfspace_go.coll.normal_x * halfspace_go.coll.origin_offset;
-                float plane_offset_y = halfspace_go.coll.normal_y * halfspace_go.coll.origin_offset;
+                float normal_ort_x = coll.normal_y;
+                float normal_ort_y = - coll.normal_x;
+                float plane_offset_x = coll.normal_x * coll.origin_offset;
+                float plane_offset_y = coll.normal_y * coll.origin_offset;
 
                 rendering::debug_line_shader::draw_2d_point(plane_offset_x,plane_offset_y);
 
@@ -698,10 +548,10 @@ int main(void){
                     plane_offset_x,
                     plane_offset_y,
                     0,
-                    {0, 0, halfspace_go.coll.normal_x, halfspace_go.coll.normal_y}
+                    {0, 0, coll.normal_x, coll.normal_y}
                 );
             
-            }
+            }, game_data::planeRenderers, game_data::physicBodies);
 
             
         } /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -713,44 +563,31 @@ int main(void){
         //=================================================================================================================
         
         // DESCRIPTION:
-        // Renders data inside physic::dim2::contacts vector
+        // Renders the contacts of the last simulation snapshot
         
         if( game_data::debug_draw_contact_data )
         { /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
             
-            // Renders visually the data inside the physic::dim2::contacts vector 
+            // Renders visually the contacts of the snapshot (world space points)
                            
             glUseProgram(rendering::debug_line_shader::program_id);
             glBindVertexArray(rendering::debug_line_shader::gpu_line_data.line_data_pointers_buffer_id);
 
-            for (auto contact : physic::dim2::contacts){
-
-                // Find QA world contact coordinates
-                mat4x4 model_matrix;
-                physic::dim2::build_model_matrix(model_matrix, contact.rb_a->pos_x, contact.rb_a->pos_y, contact.rb_a->angle );
-                vec4 world_qa;
-                vec4 local_qa = {contact.ms_qa_x, contact.ms_qa_y, 0, 1};
-                mat4x4_mul_vec4(world_qa, model_matrix, local_qa);
-
-                // Find QB world contact coordinates
-                physic::dim2::build_model_matrix(model_matrix, contact.rb_b->pos_x, contact.rb_b->pos_y, contact.rb_b->angle );
-                vec4 world_qb;
-                vec4 local_qb= {contact.ms_qb_x, contact.ms_qb_y, 0, 1};
-                mat4x4_mul_vec4(world_qb, model_matrix, local_qb);
+            for (auto& contact : simulation::current_snapshot().contacts){
 
                 // Render QA
-                rendering::debug_line_shader::draw_2d_point(world_qa[0],world_qa[1]);
+                rendering::debug_line_shader::draw_2d_point(contact.qa_x, contact.qa_y);
 
                 // Render QB
-                rendering::debug_line_shader::draw_2d_point(world_qb[0],world_qb[1]);
+                rendering::debug_line_shader::draw_2d_point(contact.qb_x, contact.qb_y);
                 
 
                 // Render the normal (applied on QB)
                 rendering::debug_line_shader::draw_2d_line_stripe( 
-                    world_qb[0],
-                    world_qb[1],
+                    contact.qb_x,
+                    contact.qb_y,
                     0,
-                    {0, 0, contact.ws_n_x, contact.ws_n_y}
+                    {0, 0, contact.n_x, contact.n_y}
                 );
             
             }
@@ -767,25 +604,17 @@ int main(void){
         if ( game_data::debug_draw_impulses )
         { /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
                 
-            for( int i = 0; i < physic::dim2::contacts.size(); i++ ){
-    
-                physic::dim2::contact_data& contact = physic::dim2::contacts[i];
+            for( auto& contact : simulation::current_snapshot().contacts ){
 
                 game_data::contact_circle_animations.push_back({});
                 int last_element = game_data::contact_circle_animations.size()-1;
 
-                // Find QB world contact coordinates
-                mat4x4 model_matrix;
-                physic::dim2::build_model_matrix(model_matrix, contact.rb_b->pos_x, contact.rb_b->pos_y, contact.rb_b->angle );
-                vec4 world_qb;
-                vec4 local_qb= {contact.ms_qb_x, contact.ms_qb_y, 0, 1};
-                mat4x4_mul_vec4(world_qb, model_matrix, local_qb);
-
-                game_data::contact_circle_animations[last_element].world_x = world_qb[0];
-                game_data::contact_circle_animations[last_element].world_y = world_qb[1];
+                // QB world contact coordinates (QA if B is static)
+                game_data::contact_circle_animations[last_element].world_x = contact.qb_x;
+                game_data::contact_circle_animations[last_element].world_y = contact.qb_y;
 
-                game_data::contact_circle_animations[last_element].impulse_axis_x = contact.ws_n_x;
-                game_data::contact_circle_animations[last_element].impulse_axis_y = contact.ws_n_y;
+                game_data::contact_circle_animations[last_element].impulse_axis_x = contact.n_x;
+                game_data::contact_circle_animations[last_element].impulse_axis_y = contact.n_y;
 
             }
             
@@ -940,6 +769,9 @@ int main(void){
     { /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
         gui::destroy();
 
+        simulation::stop();
+        jobs::stop();
+
         glfwDestroyWindow(window);
     
         glfwTerminate();
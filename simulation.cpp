@@ -0,0 +1,536 @@
+#include "simulation.h"
+#include "streaming.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                            SIMULATION THREAD
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+simulation::settings simulation::requested_settings;
+
+// ====================================================================================
+// Sim thread data: only the sim thread touches them while it runs
+
+static physic::dim2::world sim_world;                               // owns the bodies
+static std::vector<physic::dim2::body_handle> sim_handles;          // body id -> handle in sim_world (null_body if none)
+
+// State saved by the last SAVE_STATE
+static physic::dim2::world_state sim_saved_state;
+static std::vector<physic::dim2::body_handle> sim_saved_handles;
+
+// States of the last steps
+static physic::dim2::rewind_buffer sim_rewind;
+
+static std::vector<simulation::contact_record> sim_contacts;       // contacts of the last step, in world space
+
+static physic::dim2::fixed_step_scheduler sim_scheduler;
+static simulation::settings sim_settings;
+
+// ====================================================================================
+// Shared data
+
+static simulation::triple_buffer snapshots;
+
+static std::mutex command_mutex;
+static std::condition_variable command_cv;
+static std::vector<simulation::command> command_queue;
+
+static std::thread sim_thread;
+static std::atomic<bool> stop_requested{false};
+
+// Stream focus, written by the main thread every frame
+static std::atomic<float> stream_focus_x{0};
+static std::atomic<float> stream_focus_y{0};
+static std::atomic<float> stream_view_radius{0};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                               UTILITIES
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const simulation::body_record* simulation::find_body(const snapshot& snap, int id){
+
+    auto it = std::lower_bound(snap.bodies.begin(), snap.bodies.end(), id, [](const body_record& record, int value){
+        return record.id < value;
+    });
+
+    if(it == snap.bodies.end() || it->id != id)
+        return nullptr;
+    return &*it;
+}
+
+float simulation::render_alpha(const snapshot& snap, double now){
+
+    if(!snap.running)
+        return 1;
+
+    float alpha = (float) ((now - snap.time) / snap.fixed_delta_time);
+    return std::min(std::max(alpha, 0.0f), 1.0f);
+}
+
+double simulation::clock_seconds(){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                              TRIPLE BUFFER
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+simulation::snapshot& simulation::begin_write(triple_buffer& buffer){
+    return buffer.slots[buffer.back];
+}
+
+// The release half of the exchange publishes the writes on the back slot, the acquire half
+// makes the slot given back by the reader safe to overwrite
+void simulation::publish(triple_buffer& buffer){
+    int previous = buffer.middle.exchange(buffer.back | fresh_bit, std::memory_order_acq_rel);
+    buffer.back = previous & ~fresh_bit;
+}
+
+const simulation::snapshot& simulation::read_latest(triple_buffer& buffer){
+
+    if(buffer.middle.load(std::memory_order_relaxed) & fresh_bit){
+        int previous = buffer.middle.exchange(buffer.front, std::memory_order_acq_rel);
+        buffer.front = previous & ~fresh_bit;
+    }
+
+    return buffer.slots[buffer.front];
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                COMMANDS
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void simulation::push_command(const command& cmd){
+    {
+        std::lock_guard<std::mutex> lock(command_mutex);
+        command_queue.push_back(cmd);
+    }
+    command_cv.notify_one();
+}
+
+void simulation::set_body(int id, const physic::dim2::rigidbody* rb, const physic::dim2::collider& coll){
+
+    body_record record;
+    record.id = id;
+    record.rb = rb != nullptr ? *rb : physic::dim2::rigidbody{};
+    record.shape = physic::dim2::make_shape(coll);
+
+    set_body(record);
+}
+
+void simulation::set_body(const body_record& record){
+    command cmd;
+    cmd.type = command::SET_BODY;
+    cmd.body = record;
+    push_command(cmd);
+}
+
+void simulation::remove_body(int id){
+    command cmd;
+    cmd.type = command::REMOVE_BODY;
+    cmd.body.id = id;
+    push_command(cmd);
+}
+
+void simulation::save_state(){
+    command cmd;
+    cmd.type = command::SAVE_STATE;
+    push_command(cmd);
+}
+
+void simulation::restore_state(){
+    command cmd;
+    cmd.type = command::RESTORE_STATE;
+    push_command(cmd);
+}
+
+void simulation::seek_frame(int frame){
+    command cmd;
+    cmd.type = command::SEEK_FRAME;
+    cmd.frame = frame;
+    push_command(cmd);
+}
+
+void simulation::load_scene(const std::shared_ptr<const physic::dim2::scene_file>& scene){
+    command cmd;
+    cmd.type = command::LOAD_SCENE;
+    cmd.scene = scene;
+    push_command(cmd);
+}
+
+void simulation::stream_scene(const std::shared_ptr<const physic::dim2::scene_file>& scene, const std::string& path, float chunk_size){
+    command cmd;
+    cmd.type = command::STREAM_SCENE;
+    cmd.scene = scene;
+    cmd.path = path;
+    cmd.chunk_size = chunk_size;
+    push_command(cmd);
+}
+
+void simulation::set_stream_focus(float x, float y, float view_radius){
+    stream_focus_x.store(x, std::memory_order_relaxed);
+    stream_focus_y.store(y, std::memory_order_relaxed);
+    stream_view_radius.store(view_radius, std::memory_order_relaxed);
+}
+
+void simulation::set_settings(const settings& new_settings){
+    command cmd;
+    cmd.type = command::SET_SETTINGS;
+    cmd.new_settings = new_settings;
+    push_command(cmd);
+}
+
+void simulation::step_once(){
+    command cmd;
+    cmd.type = command::STEP_ONCE;
+    push_command(cmd);
+}
+
+// ------------------------------------------------------------------------------------
+// Sim thread: apply the queued commands between two steps; returns the number of STEP_ONCE
+
+static void apply_settings(const simulation::settings& s){
+
+    sim_settings = s;
+
+    sim_world.mode = s.mode;
+    sim_world.xpbd_substeps = s.xpbd_substeps;
+    sim_world.velocity_iterations = s.velocity_iterations;
+
+    sim_world.gravity_x = s.gravity_x;
+    sim_world.gravity_y = s.gravity_y;
+
+    // The world only accepts steps of its fixed_delta_time while deterministic
+    sim_world.deterministic = s.deterministic;
+    sim_world.fixed_delta_time = s.fixed_delta_time;
+
+    sim_scheduler.fixed_delta_time = s.fixed_delta_time;
+    sim_scheduler.max_steps_per_frame = s.max_steps_per_frame;
+}
+
+static void apply_body(const simulation::body_record& record){
+
+    bool is_static = record.shape.type == physic::dim2::collider::HALFSPACE;
+    const physic::dim2::collider& coll = physic::dim2::shape_collider(record.shape);
+
+    if(record.id >= (int) sim_handles.size())
+        sim_handles.resize(record.id + 1, physic::dim2::null_body);
+
+    physic::dim2::body_handle& handle = sim_handles[record.id];
+    if(!physic::dim2::body_valid(sim_world.bodies, handle)){
+        handle = physic::dim2::add_body(sim_world.bodies, record.id, is_static ? nullptr : &record.rb, coll);
+        return;
+    }
+
+    int row = physic::dim2::body_row(sim_world.bodies, handle);
+    physic::dim2::write_body(sim_world.bodies, row, record.rb);
+    physic::dim2::set_body_collider(sim_world.bodies, row, coll);
+}
+
+static void apply_remove(int id){
+
+    if(id < 0 || id >= (int) sim_handles.size())
+        return;
+
+    physic::dim2::destroy_body(sim_world, sim_handles[id]);
+    sim_handles[id] = physic::dim2::null_body;
+}
+
+// The world blob and the id table are bulk copies: microseconds even for large scenes
+static void apply_save_state(){
+    physic::dim2::save_world_state(sim_world, sim_saved_state);
+    sim_saved_handles = sim_handles;
+}
+
+static void record_contacts();
+
+// The settings in use are applied again over the ones saved with the world
+static void apply_restore_state(){
+
+    if(streaming::active())
+        return;
+
+    if(!physic::dim2::restore_world_state(sim_world, sim_saved_state))
+        return;
+
+    sim_handles = sim_saved_handles;
+    apply_settings(sim_settings);
+    record_contacts();
+}
+
+// Map again every body id to its row, after the bodies are replaced all at once
+static void rebuild_handles(){
+
+    std::fill(sim_handles.begin(), sim_handles.end(), physic::dim2::null_body);
+    for(int row = 0; row < physic::dim2::body_count(sim_world.bodies); row++){
+        int id = sim_world.bodies.id[row];
+        if(id >= (int) sim_handles.size())
+            sim_handles.resize(id + 1, physic::dim2::null_body);
+        sim_handles[id] = physic::dim2::row_body_handle(sim_world.bodies, row);
+    }
+}
+
+// The ids of the bodies spawned after the frame are freed
+static void apply_seek_frame(int frame){
+
+    if(streaming::active())
+        return;
+
+    if(!physic::dim2::seek_frame(sim_rewind, frame, sim_world))
+        return;
+
+    rebuild_handles();
+    apply_settings(sim_settings);
+    record_contacts();
+}
+
+static void apply_load_scene(const physic::dim2::scene_file& scene){
+
+    streaming::end();
+    physic::dim2::load_scene(sim_world, scene.view);
+
+    rebuild_handles();
+    physic::dim2::clear_rewind(sim_rewind);
+    record_contacts();
+}
+
+// The world starts empty: the halfspaces and the first chunks come in with the next updates
+static void apply_stream_scene(const simulation::command& cmd){
+
+    streaming::end();
+    physic::dim2::load_scene(sim_world, physic::dim2::scene_view{});
+
+    rebuild_handles();
+    physic::dim2::clear_rewind(sim_rewind);
+    record_contacts();
+
+    streaming::begin(cmd.scene, cmd.path, cmd.chunk_size);
+}
+
+static int apply_commands(std::vector<simulation::command>& commands){
+
+    int steps_requested = 0;
+
+    for( auto& cmd : commands ){
+        switch(cmd.type){
+            case simulation::command::SET_BODY:       apply_body(cmd.body); break;
+            case simulation::command::REMOVE_BODY:    apply_remove(cmd.body.id); break;
+            case simulation::command::SAVE_STATE:     apply_save_state(); break;
+            case simulation::command::RESTORE_STATE:  apply_restore_state(); break;
+            case simulation::command::SEEK_FRAME:     apply_seek_frame(cmd.frame); break;
+            case simulation::command::LOAD_SCENE:     apply_load_scene(*cmd.scene); break;
+            case simulation::command::STREAM_SCENE:   apply_stream_scene(cmd); break;
+            case simulation::command::SET_SETTINGS:   apply_settings(cmd.new_settings); break;
+            case simulation::command::STEP_ONCE:      steps_requested++; break;
+        }
+    }
+
+    return steps_requested;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                                SNAPSHOT
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Model space point of the body row in world space (a static B has no row: its point is QA)
+static void to_world(const physic::dim2::body_storage& bodies, int row, float ms_x, float ms_y, float& ws_x, float& ws_y){
+    float c = std::cos(bodies.angle[row]);
+    float s = std::sin(bodies.angle[row]);
+    ws_x = bodies.pos_x[row] + c * ms_x - s * ms_y;
+    ws_y = bodies.pos_y[row] + s * ms_x + c * ms_y;
+}
+
+// Called right after the steps: later commands could move the rows the contacts point to
+static void record_contacts(){
+
+    sim_contacts.resize(sim_world.contacts.size());
+
+    for(int i = 0; i < sim_world.contacts.size(); i++){
+        const physic::dim2::contact_data& contact = sim_world.contacts[i];
+        simulation::contact_record& record = sim_contacts[i];
+
+        to_world(sim_world.bodies, contact.body_a, contact.ms_qa_x, contact.ms_qa_y, record.qa_x, record.qa_y);
+        if(contact.body_b >= 0){
+            to_world(sim_world.bodies, contact.body_b, contact.ms_qb_x, contact.ms_qb_y, record.qb_x, record.qb_y);
+        }else{
+            record.qb_x = record.qa_x;
+            record.qb_y = record.qa_y;
+        }
+        record.n_x = contact.ws_n_x;
+        record.n_y = contact.ws_n_y;
+    }
+}
+
+static void publish_snapshot(double time){
+
+    simulation::snapshot& snap = simulation::begin_write(snapshots);
+
+    // The assignments reuse the capacity of the slot, no allocations once the scene is stable
+    const physic::dim2::body_storage& bodies = sim_world.bodies;
+    snap.bodies.resize(physic::dim2::body_count(bodies));
+    for(int row = 0; row < snap.bodies.size(); row++){
+        snap.bodies[row].id = bodies.id[row];
+        snap.bodies[row].rb = physic::dim2::read_body(bodies, row);
+        snap.bodies[row].shape = bodies.shape[row];
+    }
+
+    // Rows are in id order only in deterministic mode
+    std::sort(snap.bodies.begin(), snap.bodies.end(), [](const simulation::body_record& a, const simulation::body_record& b){
+        return a.id < b.id;
+    });
+
+    snap.contacts = sim_contacts;
+
+    snap.step_count = sim_world.step_count;
+    snap.checksum = sim_world.checksum;
+
+    snap.rewind_frames = sim_rewind.count;
+    snap.rewind_cursor = sim_rewind.cursor;
+    snap.rewind_first_step = sim_rewind.count > 0 ? sim_rewind.frames[sim_rewind.first].step_count : 0;
+    snap.rewind_memory = physic::dim2::rewind_memory(sim_rewind);
+
+    snap.arena_last_step = sim_world.memory.last_step_bytes;
+    snap.arena_high_water = sim_world.memory.high_water;
+    snap.arena_capacity = physic::dim2::arena_capacity(sim_world.memory);
+
+    streaming::stats stream = streaming::get_stats();
+    snap.streaming = streaming::active();
+    snap.stream_loaded_chunks = stream.loaded_chunks;
+    snap.stream_pending_jobs = stream.pending_jobs;
+    snap.stream_stored_bodies = stream.stored_bodies;
+    snap.time = time;
+    snap.fixed_delta_time = sim_scheduler.fixed_delta_time;
+    snap.running = sim_settings.running;
+
+    simulation::publish(snapshots);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                               THREAD LOOP
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Every iteration: apply the commands, advance the scheduler with the real elapsed time, run the steps
+// and publish; then sleep until the next step is due or a command arrives.
+// The physics stages run on the job system from this thread (through the injection queue), the thread
+// helps the workers while it waits for them.
+
+static void sim_main(){
+
+    std::vector<simulation::command> commands;
+    double last_time = simulation::clock_seconds();
+    double step_time = last_time;
+
+    while(!stop_requested){
+
+        // ------------------------------------------------------------------------------------
+        // Commands
+
+        {
+            std::lock_guard<std::mutex> lock(command_mutex);
+            commands.swap(command_queue);
+        }
+
+        int steps_requested = apply_commands(commands);
+        bool changed = !commands.empty();
+        commands.clear();
+
+        // The removed bodies leave the world now: a paused simulation must not publish them again
+        physic::dim2::flush_destroyed_bodies(sim_world);
+
+        // Chunks loaded in the background enter the world, the ones out of focus leave it. The rows
+        // move and the rewind states no longer match the world: the timeline starts over.
+        bool streamed = streaming::update(sim_world,
+            stream_focus_x.load(std::memory_order_relaxed),
+            stream_focus_y.load(std::memory_order_relaxed),
+            stream_view_radius.load(std::memory_order_relaxed));
+
+        if(streamed){
+            rebuild_handles();
+            physic::dim2::clear_rewind(sim_rewind);
+            changed = true;
+        }
+
+        // ------------------------------------------------------------------------------------
+        // Steps
+
+        double now = simulation::clock_seconds();
+        int steps = 0;
+
+        if(sim_settings.running)
+            steps = physic::dim2::advance_scheduler(sim_scheduler, (float) (now - last_time));
+        last_time = now;
+
+        if(steps_requested > 0)
+            steps = std::max(steps, 1);
+
+        for(int i = 0; i < steps; i++){
+            physic::dim2::step(sim_world, sim_scheduler.fixed_delta_time);
+
+            if(sim_settings.record_rewind)
+                physic::dim2::record_world_state(sim_rewind, sim_world);
+        }
+
+        if(steps > 0){
+            record_contacts();
+            step_time = simulation::clock_seconds();
+        }
+
+        if(steps > 0 || changed)
+            publish_snapshot(step_time);
+
+        // ------------------------------------------------------------------------------------
+        // Wait for the next step
+
+        float wait = sim_settings.running
+            ? (1 - sim_scheduler.alpha) * sim_scheduler.fixed_delta_time
+            : sim_scheduler.fixed_delta_time;
+
+        std::unique_lock<std::mutex> lock(command_mutex);
+        command_cv.wait_for(lock, std::chrono::duration<float>(wait), []{
+            return stop_requested || !command_queue.empty();
+        });
+    }
+}
+
+// =========================================================================|
+//                                start / stop
+// =========================================================================|
+
+void simulation::start(int body_capacity){
+
+    stop_requested = false;
+    apply_settings(requested_settings);
+    sim_world.parallel = true;
+    physic::dim2::reserve_world(sim_world, body_capacity);
+
+    sim_thread = std::thread(sim_main);
+}
+
+void simulation::stop(){
+
+    if(!sim_thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(command_mutex);
+        stop_requested = true;
+    }
+    command_cv.notify_one();
+
+    sim_thread.join();
+    streaming::end();
+}
+
+const simulation::snapshot& simulation::read_snapshot(){
+    return read_latest(snapshots);
+}
+
+const simulation::snapshot& simulation::current_snapshot(){
+    return snapshots.slots[snapshots.front];
+}
@@ -0,0 +1,430 @@
+#include "streaming.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                            STREAMING THREAD
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct stream_job{
+    enum job_type {PARTITION, LOAD, STORE, CLEAR};
+    job_type type;
+
+    int64_t key = 0;
+    physic::dim2::body_storage bodies;                              // STORE
+    std::shared_ptr<const physic::dim2::scene_file> scene;          // PARTITION
+};
+
+struct stream_result{
+    int64_t key = 0;
+    bool resident = false;                                          // halfspaces of the scene, not a chunk
+    physic::dim2::body_storage bodies;
+};
+
+// ====================================================================================
+// Shared with the streaming thread
+
+static std::thread stream_thread;
+static std::mutex stream_mutex;
+static std::condition_variable stream_cv;
+static std::deque<stream_job> stream_jobs;
+static std::vector<stream_result> stream_results;
+static bool stream_stop = false;
+static int stream_pending = 0;                                      // jobs queued or running
+static int stream_stored_bodies = 0;
+
+// ====================================================================================
+// Streaming thread only
+
+static std::string stream_path;
+static float stream_chunk_size = 16;
+static std::unordered_map<int64_t, int> chunks_on_disk;             // chunk -> bodies in its file
+
+// ====================================================================================
+// Sim thread only
+
+enum chunk_state {CHUNK_LOADING, CHUNK_LOADED};
+
+static std::unordered_map<int64_t, chunk_state> stream_chunks;      // chunks not listed are on disk (or empty)
+static bool stream_active = false;
+static int stream_id_limit = 0;                                     // ids of the scene are below it
+
+static std::unordered_map<int64_t, physic::dim2::body_storage> stream_evicted;
+
+// =========================================================================|
+//                                  utilities
+// =========================================================================|
+
+// Clamped far inside the int range (NaN included): the distances between chunks never overflow
+static int chunk_coord(float position, float chunk_size){
+    const float limit = 1 << 29;
+    float cell = std::floor(position / chunk_size);
+    if(!(cell >= -limit))
+        cell = -limit;
+    if(cell > limit)
+        cell = limit;
+    return (int) cell;
+}
+
+int64_t streaming::chunk_of(float x, float y, float chunk_size){
+    return chunk_key(chunk_coord(x, chunk_size), chunk_coord(y, chunk_size));
+}
+
+static std::string chunk_path(int64_t key){
+    return stream_path + ".chunk_" + std::to_string(streaming::chunk_x(key)) + "_" + std::to_string(streaming::chunk_y(key));
+}
+
+// Append the rows of the scene to bodies
+static void append_scene_rows(physic::dim2::body_storage& bodies, const physic::dim2::scene_view& scene, int row){
+
+    const physic::dim2::collider& coll = physic::dim2::shape_collider(scene.shape[row]);
+    if(scene.is_static[row]){
+        physic::dim2::add_body(bodies, scene.id[row], nullptr, coll);
+        return;
+    }
+
+    physic::dim2::rigidbody rb;
+    rb.pos_x = rb.prev_pos_x = scene.pos_x[row];
+    rb.pos_y = rb.prev_pos_y = scene.pos_y[row];
+    rb.angle = rb.prev_angle = scene.angle[row];
+    rb.vel_x = scene.vel_x[row];
+    rb.vel_y = scene.vel_y[row];
+    rb.w = scene.w[row];
+    rb.m = scene.m[row];
+    rb.I = scene.I[row];
+    physic::dim2::add_body(bodies, scene.id[row], &rb, coll);
+}
+
+// Append the row of from to bodies
+static void append_body_row(physic::dim2::body_storage& bodies, const physic::dim2::body_storage& from, int row){
+    const physic::dim2::collider& coll = physic::dim2::shape_collider(from.shape[row]);
+    if(from.is_static[row]){
+        physic::dim2::add_body(bodies, from.id[row], nullptr, coll);
+    }else{
+        physic::dim2::rigidbody rb = physic::dim2::read_body(from, row);
+        physic::dim2::add_body(bodies, from.id[row], &rb, coll);
+    }
+}
+
+// =========================================================================|
+//                                  jobs
+// =========================================================================|
+
+static void push_result(stream_result&& result){
+    std::lock_guard<std::mutex> lock(stream_mutex);
+    stream_results.push_back(std::move(result));
+}
+
+// Split the scene by chunk (rows sorted by chunk, then one file per run); the halfspaces go back to
+// the sim thread
+static void run_partition(const physic::dim2::scene_view& scene){
+
+    stream_result resident;
+    resident.resident = true;
+
+    std::vector<std::pair<int64_t, int>> rows;
+    rows.reserve(scene.body_count);
+
+    for(int row = 0; row < scene.body_count; row++){
+        if(scene.is_static[row])
+            append_scene_rows(resident.bodies, scene, row);
+        else
+            rows.push_back({ streaming::chunk_of(scene.pos_x[row], scene.pos_y[row], stream_chunk_size), row });
+    }
+
+    push_result(std::move(resident));
+
+    std::sort(rows.begin(), rows.end());
+
+    physic::dim2::body_storage bodies;
+    for(size_t begin = 0; begin < rows.size(); ){
+
+        size_t end = begin;
+        physic::dim2::clear_bodies(bodies);
+        while(end < rows.size() && rows[end].first == rows[begin].first)
+            append_scene_rows(bodies, scene, rows[end++].second);
+
+        int64_t key = rows[begin].first;
+        if(physic::dim2::write_scene(chunk_path(key).c_str(), bodies))
+            chunks_on_disk[key] = physic::dim2::body_count(bodies);
+
+        begin = end;
+    }
+}
+
+static void run_load(int64_t key){
+
+    stream_result result;
+    result.key = key;
+
+    auto on_disk = chunks_on_disk.find(key);
+    if(on_disk != chunks_on_disk.end()){
+
+        std::string path = chunk_path(key);
+        physic::dim2::scene_file file;
+        if(physic::dim2::open_scene(path.c_str(), file)){
+            for(int row = 0; row < file.view.body_count; row++)
+                append_scene_rows(result.bodies, file.view, row);
+            physic::dim2::close_scene(file);
+        }
+
+        std::remove(path.c_str());
+        chunks_on_disk.erase(on_disk);
+    }
+
+    push_result(std::move(result));
+}
+
+// Merge the bodies in the file of the chunk (closed before it is written again)
+static void run_store(int64_t key, const physic::dim2::body_storage& stored){
+
+    std::string path = chunk_path(key);
+    physic::dim2::body_storage bodies;
+
+    if(chunks_on_disk.count(key)){
+        physic::dim2::scene_file file;
+        if(physic::dim2::open_scene(path.c_str(), file)){
+            for(int row = 0; row < file.view.body_count; row++)
+                append_scene_rows(bodies, file.view, row);
+            physic::dim2::close_scene(file);
+        }
+    }
+
+    for(int row = 0; row < physic::dim2::body_count(stored); row++)
+        append_body_row(bodies, stored, row);
+
+    if(physic::dim2::write_scene(path.c_str(), bodies))
+        chunks_on_disk[key] = physic::dim2::body_count(bodies);
+}
+
+static void run_clear(){
+    for( auto& chunk : chunks_on_disk )
+        std::remove(chunk_path(chunk.first).c_str());
+    chunks_on_disk.clear();
+}
+
+// ------------------------------------------------------------------------------------
+// Thread loop: one job at a time, in queue order
+
+static void stream_main(){
+
+    while(true){
+
+        stream_job job;
+        {
+            std::unique_lock<std::mutex> lock(stream_mutex);
+            stream_cv.wait(lock, []{ return stream_stop || !stream_jobs.empty(); });
+            if(stream_jobs.empty())
+                return;
+            job = std::move(stream_jobs.front());
+            stream_jobs.pop_front();
+        }
+
+        switch(job.type){
+            case stream_job::PARTITION:  run_partition(job.scene->view); break;
+            case stream_job::LOAD:       run_load(job.key); break;
+            case stream_job::STORE:      run_store(job.key, job.bodies); break;
+            case stream_job::CLEAR:      run_clear(); break;
+        }
+
+        int stored = 0;
+        for( auto& chunk : chunks_on_disk )
+            stored += chunk.second;
+
+        std::lock_guard<std::mutex> lock(stream_mutex);
+        stream_pending--;
+        stream_stored_bodies = stored;
+    }
+}
+
+static void push_job(stream_job&& job){
+    {
+        std::lock_guard<std::mutex> lock(stream_mutex);
+        stream_jobs.push_back(std::move(job));
+        stream_pending++;
+    }
+    stream_cv.notify_one();
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//                                               SIM THREAD
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void streaming::begin(const std::shared_ptr<const physic::dim2::scene_file>& scene, const std::string& path, float chunk_size){
+
+    end();
+
+    // Set before the thread starts: from now on only the streaming thread reads them
+    stream_path = path;
+    stream_chunk_size = chunk_size;
+    stream_stop = false;
+    stream_thread = std::thread(stream_main);
+
+    stream_chunks.clear();
+    stream_active = true;
+
+    stream_id_limit = 0;
+    for(int row = 0; row < scene->view.body_count; row++)
+        stream_id_limit = std::max(stream_id_limit, scene->view.id[row] + 1);
+
+    stream_job job;
+    job.type = stream_job::PARTITION;
+    job.scene = scene;
+    push_job(std::move(job));
+}
+
+void streaming::end(){
+
+    if(!stream_active)
+        return;
+
+    stream_job job;
+    job.type = stream_job::CLEAR;
+    push_job(std::move(job));
+
+    {
+        std::lock_guard<std::mutex> lock(stream_mutex);
+        stream_stop = true;
+    }
+    stream_cv.notify_one();
+    stream_thread.join();
+
+    stream_results.clear();
+    stream_chunks.clear();
+    stream_active = false;
+}
+
+bool streaming::active(){
+    return stream_active;
+}
+
+// =========================================================================|
+//                                  update
+// =========================================================================|
+// The chunks within the radius (the core) are always loaded or loading:
+// the bodies inside it are skipped without looking up their chunk.
+//
+bool streaming::update(physic::dim2::world& w, float focus_x, float focus_y, float view_radius){
+
+    if(!stream_active)
+        return false;
+
+    physic::dim2::body_storage& bodies = w.bodies;
+    bool changed = false;
+
+    // ------------------------------------------------------------------------------------
+    // Loaded chunks enter the world
+
+    std::vector<stream_result> results;
+    {
+        std::lock_guard<std::mutex> lock(stream_mutex);
+        results.swap(stream_results);
+    }
+
+    for( auto& result : results ){
+        if(!result.resident)
+            stream_chunks[result.key] = CHUNK_LOADED;
+        for(int row = 0; row < physic::dim2::body_count(result.bodies); row++)
+            append_body_row(bodies, result.bodies, row);
+        changed |= physic::dim2::body_count(result.bodies) > 0;
+    }
+
+    // ------------------------------------------------------------------------------------
+    // Loads of the core, unloads past the margin
+
+    int64_t focus = chunk_of(focus_x, focus_y, stream_chunk_size);
+    int focus_cx = chunk_x(focus);
+    int focus_cy = chunk_y(focus);
+    int radius = std::max(0, (int) std::ceil(view_radius / stream_chunk_size));
+
+    auto distance = [&](int64_t key){
+        return std::max(std::abs(chunk_x(key) - focus_cx), std::abs(chunk_y(key) - focus_cy));
+    };
+
+    for(int cy = focus_cy - radius; cy <= focus_cy + radius; cy++){
+        for(int cx = focus_cx - radius; cx <= focus_cx + radius; cx++){
+            int64_t key = chunk_key(cx, cy);
+            if(stream_chunks.count(key))
+                continue;
+
+            stream_chunks[key] = CHUNK_LOADING;
+
+            stream_job job;
+            job.type = stream_job::LOAD;
+            job.key = key;
+            push_job(std::move(job));
+        }
+    }
+
+    for(auto it = stream_chunks.begin(); it != stream_chunks.end(); ){
+        if(it->second == CHUNK_LOADED && distance(it->first) > radius + 1)
+            it = stream_chunks.erase(it);
+        else
+            ++it;
+    }
+
+    // ------------------------------------------------------------------------------------
+    // Bodies in chunks not loaded (or loading) go to their chunk file
+
+    for( auto& evicted : stream_evicted )
+        physic::dim2::clear_bodies(evicted.second);
+
+    bool evicting = false;
+    for(int row = 0; row < physic::dim2::body_count(bodies); row++){
+
+        if(bodies.is_static[row] || bodies.id[row] >= stream_id_limit)
+            continue;
+
+        int64_t key = chunk_of(bodies.pos_x[row], bodies.pos_y[row], stream_chunk_size);
+        if(distance(key) <= radius || stream_chunks.count(key))
+            continue;
+
+        append_body_row(stream_evicted[key], bodies, row);
+        physic::dim2::destroy_body(w, physic::dim2::row_body_handle(bodies, row));
+        evicting = true;
+    }
+
+    if(evicting){
+        for( auto& evicted : stream_evicted ){
+            if(physic::dim2::body_count(evicted.second) == 0)
+                continue;
+
+            stream_job job;
+            job.type = stream_job::STORE;
+            job.key = evicted.first;
+            job.bodies = evicted.second;
+            push_job(std::move(job));
+        }
+
+        physic::dim2::flush_destroyed_bodies(w);
+        changed = true;
+    }
+
+    // Only the chunks of this update are kept: the map doesn't grow with every chunk ever visited
+    if(stream_evicted.size() > 64)
+        stream_evicted.clear();
+
+    return changed;
+}
+
+streaming::stats streaming::get_stats(){
+
+    stats s;
+    for( auto& chunk : stream_chunks )
+        s.loaded_chunks += chunk.second == CHUNK_LOADED;
+
+    std::lock_guard<std::mutex> lock(stream_mutex);
+    s.pending_jobs = stream_pending;
+    s.stored_bodies = stream_stored_bodies;
+    return s;
+}